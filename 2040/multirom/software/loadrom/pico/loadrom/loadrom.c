@@ -16,8 +16,14 @@
 #include "pico/stdlib.h"
 #include "hardware/clocks.h"
 #include "hardware/sync.h"
+#include "hardware/pio.h"
 #include "loadrom.h"
 
+#include "msx_output_data.pio.h"
+
+PIO pio = pio0;
+uint sm1 = 1;  // State machine 1: data output (driving GPIO 16–23)
+
 // Read the address bus from the MSX
 static inline uint16_t __not_in_flash_func(read_address_bus)(void) {
     // Return first 16 bits in the most efficient way
@@ -32,40 +38,9 @@ static inline uint8_t __not_in_flash_func(read_data_bus)(void)
 }
 
 // Write a byte to the data bus
+// The byte is queued for the output state machine, which drives the data bus until /RD goes high
 static inline void __not_in_flash_func(write_data_bus)(uint8_t data) {
-    // Write the given byte to the given address
-    gpio_put_masked(0xFF0000, data << 16);
-}
-
-// Set the data bus to input mode
-static inline void __not_in_flash_func(set_data_bus_input)(void) {
-    // Set data lines to input (high impedance)
-    gpio_set_dir(PIN_D0, GPIO_IN);
-    gpio_set_dir(PIN_D1, GPIO_IN);
-    gpio_set_dir(PIN_D2, GPIO_IN);
-    gpio_set_dir(PIN_D3, GPIO_IN);
-    gpio_set_dir(PIN_D4, GPIO_IN);
-    gpio_set_dir(PIN_D5, GPIO_IN);
-    gpio_set_dir(PIN_D6, GPIO_IN);
-    gpio_set_dir(PIN_D7, GPIO_IN);
-
-    //gpio_set_dir_in_masked(0xFF << 16);
-}
-
-// Set the data bus to output mode
-static inline void __not_in_flash_func(set_data_bus_output)(void)
-{
-    gpio_set_dir(PIN_D0, GPIO_OUT);
-    gpio_set_dir(PIN_D1, GPIO_OUT);
-    gpio_set_dir(PIN_D2, GPIO_OUT);
-    gpio_set_dir(PIN_D3, GPIO_OUT);
-    gpio_set_dir(PIN_D4, GPIO_OUT);
-    gpio_set_dir(PIN_D5, GPIO_OUT);
-    gpio_set_dir(PIN_D6, GPIO_OUT);
-    gpio_set_dir(PIN_D7, GPIO_OUT);
-
-    //gpio_set_dir_out_masked(0xFF << 16);
-
+    pio_sm_put(pio, sm1, data);
 }
 
 // Initialize GPIO pins
@@ -89,16 +64,6 @@ static inline void setup_gpio()
     gpio_init(PIN_A14); gpio_set_dir(PIN_A14, GPIO_IN);
     gpio_init(PIN_A15); gpio_set_dir(PIN_A15, GPIO_IN);
 
-    // data pins
-    gpio_init(PIN_D0); 
-    gpio_init(PIN_D1); 
-    gpio_init(PIN_D2); 
-    gpio_init(PIN_D3); 
-    gpio_init(PIN_D4); 
-    gpio_init(PIN_D5); 
-    gpio_init(PIN_D6);  
-    gpio_init(PIN_D7); 
-
     // Initialize control pins as input
     gpio_init(PIN_RD); gpio_set_dir(PIN_RD, GPIO_IN);
     gpio_init(PIN_WR); gpio_set_dir(PIN_WR, GPIO_IN);
@@ -107,6 +72,23 @@ static inline void setup_gpio()
     gpio_init(PIN_BUSSDIR); gpio_set_dir(PIN_BUSSDIR, GPIO_IN);
 }
 
+// setup the data output PIO state machine
+// The state machine owns the data bus direction, it only drives GPIO 16–23 while /RD is low
+void setup_pio_output_data() {
+
+    for (int i = 0; i < 8; i++) pio_gpio_init(pio, PIN_D0 + i);
+    pio_gpio_init(pio, PIN_RD);  // /RD
+
+    uint offset1 = msx_output_data_add_program(pio, PIN_RD);
+    pio_sm_config c1 = msx_output_data_program_get_default_config(offset1);
+    sm_config_set_out_pins(&c1, PIN_D0, 8);  // Configure the 'out' pins: data bus on GPIO 16–23.
+    sm_config_set_out_shift(&c1, true, false, 32);  // Shift right, the program pulls explicitly
+    pio_sm_set_consecutive_pindirs(pio, sm1, PIN_D0, 8, false);  // Data bus released until a read is served
+    pio_sm_init(pio, sm1, offset1, &c1);
+    pio_sm_set_enabled(pio, sm1, true);
+
+}
+
 // Dump the ROM data in hexdump format
 // debug function
 void dump_rom_sram(uint32_t size)
@@ -179,7 +161,6 @@ void dump_rom(uint32_t size)
 // AB is on 0x0000, 0x0001
 void __no_inline_not_in_flash_func(loadrom_plain32)(uint32_t offset)
 {
-    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
     while (true) 
     {
         bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
@@ -193,13 +174,11 @@ void __no_inline_not_in_flash_func(loadrom_plain32)(uint32_t offset)
                 if (rd) // Handle read requests within the ROM address range
                 {
                     uint32_t rom_addr = offset + (addr - 0x4000); // Calculate flash address
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    gpio_put_masked(0xFF0000, rom[rom_addr] << 16); // Write the data to the data bus
+                    write_data_bus(rom[rom_addr]); // Write the data to the data bus
                     while (!(gpio_get(PIN_RD)))  // Wait until the read cycle completes (RD goes high)
                     {
                         tight_loop_contents();
                     }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after cycle completes
                 }
             } 
         } 
@@ -222,8 +201,6 @@ void loadrom_plain32_sram(uint32_t offset, uint32_t size)
     memcpy(rom_sram + 0x4000, rom + offset, size); //for 32KB ROMs we start at 0x4000
     gpio_put(PIN_WAIT, 1); // Lets go!
 
-    // Set data bus to input mode
-    set_data_bus_input();
     while (true) 
     {
         bool sltsl = (gpio_get(PIN_SLTSL) == 0); // Slot select (active low)
@@ -236,13 +213,11 @@ void loadrom_plain32_sram(uint32_t offset, uint32_t size)
             {
                 if (rd)
                 {
-                    set_data_bus_output(); // Drive data bus to output mode
                     write_data_bus(rom_sram[addr]);  // Drive data onto the bus
                     while (gpio_get(PIN_RD) == 0)  // Wait until the read cycle completes (RD goes high)
                     {
                         tight_loop_contents();
                     }
-                    set_data_bus_input(); // Return data lines to input mode after cycle completes
                 }
             } 
         } 
@@ -255,7 +230,6 @@ void loadrom_plain32_sram(uint32_t offset, uint32_t size)
 // AB is on 0x4000, 0x4001
 void __no_inline_not_in_flash_func(loadrom_linear48)(uint32_t offset)
 {
-    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
     while (true) 
     {
         // Check control signals
@@ -270,13 +244,11 @@ void __no_inline_not_in_flash_func(loadrom_linear48)(uint32_t offset)
                 if (rd)
                 {
                     uint32_t rom_addr = offset + addr; // Calculate flash address
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    gpio_put_masked(0xFF0000, rom[rom_addr] << 16); // Write the data to the data bus
+                    write_data_bus(rom[rom_addr]); // Write the data to the data bus
                     while (gpio_get(PIN_RD) == 0) // Wait until the read cycle completes (RD goes high)
                     {
                         tight_loop_contents();
                     }
-                    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
                 }
             }
         }
@@ -296,7 +268,6 @@ void loadrom_linear48_sram(uint32_t offset, uint32_t size)
     memcpy(rom_sram, rom + offset, size);  // for 48KB Linear0 ROMs we start at 0x0000
     gpio_put(PIN_WAIT, 1); // Lets go!
 
-    set_data_bus_input();     // Set data bus to input mode
     while (true) 
     {
         // Check control signals
@@ -310,13 +281,11 @@ void loadrom_linear48_sram(uint32_t offset, uint32_t size)
             {
                 if (addr >= 0x0000 && addr <= 0xBFFF) // Check if the address is within the ROM range
                 {
-                    set_data_bus_output();  // Drive data bus to output mode
                     write_data_bus(rom_sram[addr]); // Drive data onto the bus
                     while (gpio_get(PIN_RD) == 0) // Wait until the read cycle completes (RD goes high)
                     {
                         tight_loop_contents();
                     }
-                    set_data_bus_input(); // Return data lines to input mode after cycle completes
                 }
             }
         }
@@ -335,7 +304,6 @@ void __no_inline_not_in_flash_func(loadrom_konamiscc)(uint32_t offset)
 {
     uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
 
-    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
     while (true) 
     {
         // Check control signals
@@ -350,14 +318,12 @@ void __no_inline_not_in_flash_func(loadrom_konamiscc)(uint32_t offset)
             {
                 if (rd) 
                 {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
                     uint32_t rom_offset = offset + (bank_registers[(addr - 0x4000) >> 13] * 0x2000) + (addr & 0x1FFF); // Calculate the ROM offset
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Write the data to the data bus
+                    write_data_bus(rom[rom_offset]); // Write the data to the data bus
                     while (!(gpio_get(PIN_RD)))  // Wait until the read cycle completes (RD goes high)
                     {
                         tight_loop_contents();
                     }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after cycle completes
                 } else if (wr) 
                 {
                     // Handle writes to bank switching addresses
@@ -408,7 +374,6 @@ void loadrom_konamiscc_sram(uint32_t offset, uint32_t size)
 
     uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
 
-    set_data_bus_input();
     while (true) 
     {
         bool sltsl = (gpio_get(PIN_SLTSL) == 0); // Slot selected (active low)
@@ -425,13 +390,11 @@ void loadrom_konamiscc_sram(uint32_t offset, uint32_t size)
                     uint16_t bank_index = (addr - 0x4000) / 0x2000; // Calculate the bank index
                     uint16_t bank_offset = addr & 0x1FFF; // Calculate the offset within the bank
                     uint32_t rom_offset = (bank_registers[bank_index] * 0x2000) + bank_offset + offset; // Calculate the ROM offset
-                    set_data_bus_output();
                     write_data_bus(rom_sram[rom_offset]); // Drive data onto the bus
                     while (gpio_get(PIN_RD) == 0) 
                     {
                         tight_loop_contents();
                     }
-                    set_data_bus_input();
                 } else if (wr) 
                 {
                     // Handle writes to bank switching addresses
@@ -464,7 +427,6 @@ void __no_inline_not_in_flash_func(loadrom_konami)(uint32_t offset)
 {
     uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
 
-    gpio_set_dir_in_masked(0xFF << 16);
     while (true) 
     {
         // Check control signals
@@ -479,14 +441,12 @@ void __no_inline_not_in_flash_func(loadrom_konami)(uint32_t offset)
             {
                 if (rd) 
                 {
-                    gpio_set_dir_out_masked(0xFF << 16);
                     uint32_t rom_offset = offset + (bank_registers[(addr - 0x4000) >> 13] * 0x2000) + (addr & 0x1FFF); // Calculate the ROM offset
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16);
+                    write_data_bus(rom[rom_offset]);
                     while (!(gpio_get(PIN_RD))) 
                     {
                         tight_loop_contents();
                     }
-                    gpio_set_dir_in_masked(0xFF << 16);
 
                 }else if (wr) {
                     // Handle writes to bank switching addresses
@@ -529,7 +489,6 @@ void loadrom_konami_sram(uint32_t offset, uint32_t size)
 
     uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
 
-    set_data_bus_input();
     while (true) 
     {
         bool sltsl = (gpio_get(PIN_SLTSL) == 0); // Slot selected (active low)
@@ -548,16 +507,12 @@ void loadrom_konami_sram(uint32_t offset, uint32_t size)
                     uint32_t rom_offset = (bank_registers[bank_index] * 0x2000) + bank_offset + offset;
 
                     // Set data bus to output mode and write the data
-                    set_data_bus_output();
                     write_data_bus(rom_sram[rom_offset]);
 
                     // Wait for the read cycle to complete
                     while (gpio_get(PIN_RD) == 0) {
                         tight_loop_contents();
                     }
-
-                    // Return data bus to input mode after the read cycle
-                    set_data_bus_input();
                 }
             } else if (wr) {
                 // Handle writes to bank switching addresses
@@ -591,7 +546,6 @@ void __no_inline_not_in_flash_func(loadrom_ascii8)(uint32_t offset)
 
     uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
 
-    gpio_set_dir_in_masked(0xFF << 16);
     while (true) 
     {
         bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
@@ -604,13 +558,11 @@ void __no_inline_not_in_flash_func(loadrom_ascii8)(uint32_t offset)
             {
                 if (rd) 
                 {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
                     uint32_t rom_offset = offset + (bank_registers[(addr - 0x4000) >> 13] * 0x2000) + (addr & 0x1FFF); // Calculate the ROM offset
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Write the data to the data bus
+                    write_data_bus(rom[rom_offset]); // Write the data to the data bus
                     while (!(gpio_get(PIN_RD)))  { // Wait for the read cycle to complete
                         tight_loop_contents();
                     }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after the read cycle
                 } else if (wr)  // Handle writes to bank switching addresses
                 { 
                     if ((addr >= 0x6000) && (addr <= 0x67FF)) { 
@@ -653,7 +605,6 @@ void loadrom_ascii8_sram(uint32_t offset, uint32_t size)
 
     uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
 
-    set_data_bus_input();
     while (true) 
     {
         bool sltsl = (gpio_get(PIN_SLTSL) == 0); // Slot selected (active low)
@@ -670,16 +621,12 @@ void loadrom_ascii8_sram(uint32_t offset, uint32_t size)
                     uint32_t rom_offset = (bank_registers[(addr - 0x4000) / 0x2000] * 0x2000) + (addr & 0x1FFF);
 
                     // Set data bus to output mode and write the data
-                    set_data_bus_output();
                     write_data_bus(rom_sram[rom_offset]);
 
                     // Wait for the read cycle to complete
                     while (gpio_get(PIN_RD) == 0) {
                         tight_loop_contents();
                     }
-
-                    // Return data bus to input mode after the read cycle
-                    set_data_bus_input();
                 }
             } else if (wr) {
                 // Handle writes to bank switching addresses
@@ -712,7 +659,6 @@ void __no_inline_not_in_flash_func(loadrom_ascii16)(uint32_t offset)
 {
     uint8_t bank_registers[2] = {0, 1}; // Initial banks 0 and 1 mapped
 
-    gpio_set_dir_in_masked(0xFF << 16);
     while (true) {
         // Check control signals
         bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
@@ -724,14 +670,12 @@ void __no_inline_not_in_flash_func(loadrom_ascii16)(uint32_t offset)
             if (addr >= 0x4000 && addr <= 0xBFFF)  
             {
                 if (rd) {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
                     uint32_t rom_offset = offset + (bank_registers[(addr >> 15) & 1] << 14) + (addr & 0x3FFF);
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Write the data to the data bus
+                    write_data_bus(rom[rom_offset]); // Write the data to the data bus
                     while (!(gpio_get(PIN_RD)))  // Wait for the read cycle to complete
                     {
                         tight_loop_contents();
                     }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after the read cycle
                 }
                 else if (wr) 
                 {
@@ -767,7 +711,6 @@ void __no_inline_not_in_flash_func(loadrom_neo8)(uint32_t offset)
 {
     uint16_t bank_registers[6] = {0}; // 16-bit bank registers initialized to zero (12-bit segment, 4 MSB reserved)
 
-    gpio_set_dir_in_masked(0xFF << 16);    // Configure GPIO pins for input mode
     while (true)
     {
         bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
@@ -783,26 +726,23 @@ void __no_inline_not_in_flash_func(loadrom_neo8)(uint32_t offset)
                 if (rd)
                 {
                     // Handle read access
-                    gpio_set_dir_out_masked(0xFF << 16); // Data bus output mode
                     uint8_t bank_index = addr >> 13;     // Determine bank index (0-5)
 
                     if (bank_index < 6)
                     {
                         uint32_t segment = bank_registers[bank_index] & 0x0FFF; // 12-bit segment number
                         uint32_t rom_offset = offset + (segment << 13) + (addr & 0x1FFF); // Calculate ROM offset
-                        gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Place data on data bus
+                        write_data_bus(rom[rom_offset]); // Place data on data bus
                     }
                     else
                     {
-                        gpio_put_masked(0xFF0000, 0xFF << 16); // Invalid page handling (Page 3)
+                        write_data_bus(0xFF); // Invalid page handling (Page 3)
                     }
 
                     while (!(gpio_get(PIN_RD))) // Wait for read cycle to complete
                     {
                         tight_loop_contents();
                     }
-
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode
                 }
                 else if (wr)
                 {
@@ -894,7 +834,6 @@ void __no_inline_not_in_flash_func(loadrom_neo16)(uint32_t offset)
     uint16_t bank_registers[3] = {0};
 
     // Configure GPIO pins for input mode
-    gpio_set_dir_in_masked(0xFF << 16);
     while (true)
     {
         bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
@@ -909,26 +848,23 @@ void __no_inline_not_in_flash_func(loadrom_neo16)(uint32_t offset)
                 if (rd)
                 {
                     // Handle read access
-                    gpio_set_dir_out_masked(0xFF << 16); // Data bus output mode
                     uint8_t bank_index = addr >> 14;     // Determine bank index (0-2)
 
                     if (bank_index < 3)
                     {
                         uint32_t segment = bank_registers[bank_index] & 0x0FFF; // 12-bit segment number
                         uint32_t rom_offset = offset + (segment << 14) + (addr & 0x3FFF); // Calculate ROM offset
-                        gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Place data on data bus
+                        write_data_bus(rom[rom_offset]); // Place data on data bus
                     }
                     else
                     {
-                        gpio_put_masked(0xFF0000, 0xFF << 16); // Invalid page handling
+                        write_data_bus(0xFF); // Invalid page handling
                     }
 
                     while (!(gpio_get(PIN_RD))) // Wait for read cycle to complete
                     {
                         tight_loop_contents();
                     }
-
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode
                 }
                 else if (wr)
                 {
@@ -1000,6 +936,7 @@ int __no_inline_not_in_flash_func(main)()
     stdio_init_all();
     // Initialize GPIO
     setup_gpio();
+    setup_pio_output_data(); // The output state machine drives the data bus for every read handler
 
     char rom_name[ROM_NAME_MAX];
     memcpy(rom_name, rom, ROM_NAME_MAX);
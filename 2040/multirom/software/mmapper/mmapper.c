@@ -13,46 +13,14 @@
 #include <string.h>
 #include "pico/stdlib.h"
 #include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/irq.h"
+#include "hardware/structs/scb.h"
 
-// -----------------------
-// User-defined pin assignments
-// -----------------------
-// Address lines (A0-A15) as inputs from MSX
-#define PIN_A0     0 
-#define PIN_A1     1
-#define PIN_A2     2
-#define PIN_A3     3
-#define PIN_A4     4
-#define PIN_A5     5
-#define PIN_A6     6
-#define PIN_A7     7
-#define PIN_A8     8
-#define PIN_A9     9
-#define PIN_A10    10
-#define PIN_A11    11
-#define PIN_A12    12
-#define PIN_A13    13
-#define PIN_A14    14
-#define PIN_A15    15
-
-// Data lines (D0-D7)
-#define PIN_D0     16
-#define PIN_D1     17
-#define PIN_D2     18
-#define PIN_D3     19
-#define PIN_D4     20
-#define PIN_D5     21
-#define PIN_D6     22
-#define PIN_D7     23
-
-// Control signals
-#define PIN_RD     24   // Read strobe from MSX
-#define PIN_WR     25   // Write strobe from MSX
-#define PIN_IORQ   26   // IO Request line from MSX
-#define PIN_SLTSL  27   // Slot Select for this cartridge slot
-#define PIN_WAIT    28  // WAIT line to MSX 
-#define PIN_BUSSDIR 29  // Bus direction line to MSX
+#include "board.h"   // Pin numbers and bus masks of the board
+#include "lowpower.h"
 
+#define LOW_POWER_MAPPER 0      // 1: sleep in WFE until /RD or /WR goes low, experimental (see lowpower.h and wait_strobe)
 
 // Initialize GPIO pins
 static inline void setup_gpio()
@@ -94,6 +62,22 @@ static inline void setup_gpio()
 }
 
 
+#if LOW_POWER_MAPPER
+// wait_strobe - Sleep until /RD or /WR goes low
+// The falling edges are latched by the GPIO interrupt of this core, left disabled in the NVIC: with SEVONPEND its
+// pending flag only wakes WFE. The edges are acknowledged and the flag cleared before the strobes are checked, so a
+// cycle that starts in between still ends the sleep. An iteration of the loop below with both strobes high does
+// nothing, so skipping it changes nothing on the bus.
+static inline void __not_in_flash_func(wait_strobe)()
+{
+    gpio_acknowledge_irq(PIN_RD, GPIO_IRQ_EDGE_FALL);
+    gpio_acknowledge_irq(PIN_WR, GPIO_IRQ_EDGE_FALL);
+    irq_clear(IO_IRQ_BANK0);
+    if (gpio_get(PIN_RD) && gpio_get(PIN_WR))
+        lowpower_sleep(0);
+}
+#endif
+
 void __no_inline_not_in_flash_func(msxmmapper)(void)
 {
     static uint8_t sram_data[128 * 1024];        // 128KB of RAM in the Pico to be “mapped” in 16KB banks
@@ -101,8 +85,18 @@ void __no_inline_not_in_flash_func(msxmmapper)(void)
 
     static uint8_t pageRegister[4] = {0, 1, 2, 3};     // Four page registers for 4 pages of 16KB each
 
+#if LOW_POWER_MAPPER
+    gpio_set_irq_enabled(PIN_RD, GPIO_IRQ_EDGE_FALL, true); // Wake up events only, see wait_strobe
+    gpio_set_irq_enabled(PIN_WR, GPIO_IRQ_EDGE_FALL, true);
+    scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS;
+#endif
+
     while (true)
     {
+#if LOW_POWER_MAPPER
+        lowpower_report(); // Sleep ratio and late reads over USB, once per second, between two cycles
+        wait_strobe();
+#endif
         bool sltsl = !(gpio_get(PIN_SLTSL));  // Cartridge slot select
         bool iorq  = !(gpio_get(PIN_IORQ));   // I/O request
         bool rd    = !(gpio_get(PIN_RD));     // Read strobe
@@ -132,6 +126,9 @@ void __no_inline_not_in_flash_func(msxmmapper)(void)
                     uint8_t page = port - 0xFC;
                     uint8_t data = pageRegister[page];
                     gpio_put_masked(0xFF0000, data << 16); // Write the data to the data bus
+#if LOW_POWER_MAPPER
+                    lowpower_served();
+#endif
                     while (!(gpio_get(PIN_RD))) {                 // Wait for RD to go high again
 
                         tight_loop_contents();
@@ -153,6 +150,9 @@ void __no_inline_not_in_flash_func(msxmmapper)(void)
                     gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
                     uint8_t data = sram_data[sram_offset];  // Read from our local 128KB array
                     gpio_put_masked(0xFF0000, data << 16); // Write the data to the data bus
+#if LOW_POWER_MAPPER
+                    lowpower_served();
+#endif
                     while (!(gpio_get(PIN_RD))) {     // Wait for RD to go high
 
                         tight_loop_contents();
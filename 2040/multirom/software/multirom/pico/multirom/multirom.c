@@ -17,7 +17,20 @@
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
 #include "hardware/clocks.h"
+#include "hardware/pio.h"
+#include "hardware/irq.h"
+#include "hardware/structs/scb.h"
 #include "multirom.h"
+#include "mapper.h"
+#include "segcache.h"
+#include "flashcal.h"
+#include "busclock.h"
+#include "swap.h"
+#include "lowpower.h"
+
+#include "msx_capture_addr.pio.h"
+#include "msx_output_data.pio.h"
+#include "msx_capture_write.pio.h"
 
 // config area and buffer for the ROM data
 #define MONITOR_ADDR    0x9D01     // Monitor ROM address - Configuration binary 0x8000+(ROM_RECORD_SIZE*MAX_ROM_RECORDS)+1 = 0x8000 +0x1D00 + 0x1 = 0x9D01
@@ -25,6 +38,11 @@
 #define MAX_ROM_RECORDS 256     // Maximum ROM files supported 2^8=256
 #define ROM_NAME_MAX    20         // Maximum size of the ROM name
 
+// mapper loop build options
+#define DUAL_CORE_MAPPER 1      // 1: core 1 applies the bank register writes captured by PIO, 0: single core loop
+#define LOW_POWER_MAPPER 0      // 1: the menu and both mapper cores sleep in WFE until a PIO state machine sees a cycle, standard bus only (needs DUAL_CORE_MAPPER, experimental, see lowpower.h)
+#define LOOP_BENCHMARK   0      // 1: report the mapper loop iterations per second over USB
+
 // This symbol marks the end of the main program in flash.
 // Custom data starts right after it
 extern unsigned char __flash_binary_end;
@@ -46,6 +64,21 @@ typedef struct {
 } ROMRecord;
 
 ROMRecord records[MAX_ROM_RECORDS]; // Array to store the ROM records
+static int record_count = 0; // Number of ROM records, the catalog is parsed once and kept for hot swaps
+
+PIO pio = pio0;
+uint sm0 = 0;  // State machine 0: address capture (using GPIO 0–15)
+uint sm1 = 1;  // State machine 1: data output (driving GPIO 16–23)
+uint sm2 = 2;  // State machine 2: write capture (bank register writes)
+
+static mapper_t mapper; // Mapper state, read by the bus loop on core 0 and updated by core 1
+
+#if LOOP_BENCHMARK
+static volatile uint32_t bench_loops; // Mapper loop iterations since the ROM was started
+#define BENCH_TICK() (bench_loops++)
+#else
+#define BENCH_TICK()
+#endif
 
 // Initialize GPIO pins
 static inline void setup_gpio()
@@ -114,629 +147,425 @@ int isEndOfData(const unsigned char *memory) {
     return 1;
 }
 
-//load the MSX Menu ROM into the MSX
-int __no_inline_not_in_flash_func(loadrom_msx_menu)(uint32_t offset)
+// setup the capture address PIO state machine
+// window is the 64KB aligned SRAM area that mirrors the MSX address space; the state machine pushes
+// window | address for every read cycle of this slot. With a NULL window the pushed word is the bare address.
+void setup_pio_capture_addr(const uint8_t *window) {
+
+    static int offset0 = -1; // The program is loaded once and reused when a ROM is started again after a swap
+    if (offset0 < 0)
+        offset0 = msx_capture_addr_add_program(pio, PIN_RD);
+    pio_sm_config c0 = msx_capture_addr_program_get_default_config(offset0);
+    sm_config_set_in_pins(&c0, PIN_A0);  // Address bus
+    sm_config_set_jmp_pin(&c0, PIN_SLTSL);  // Reads with /SLTSL high are skipped
+    sm_config_set_in_shift(&c0, false, false, 32);  // Shift left, window base ends up in the upper 16 bits
+    pio_sm_init(pio, sm0, offset0, &c0);
+    pio_sm_put(pio, sm0, (uint32_t)window >> 16); // Upper 16 bits of the SRAM window address
+    pio_sm_set_enabled(pio, sm0, true);
+
+}
+
+// setup the data output PIO state machine
+// The state machine owns the data bus direction, it only drives GPIO 16–23 while /RD is low
+void setup_pio_output_data() {
+
+    for (int i = 0; i < 8; i++) pio_gpio_init(pio, DATA_PINS + i);
+
+    uint offset1 = msx_output_data_add_program(pio, PIN_RD);
+    pio_sm_config c1 = msx_output_data_program_get_default_config(offset1);
+    sm_config_set_out_pins(&c1, DATA_PINS, 8);  // Configure the 'out' pins: data bus on GPIO 16–23.
+    sm_config_set_out_shift(&c1, true, false, 32);  // Shift right, the program pulls explicitly
+    pio_sm_set_consecutive_pindirs(pio, sm1, DATA_PINS, 8, false);  // Data bus released until a read is served
+    pio_sm_init(pio, sm1, offset1, &c1);
+    pio_sm_set_enabled(pio, sm1, true);
+
+}
+
+// setup the write capture PIO state machine
+// Every write cycle of this slot is latched as (data << 16) | addr in the RX FIFO, so bank register writes are
+// never missed while the read loop is busy and the read loop does not need to decode them.
+void setup_pio_capture_write() {
+
+    static int offset2 = -1; // The program is loaded once and reused when a ROM is started again after a swap
+    if (offset2 < 0)
+        offset2 = msx_capture_write_add_program(pio, PIN_WR);
+    pio_sm_config c2 = msx_capture_write_program_get_default_config(offset2);
+    sm_config_set_in_pins(&c2, PIN_A0);  // Address and data bus
+    sm_config_set_jmp_pin(&c2, PIN_SLTSL);  // Writes with /SLTSL high are skipped
+    sm_config_set_in_shift(&c2, false, false, 32);  // Shift left, the program pushes explicitly
+    sm_config_set_fifo_join(&c2, PIO_FIFO_JOIN_RX);  // 8 deep RX FIFO, the TX FIFO is not used
+    pio_sm_init(pio, sm2, offset2, &c2);
+    pio_sm_set_enabled(pio, sm2, true);
+
+}
+
+// wait_rx_fifo - Sleep until a state machine pushes a word to its RX FIFO
+// The PIO interrupt line is not enabled in the NVIC. With SEVONPEND set its pending flag only wakes WFE, so the
+// core sleeps between bus cycles without taking an interrupt. The flag is cleared before sleeping and set again
+// right away by the hardware if a word arrived in between, so no wake up is lost. A swap request (see swap.h)
+// sends an event too and ends the wait with the FIFO still empty.
+static inline void __not_in_flash_func(wait_rx_fifo)(uint sm, uint irq_num)
 {
-    int record_count = 0; // Record count
-    const uint8_t *record_ptr = rom + offset + 0x4000; // Pointer to the ROM records
-    for (int i = 0; i < MAX_ROM_RECORDS; i++)      // Read the ROMs from the configuration area
+    while (pio_sm_is_rx_fifo_empty(pio, sm) && !swap_pending)
     {
-        if (isEndOfData(record_ptr)) {
-            break; // Stop if end of data is reached
-        }
-        memcpy(records[record_count].Name, record_ptr, ROM_NAME_MAX); // Copy the ROM name
-        record_ptr += ROM_NAME_MAX; // Move the pointer to the next field
-        records[record_count].Mapper = *record_ptr++; // Read the mapper code
-        records[record_count].Size = read_ulong(record_ptr); // Read the ROM size
-        record_ptr += sizeof(unsigned long); // Move the pointer to the next field
-        records[record_count].Offset = read_ulong(record_ptr); // Read the ROM offset
-        record_ptr += sizeof(unsigned long); // Move the pointer to the next record
-        record_count++; // Increment the record count
+        irq_clear(irq_num);
+        if (pio_sm_is_rx_fifo_empty(pio, sm))
+            lowpower_sleep(get_core_num());
     }
+}
 
-    uint8_t rom_index = 0;
-    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
-    bool rom_selected = false; // ROM selected flag
-    while (true)  // Loop until a ROM is selected
+// mapper_write_main - Apply the captured write cycles to the mapper bank registers (core 1)
+// The page pointers are swapped with single word stores, so core 0 always sees either the old or the new segment.
+// The segment cache counters are reported over USB while there are no writes to apply. The MSX reset is watched
+// then too, by swap_poll, or by the timer of swap_timer_start when the core sleeps between writes (LOW_POWER_MAPPER
+// on a standard bus): the timer runs on this core, so each period wakes it up for the reports as well.
+// Returns when the ROM has to be left, after telling core 0 through the FIFO.
+void __no_inline_not_in_flash_func(mapper_write_main)()
+{
+#if LOW_POWER_MAPPER
+    bool sleep = (busclock.speed != BUS_TURBO); // A turbo bus keeps the polling loop, see loadrom_mapper
+    if (sleep)
     {
-        // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low, not used)
-        
-        uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-        if (sltsl) 
+        swap_timer_start(); // Neither core polls, the reset is checked from a timer interrupt of this core
+        pio_set_irq1_source_enabled(pio, pis_sm2_rx_fifo_not_empty, true); // Wake up event only
+        scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS; // Pending interrupts wake WFE on this core
+    }
+#endif
+
+    while (!swap_pending)
+    {
+        if (pio_sm_is_rx_fifo_empty(pio, sm2))
         {
-            if (addr >= 0x4000 && addr <= 0xBFFF) // Check if the address is within the ROM range
+            segcache_report();
+#if LOW_POWER_MAPPER
+            if (sleep)
             {
-                if (rd)
-                {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    uint32_t rom_addr = offset + (addr - 0x4000); // Calculate flash address
-                    gpio_put_masked(0xFF0000, rom[rom_addr] << 16); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD))) { // Wait until the read cycle completes (RD goes high)
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
-                }
-                if (wr && addr == 0x9D01) // Monitor ROM address 0x9D01
-                {   
-                    rom_index = (gpio_get_all() >> 16) & 0xFF;
-                    while (!(gpio_get(PIN_WR))) { // Wait until the write cycle completes (WR goes high){
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
-                    rom_selected = true;    // ROM selected
-                }
-            } 
-        }
-        if (rd && addr == 0x0000 && rom_selected)   // lets return the rom_index and load the selected ROM
-        {
-            return rom_index;
+                lowpower_report();
+                irq_clear(PIO0_IRQ_1); // See wait_rx_fifo, a timer period or a swap request ends the sleep too
+                if (pio_sm_is_rx_fifo_empty(pio, sm2) && !swap_pending)
+                    lowpower_sleep(1);
+                continue;
+            }
+#endif
+            swap_poll();
+            continue;
         }
+        uint32_t bus = pio_sm_get(pio, sm2); // (data << 16) | addr
+        mapper_write(&mapper, bus & 0xFFFF, (bus >> 16) & 0xFF);
+        swap_write(bus & 0xFFFF, (bus >> 16) & 0xFF);
+    }
+#if LOW_POWER_MAPPER
+    if (sleep)
+    {
+        pio_set_irq1_source_enabled(pio, pis_sm2_rx_fifo_not_empty, false);
+        swap_timer_stop(); // Before core 0 resets this core
     }
+#endif
+    multicore_fifo_push_blocking(0); // Core 0 can reset this core safely, nothing is half done
 }
 
-// loadrom_plain32 - Load a simple 32KB (or less) ROM into the MSX directly from the pico flash
-// 32KB ROMS have two pages of 16Kb each in the following areas:
-// 0x4000-0x7FFF and 0x8000-0xBFFF
-// AB is on 0x0000, 0x0001
-// 16KB ROMS have only one page in the 0x4000-0x7FFF area
-// AB is on 0x0000, 0x0001
-void __no_inline_not_in_flash_func(loadrom_plain32)(uint32_t offset)
+// serve_read - Put a byte on the data bus for the current read cycle
+// The output state machine drives the queued byte while /RD is low and releases the data bus when /RD goes high,
+// so the loop only waits for the end of the cycle to avoid serving it twice.
+static inline void __not_in_flash_func(serve_read)(uint8_t data)
 {
-    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
-    while (true) 
+    pio_sm_put(pio, sm1, data); // Queue the byte for the output state machine
+    while (!(bus_sample() & BUS_RD_MASK)) // Wait until the read cycle completes (RD goes high)
     {
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-
-        if (sltsl) 
-        {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF) // Check if the address is within the ROM range
-            {
-                if (rd) // Handle read requests within the ROM address range
-                {
-                    uint32_t rom_addr = offset + (addr - 0x4000); // Calculate flash address
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    gpio_put_masked(0xFF0000, rom[rom_addr] << 16); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD)))  // Wait until the read cycle completes (RD goes high)
-                    {
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after cycle completes
-                }
-            } 
-        } 
+        tight_loop_contents();
     }
 }
 
-// loadrom_linear48 - Load a simple 48KB Linear0 ROM into the MSX directly from the pico flash
-// Those ROMs have three pages of 16Kb each in the following areas:
-// 0x0000-0x3FFF, 0x4000-0x7FFF and 0x8000-0xBFFF
-// AB is on 0x4000, 0x4001
-void __no_inline_not_in_flash_func(loadrom_linear48)(uint32_t offset)
+#if LOW_POWER_MAPPER
+// menu_sleep - Serve the menu until a ROM is selected, sleeping in WFE between the bus cycles
+// The capture state machines push the read and the write cycles of this slot and wake the core, as in the low power
+// loop of loadrom_mapper. Returns the catalog index written to MONITOR_ADDR. The menu runs on until it jumps to the
+// selected ROM through address 0, which is not in this slot, so the caller polls the bus from there.
+static uint8_t __not_in_flash_func(menu_sleep)(uint32_t offset)
 {
-    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
-    while (true) 
+    setup_pio_capture_addr(NULL); // No window, the pushed word is the bare address
+    setup_pio_capture_write();
+    pio_set_irq0_source_enabled(pio, pis_sm0_rx_fifo_not_empty, true); // Wake up events only
+    pio_set_irq0_source_enabled(pio, pis_sm2_rx_fifo_not_empty, true);
+    scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS; // Pending interrupts wake WFE
+
+    int selected = -1;
+    while (selected < 0)
     {
-        // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
+        irq_clear(PIO0_IRQ_0); // See wait_rx_fifo
+        if (pio_sm_is_rx_fifo_empty(pio, sm0) && pio_sm_is_rx_fifo_empty(pio, sm2))
+            lowpower_sleep(0);
 
-        if (sltsl)
+        while (!pio_sm_is_rx_fifo_empty(pio, sm0))
         {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x0000 && addr <= 0xBFFF) // Check if the address is within the ROM range
+            uint16_t addr = (uint16_t)pio_sm_get(pio, sm0);
+            if (addr >= 0x4000 && addr <= 0xBFFF) // Check if the address is within the ROM range
             {
-                if (rd)
-                {
-                    uint32_t rom_addr = offset + addr; // Calculate flash address
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    gpio_put_masked(0xFF0000, rom[rom_addr] << 16); // Write the data to the data bus
-                    while (gpio_get(PIN_RD) == 0) // Wait until the read cycle completes (RD goes high)
-                    {
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
-                }
+                pio_sm_put(pio, sm1, rom[offset + (addr - 0x4000)]); // Driven until /RD goes high
+                lowpower_served();
             }
         }
+        while (!pio_sm_is_rx_fifo_empty(pio, sm2))
+        {
+            uint32_t bus = pio_sm_get(pio, sm2); // (data << 16) | addr
+            if ((bus & 0xFFFF) == MONITOR_ADDR)
+                selected = (bus >> 16) & 0xFF;
+        }
     }
+
+    pio_set_irq0_source_enabled(pio, pis_sm0_rx_fifo_not_empty, false);
+    pio_set_irq0_source_enabled(pio, pis_sm2_rx_fifo_not_empty, false);
+    pio_sm_set_enabled(pio, sm0, false);
+    pio_sm_set_enabled(pio, sm2, false);
+    return selected;
 }
+#endif
 
-// loadrom_konamiscc - Load a any Konami SCC ROM into the MSX directly from the pico flash
-// The KonamiSCC ROMs are divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments 
-// into the MSX's address space. Since the size of the mapper is 8Kb, the memory banks are:
-// Bank 1: 4000h - 5FFFh , Bank 2: 6000h - 7FFFh, Bank 3: 8000h - 9FFFh, Bank 4: A000h - BFFFh
-// And the address to change banks are:
-// Bank 1: 5000h - 57FFh (5000h used), Bank 2: 7000h - 77FFh (7000h used), Bank 3: 9000h - 97FFh (9000h used), Bank 4: B000h - B7FFh (B000h used)
-// AB is on 0x0000, 0x0001
-void __no_inline_not_in_flash_func(loadrom_konamiscc)(uint32_t offset)
+//load the MSX Menu ROM into the MSX
+int __no_inline_not_in_flash_func(loadrom_msx_menu)(uint32_t offset)
 {
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
-
-    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
-    while (true) 
+    if (record_count == 0) // Parsed once, the catalog is kept when coming back from a ROM
     {
-        // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
-
-        if (sltsl)
+        const uint8_t *record_ptr = rom + offset + 0x4000; // Pointer to the ROM records
+        for (int i = 0; i < MAX_ROM_RECORDS; i++)      // Read the ROMs from the configuration area
         {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF)  // Check if the address is within the ROM range
-            {
-                if (rd) 
-                {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    uint32_t rom_offset = offset + (bank_registers[(addr - 0x4000) >> 13] * 0x2000) + (addr & 0x1FFF); // Calculate the ROM offset
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD)))  // Wait until the read cycle completes (RD goes high)
-                    {
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after cycle completes
-                } else if (wr) 
-                {
-                    // Handle writes to bank switching addresses
-                    if ((addr >= 0x5000)  && (addr <= 0x57FF)) { 
-                        bank_registers[0] = (gpio_get_all() >> 16) & 0xFF; // Read the data bus and store in bank register
-                    } else if ((addr >= 0x7000) && (addr <= 0x77FF)) {
-                        bank_registers[1] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if ((addr >= 0x9000) && (addr <= 0x97FF)) {
-                        bank_registers[2] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if ((addr >= 0xB000) && (addr <= 0xB7FF)) {
-                        bank_registers[3] = (gpio_get_all() >> 16) & 0xFF;
-                    }
-
-                    while (!(gpio_get(PIN_WR)))
-                    {
-                        tight_loop_contents();
-                    }
-                }
+            if (isEndOfData(record_ptr)) {
+                break; // Stop if end of data is reached
             }
+            memcpy(records[record_count].Name, record_ptr, ROM_NAME_MAX); // Copy the ROM name
+            record_ptr += ROM_NAME_MAX; // Move the pointer to the next field
+            records[record_count].Mapper = *record_ptr++; // Read the mapper code
+            records[record_count].Size = read_ulong(record_ptr); // Read the ROM size
+            record_ptr += sizeof(unsigned long); // Move the pointer to the next field
+            records[record_count].Offset = read_ulong(record_ptr); // Read the ROM offset
+            record_ptr += sizeof(unsigned long); // Move the pointer to the next record
+            record_count++; // Increment the record count
         }
     }
-}
 
-// loadrom_konami - Load a Konami (without SCC) ROM into the MSX directly from the pico flash
-// The Konami (without SCC) ROM is divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Since the size of the mapper is 8Kb, the memory banks are:
-//  Bank 1: 4000h - 5FFFh, Bank 2: 6000h - 7FFFh, Bank 3: 8000h - 9FFFh, Bank 4: A000h - BFFFh
-// And the addresses to change banks are:
-//	Bank 1: <none>, Bank 2: 6000h - 67FFh (6000h used), Bank 3: 8000h - 87FFh (8000h used), Bank 4: A000h - A7FFh (A000h used)
-// AB is on 0x0000, 0x0001
-void __no_inline_not_in_flash_func(loadrom_konami)(uint32_t offset)
-{
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
-
-    gpio_set_dir_in_masked(0xFF << 16);
-    while (true) 
+    uint8_t rom_index = 0;
+    bool rom_selected = false; // ROM selected flag
+#if LOW_POWER_MAPPER
+    if (busclock.speed != BUS_TURBO) // Standard bus only, as loadrom_mapper
+    {
+        rom_index = menu_sleep(offset); // Asleep while the user browses the catalog
+        rom_selected = true;
+    }
+#endif
+    while (true)  // Loop until a ROM is selected
     {
         // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
-
-        if (sltsl)
+        uint32_t bus = bus_sample(); // Sample control signals and address bus at once
+        bool sltsl = bus_active(bus, BUS_SLTSL_MASK); // Slot selected (active low)
+        bool rd = bus_active(bus, BUS_RD_MASK);       // Read cycle (active low)
+        bool wr = bus_active(bus, BUS_WR_MASK);       // Write cycle (active low, not used)
+        
+        uint16_t addr = bus_addr(bus); // Read the address bus
+        if (sltsl) 
         {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF) 
+            if (addr >= 0x4000 && addr <= 0xBFFF) // Check if the address is within the ROM range
             {
-                if (rd) 
+                if (rd)
                 {
-                    gpio_set_dir_out_masked(0xFF << 16);
-                    uint32_t rom_offset = offset + (bank_registers[(addr - 0x4000) >> 13] * 0x2000) + (addr & 0x1FFF); // Calculate the ROM offset
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16);
-                    while (!(gpio_get(PIN_RD))) 
-                    {
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16);
-
-                }else if (wr) {
-                    // Handle writes to bank switching addresses
-                    if ((addr >= 0x6000) && (addr <= 0x67FF)) {
-                        bank_registers[1] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if ((addr >= 0x8000) && (addr <= 0x87FF)) {
-                        bank_registers[2] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if ((addr >= 0xA000) && (addr <= 0xA7FF)) {
-                        bank_registers[3] = (gpio_get_all() >> 16) & 0xFF;
-                    }
-
-                    while (!(gpio_get(PIN_WR))) 
-                    {
+                    uint32_t rom_addr = offset + (addr - 0x4000); // Calculate flash address
+                    serve_read(rom[rom_addr]); // Drive the data bus until the read cycle completes
+                }
+                if (wr && addr == 0x9D01) // Monitor ROM address 0x9D01
+                {   
+                    rom_index = bus_data(bus_sample());
+                    while (!(bus_sample() & BUS_WR_MASK)) { // Wait until the write cycle completes (WR goes high){
                         tight_loop_contents();
                     }
+                    rom_selected = true;    // ROM selected
                 }
-            }
+            } 
+        }
+        if (rd && addr == 0x0000 && rom_selected)   // lets return the rom_index and load the selected ROM
+        {
+            return rom_index;
         }
     }
 }
 
-// loadrom_ascii8 - Load an ASCII8 ROM into the MSX directly from the pico flash
-// The ASCII8 ROM is divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Since the size of the mapper is 8Kb, the memory banks are:
-// Bank 1: 4000h - 5FFFh , Bank 2: 6000h - 7FFFh, Bank 3: 8000h - 9FFFh, Bank 4: A000h - BFFFh
-// And the address to change banks are:
-// Bank 1: 6000h - 67FFh (6000h used), Bank 2: 6800h - 6FFFh (6800h used), Bank 3: 7000h - 77FFh (7000h used), Bank 4: 7800h - 7FFFh (7800h used)
-// AB is on 0x0000, 0x0001
-void __no_inline_not_in_flash_func(loadrom_ascii8)(uint32_t offset)
+#if LOOP_BENCHMARK
+// bench_report - Print the number of mapper loop iterations done in the last second
+// An idle iteration is one bus sample, so the rate is a direct measure of the loop length and of how soon a read
+// cycle is seen after /RD goes low. Compare DUAL_CORE_MAPPER 1 and 0 builds running the same ROM.
+static bool bench_report(struct repeating_timer *t)
 {
+    static uint32_t last_loops = 0;
+    uint32_t loops = bench_loops;
+
+    printf("Mapper loop (%s): %lu iterations/s\n",
+           (LOW_POWER_MAPPER && busclock.speed != BUS_TURBO) ? "low power" : (DUAL_CORE_MAPPER ? "dual core" : "single core"),
+           (unsigned long)(loops - last_loops));
+    last_loops = loops;
+    return true;
+}
+#endif
+
+// loadrom_mapper - Load a ROM into the MSX using the table driven mapper engine
+// Returns when the ROM has to be left (see swap.h), or right away if the mapper is not supported.
+// A ROM that fits in the segment cache storage is copied whole to SRAM first, larger ones are served from the
+// flash through the segment cache.
+// The page and write action tables are built once by mapper_init for the selected mapper (see mapper.c for the
+// layout of each supported mapper). A read is served with a single table lookup, so the loop is the same for
+// every mapper. With DUAL_CORE_MAPPER the bank register writes are captured by PIO and applied by core 1 and the
+// loop only serves reads, otherwise the loop decodes the writes itself.
+void __no_inline_not_in_flash_func(loadrom_mapper)(uint32_t offset, uint32_t size, uint8_t mapper_type)
+{
+    uint32_t start = time_us_32();
+    const uint8_t *image = segcache_preload(rom + offset, size); // Whole ROM in SRAM when it fits
 
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
-
-    gpio_set_dir_in_masked(0xFF << 16);
-    while (true) 
+    if (!mapper_init(&mapper, mapper_type, image ? image : rom + offset))
     {
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
-
-        if (sltsl) {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF) 
-            {
-                if (rd) 
-                {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    uint32_t rom_offset = offset + (bank_registers[(addr - 0x4000) >> 13] * 0x2000) + (addr & 0x1FFF); // Calculate the ROM offset
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD)))  { // Wait for the read cycle to complete
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after the read cycle
-                } else if (wr)  // Handle writes to bank switching addresses
-                { 
-                    if ((addr >= 0x6000) && (addr <= 0x67FF)) { 
-                        bank_registers[0] = (gpio_get_all() >> 16) & 0xFF; // Read the data bus and store in bank register
-                    } else if ((addr >= 0x6800) && (addr <= 0x6FFF)) {
-                        bank_registers[1] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if ((addr >= 0x7000) && (addr <= 0x77FF)) {
-                        bank_registers[2] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if ((addr >= 0x7800) && (addr <= 0x7FFF)) {
-                        bank_registers[3] = (gpio_get_all() >> 16) & 0xFF;
-                    }
-
-                    while (!(gpio_get(PIN_WR))) 
-                    {
-                        tight_loop_contents();
-                    }
-                }
-            }
-        }
+        printf("Debug: Unsupported ROM mapper: %d\n", mapper_type);
+        return;
+    }
+    if (image)
+    {
+        mapper_attach_sram(&mapper, size);
+        printf("ROM mode: SRAM preload, %lu bytes loaded in %lu us\n", (unsigned long)size,
+               (unsigned long)(time_us_32() - start));
+    }
+    else
+    {
+        // Serve the banked pages from SRAM, and the fixed ones too on a turbo bus or when flash reads are uncached
+        mapper_attach_cache(&mapper, size, (busclock.speed == BUS_TURBO) || SEGCACHE_XIP_PINNED);
+        printf("ROM mode: flash with segment cache, %lu bytes do not fit in %lu bytes of SRAM\n", (unsigned long)size,
+               (unsigned long)SEGCACHE_POOL_SIZE);
     }
-}
-
-// loadrom_ascii16 - Load an ASCII16 ROM into the MSX directly from the pico flash
-// The ASCII16 ROM is divided into 16KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Since the size of the mapper is 16Kb, the memory banks are:
-// Bank 1: 4000h - 7FFFh , Bank 2: 8000h - BFFFh
-// And the address to change banks are:
-// Bank 1: 6000h - 67FFh (6000h used), Bank 2: 7000h - 77FFh (7000h and 77FFh used)
-void __no_inline_not_in_flash_func(loadrom_ascii16)(uint32_t offset)
-{
-    uint8_t bank_registers[2] = {0, 1}; // Initial banks 0 and 1 mapped
 
-    gpio_set_dir_in_masked(0xFF << 16);
-    while (true) {
-        // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
+#if LOOP_BENCHMARK
+    static struct repeating_timer bench_timer;
+    add_repeating_timer_ms(-1000, bench_report, NULL, &bench_timer);
+#endif
+    swap_arm(); // Leave on a reset or on the magic write (see swap.h)
+
+#if DUAL_CORE_MAPPER
+    setup_pio_capture_write(); // Latch the write cycles
+    multicore_launch_core1(mapper_write_main); // Drain them on core 1
+
+#if LOW_POWER_MAPPER
+    // Event driven loop: the capture state machine pushes the address of every read cycle of this slot and the
+    // core sleeps in between (an iteration is a wake up when LOOP_BENCHMARK is set).
+    // Experimental: whether the wake up (WFE, FIFO read, table lookup) queues the byte before /RD goes high on a
+    // given machine is counted by lowpower_served, and reported with the time asleep by core 1 (see lowpower.h).
+    // Until those reports come back without late reads from real machines the option stays off, and it is only
+    // used on a standard bus, whose /RD pulse leaves the most margin; a turbo bus keeps the polling loop on both cores.
+    if (busclock.speed != BUS_TURBO)
+    {
+        setup_pio_capture_addr(NULL); // No window, the pushed word is the bare address
+        pio_set_irq0_source_enabled(pio, pis_sm0_rx_fifo_not_empty, true); // Wake up event only
+        scb_hw->scr |= M0PLUS_SCR_SEVONPEND_BITS; // Pending interrupts wake WFE
 
-        if (sltsl) {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF)  
+        while (!swap_pending)
+        {
+            wait_rx_fifo(sm0, PIO0_IRQ_0);
+            if (swap_pending)
+                break;
+            BENCH_TICK();
+            const uint8_t *data = mapper_read_ptr(&mapper, (uint16_t)pio_sm_get(pio, sm0));
+            if (data)
             {
-                if (rd) {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    uint32_t rom_offset = offset + (bank_registers[(addr >> 15) & 1] << 14) + (addr & 0x3FFF);
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD)))  // Wait for the read cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after the read cycle
-                }
-                else if (wr) 
-                {
-                    // Update bank registers based on the specific switching addresses
-                    if ((addr >= 0x6000) && (addr <= 0x67FF)) {
-                        bank_registers[0] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if (addr >= 0x7000 && addr <= 0x77FF) {
-                        bank_registers[1] = (gpio_get_all() >> 16) & 0xFF;
-                    }
-                    while (!(gpio_get(PIN_WR))) {
-                        tight_loop_contents();
-                    }
-                }
-                
+                pio_sm_put(pio, sm1, *data); // Driven until /RD goes high, one push per read cycle
+                lowpower_served();
             }
         }
+        pio_set_irq0_source_enabled(pio, pis_sm0_rx_fifo_not_empty, false);
+        pio_sm_set_enabled(pio, sm0, false);
     }
-}
-
-// loadrom_neo8 - Load an NEO8 ROM into the MSX directly from the pico flash
-// The NEO8 ROM is divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Size of a segment: 8 KB
-// Segment switching addresses:
-// Bank 0: 0000h~1FFFh, Bank 1: 2000h~3FFFh, Bank 2: 4000h~5FFFh, Bank 3: 6000h~7FFFh, Bank 4: 8000h~9FFFh, Bank 5: A000h~BFFFh
-// Switching address: 
-// 5000h (mirror at 1000h, 9000h and D000h), 
-// 5800h (mirror at 1800h, 9800h and D800h), 
-// 6000h (mirror at 2000h, A000h and E000h), 
-// 6800h (mirror at 2800h, A800h and E800h), 
-// 7000h (mirror at 3000h, B000h and F000h), 
-// 7800h (mirror at 3800h, B800h and F800h)
-void __no_inline_not_in_flash_func(loadrom_neo8)(uint32_t offset)
-{
-    uint16_t bank_registers[6] = {0}; // 16-bit bank registers initialized to zero (12-bit segment, 4 MSB reserved)
-
-    gpio_set_dir_in_masked(0xFF << 16);    // Configure GPIO pins for input mode
-    while (true)
+    else
+#endif
+    while (!swap_pending) 
     {
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
+        uint32_t gpio_state = bus_sample(); // Sample control signals and address bus at once
+        BENCH_TICK();
 
-        if (sltsl)
+        if (bus_active(gpio_state, BUS_SLOT_READ_MASK)) // Read cycle on this slot (both active low)
         {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read address bus
-
-            if (addr <= 0xBFFF)
+            const uint8_t *data = mapper_read_ptr(&mapper, bus_addr(gpio_state));
+            if (data)
             {
-                if (rd)
-                {
-                    // Handle read access
-                    gpio_set_dir_out_masked(0xFF << 16); // Data bus output mode
-                    uint8_t bank_index = addr >> 13;     // Determine bank index (0-5)
-
-                    if (bank_index < 6)
-                    {
-                        uint32_t segment = bank_registers[bank_index] & 0x0FFF; // 12-bit segment number
-                        uint32_t rom_offset = offset + (segment << 13) + (addr & 0x1FFF); // Calculate ROM offset
-                        gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Place data on data bus
-                    }
-                    else
-                    {
-                        gpio_put_masked(0xFF0000, 0xFF << 16); // Invalid page handling (Page 3)
-                    }
-
-                    while (!(gpio_get(PIN_RD))) // Wait for read cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
-
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode
-                }
-                else if (wr)
-                {
-                    // Handle write access
-                    uint16_t base_addr = addr & 0xF800; // Mask to identify base address
-                    uint8_t bank_index = 6;             // Initialize to invalid bank
-
-                    // Determine bank index based on base address
-                    switch (base_addr)
-                    {
-                        case 0x5000:
-                        case 0x1000:
-                        case 0x9000:
-                        case 0xD000:
-                            bank_index = 0;
-                            break;
-                        case 0x5800:
-                        case 0x1800:
-                        case 0x9800:
-                        case 0xD800:
-                            bank_index = 1;
-                            break;
-                        case 0x6000:
-                        case 0x2000:
-                        case 0xA000:
-                        case 0xE000:
-                            bank_index = 2;
-                            break;
-                        case 0x6800:
-                        case 0x2800:
-                        case 0xA800:
-                        case 0xE800:
-                            bank_index = 3;
-                            break;
-                        case 0x7000:
-                        case 0x3000:
-                        case 0xB000:
-                        case 0xF000:
-                            bank_index = 4;
-                            break;
-                        case 0x7800:
-                        case 0x3800:
-                        case 0xB800:
-                        case 0xF800:
-                            bank_index = 5;
-                            break;
-                    }
-
-                    if (bank_index < 6)
-                    {
-                        uint8_t data = (gpio_get_all() >> 16) & 0xFF;
-                        if (addr & 0x01)
-                        {
-                            // Write to MSB
-                            bank_registers[bank_index] = (bank_registers[bank_index] & 0x00FF) | (data << 8);
-                        }
-                        else
-                        {
-                            // Write to LSB
-                            bank_registers[bank_index] = (bank_registers[bank_index] & 0xFF00) | data;
-                        }
-
-                        // Ensure reserved MSB bits are zero
-                        bank_registers[bank_index] &= 0x0FFF;
-                    }
-
-                    while (!(gpio_get(PIN_WR))) // Wait for write cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
-                }
+                serve_read(*data);
             }
         }
     }
-}
-
-// loadrom_neo16 - Load an NEO16 ROM into the MSX directly from the pico flash
-// The NEO16 ROM is divided into 16KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Size of a segment: 16 KB
-// Segment switching addresses:
-// Bank 0: 0000h~3FFFh, Bank 1: 4000h~7FFFh, Bank 2: 8000h~BFFFh
-// Switching address:
-// 5000h (mirror at 1000h, 9000h and D000h),
-// 6000h (mirror at 2000h, A000h and E000h),
-// 7000h (mirror at 3000h, B000h and F000h)
-void __no_inline_not_in_flash_func(loadrom_neo16)(uint32_t offset)
-{
-    // 16-bit bank registers initialized to zero (12-bit segment, 4 MSB reserved)
-    uint16_t bank_registers[3] = {0};
-
-    // Configure GPIO pins for input mode
-    gpio_set_dir_in_masked(0xFF << 16);
-    while (true)
+    multicore_fifo_pop_blocking(); // Core 1 has left mapper_write_main
+    multicore_reset_core1();
+    pio_sm_set_enabled(pio, sm2, false);
+#else
+    while (!swap_pending) 
     {
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
+        uint32_t gpio_state = bus_sample(); // Sample control signals and address bus at once
+        BENCH_TICK();
 
-        if (sltsl)
+        if (bus_active(gpio_state, BUS_SLTSL_MASK)) // Slot selected (active low)
         {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read address bus
-            if (addr <= 0xBFFF)
+            uint16_t addr = bus_addr(gpio_state); // Address bus
+            if (bus_active(gpio_state, BUS_RD_MASK)) // Read cycle (active low)
             {
-                if (rd)
+                const uint8_t *data = mapper_read_ptr(&mapper, addr);
+                if (data)
                 {
-                    // Handle read access
-                    gpio_set_dir_out_masked(0xFF << 16); // Data bus output mode
-                    uint8_t bank_index = addr >> 14;     // Determine bank index (0-2)
-
-                    if (bank_index < 3)
-                    {
-                        uint32_t segment = bank_registers[bank_index] & 0x0FFF; // 12-bit segment number
-                        uint32_t rom_offset = offset + (segment << 14) + (addr & 0x3FFF); // Calculate ROM offset
-                        gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Place data on data bus
-                    }
-                    else
-                    {
-                        gpio_put_masked(0xFF0000, 0xFF << 16); // Invalid page handling
-                    }
-
-                    while (!(gpio_get(PIN_RD))) // Wait for read cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
-
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode
+                    serve_read(*data);
                 }
-                else if (wr)
+            }
+            else if (bus_active(gpio_state, BUS_WR_MASK)) // Write cycle (active low)
+            {
+                uint8_t data = bus_data(bus_sample());
+                mapper_write(&mapper, addr, data); // Update the bank registers, if any
+                swap_write(addr, data);
+                while (!(bus_sample() & BUS_WR_MASK)) // Wait until the write cycle completes (WR goes high)
                 {
-                    // Handle write access
-                    uint16_t base_addr = addr & 0xF800; // Mask to identify base address
-                    uint8_t bank_index = 3;             // Initialize to invalid bank
-
-                    // Determine bank index based on base address
-                    switch (base_addr)
-                    {
-                        case 0x5000:
-                        case 0x1000:
-                        case 0x9000:
-                        case 0xD000:
-                            bank_index = 0;
-                            break;
-                        case 0x6000:
-                        case 0x2000:
-                        case 0xA000:
-                        case 0xE000:
-                            bank_index = 1;
-                            break;
-                        case 0x7000:
-                        case 0x3000:
-                        case 0xB000:
-                        case 0xF000:
-                            bank_index = 2;
-                            break;
-                    }
-
-                    if (bank_index < 3)
-                    {
-                        uint8_t data = (gpio_get_all() >> 16) & 0xFF; // Read 8-bit data from bus
-                        if (addr & 0x01)
-                        {
-                            // Write to MSB
-                            bank_registers[bank_index] = (bank_registers[bank_index] & 0x00FF) | (data << 8);
-                        }
-                        else
-                        {
-                            // Write to LSB
-                            bank_registers[bank_index] = (bank_registers[bank_index] & 0xFF00) | data;
-                        }
-
-                        // Ensure reserved MSB bits are zero
-                        bank_registers[bank_index] &= 0x0FFF;
-                    }
-
-                    while (!(gpio_get(PIN_WR))) // Wait for write cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
+                    tight_loop_contents();
                 }
             }
         }
+        else
+        {
+            swap_poll(); // Slot idle, check that the MSX is not in reset
+        }
     }
+#endif
+    segcache_release(); // The menu and the next ROM run from flash again, with the XIP cache back on
+#if LOOP_BENCHMARK
+    cancel_repeating_timer(&bench_timer);
+#endif
 }
 
-
 // Main function running on core 0
 int main()
 {
     set_sys_clock_khz(270000, true);     // Set system clock to 270MHz
     stdio_init_all();     // Initialize stdio
     setup_gpio();     // Initialize GPIO
+    setup_pio_output_data(); // The output state machine drives the data bus for every read handler
 
-    int rom_index = loadrom_msx_menu(0x0000); //load the first 32KB ROM into the MSX (The MSX PICOVERSE MENU)
-
-    // Load the selected ROM into the MSX according to the mapper
-    switch (records[rom_index].Mapper) {
-        case 1:
-        case 2:
-            loadrom_plain32(records[rom_index].Offset);
-            break;
-        case 3:
-            loadrom_konamiscc(records[rom_index].Offset);
-            break;
-        case 4:
-            loadrom_linear48(records[rom_index].Offset);
-            break;
-        case 5:
-            loadrom_ascii8(records[rom_index].Offset); 
-            break;
-        case 6:
-            loadrom_ascii16(records[rom_index].Offset); 
-            break;
-        case 7:
-            loadrom_konami(records[rom_index].Offset); 
-            break;
-        case 8:
-            loadrom_neo8(records[rom_index].Offset); 
-            break;
-        case 9:
-            loadrom_neo16(records[rom_index].Offset); 
-            break;
-        default:
-            printf("Debug: Unsupported ROM mapper: %d\n", records[rom_index].Mapper);
-            break;
+    gpio_init(PIN_WAIT); // Init wait signal pin
+    gpio_set_dir(PIN_WAIT, GPIO_OUT); // Set the WAIT signal as output
+    gpio_put(PIN_WAIT, 0); // Hold the MSX while the flash timing is calibrated
+    flashcal_run(rom, FLASHCAL_BYTES); // Keep the fastest flash timing that reads the ROMs back correctly
+    gpio_put(PIN_WAIT, 1); // Lets go!
+    busclock_measure(); // Pick the service strategy from the MSX bus clock
+
+    while (true)
+    {
+        int rom_index = loadrom_msx_menu(0x0000); //load the first 32KB ROM into the MSX (The MSX PICOVERSE MENU)
+
+        // Load the selected ROM into the MSX according to the mapper, until a reset or a magic write asks for the
+        // menu. The magic write may also start another ROM of the catalog right away.
+        while (rom_index >= 0 && rom_index < record_count)
+        {
+            busclock_measure(); // The CPU speed may have been changed since the last measurement
+            loadrom_mapper(records[rom_index].Offset, records[rom_index].Size, records[rom_index].Mapper);
+            rom_index = swap_pending ? swap_target : -1;
+            swap_pending = false; // Taken: a target that returns without arming the swap falls back to the menu
+            swap_target = -1;
+            if (rom_index >= 0 && rom_index < record_count)
+                printf("Hot swap: ROM %d\n", rom_index);
+            else
+                printf("Hot swap: back to the menu\n");
+        }
     }
-    
 }
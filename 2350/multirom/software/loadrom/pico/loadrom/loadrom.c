@@ -19,7 +19,13 @@
 #include "hardware/pio.h"
 #include "hardware/dma.h"
 #include "hardware/structs/qmi.h"
+#include "pico/multicore.h"
+#include "pico/audio_i2s.h"
 #include "loadrom.h"
+#include "usbload.h"
+#include "scc.h"
+#include "plainwin.h"
+#include "mapper.h"
 
 #include "msx_capture_addr.pio.h"
 #include "msx_output_data.pio.h"
@@ -27,59 +33,16 @@
 PIO pio = pio0;
 uint sm0 = 0;  // State machine 0: address capture (using GPIO 0–15)
 uint sm1 = 1;  // State machine 1: data output (driving GPIO 16–23)
-int dma_chan;
-uint32_t dummy_dst[1] = {0};
-
-
-// Read the address bus from the MSX
-static inline uint16_t __not_in_flash_func(read_address_bus)(void) {
-    // Return first 16 bits in the most efficient way
-    return gpio_get_all() & 0x00FFFF;
-}
-
-// Read a byte from the data bus
-static inline uint8_t __not_in_flash_func(read_data_bus)(void) 
-{
-    // Read the data bus
-    return (gpio_get_all() >> 16) & 0xFF;
-}
+int dma_addr_chan; // DMA channel moving captured addresses into the data channel
+int dma_data_chan; // DMA channel moving ROM bytes into the data output state machine
+static bool sram_loaded = false; // rom_sram already holds the ROM image (uploaded over USB)
+static mapper_t mapper; // Bank layout of the banked ROM, see loadrom_mapper
+static scc_t scc; // SCC of the Konami SCC mapper, registers written by the bus loop and synthesized by core 1
 
 // Write a byte to the data bus
+// The byte is queued for the output state machine, which drives the data bus until /RD goes high
 static inline void __not_in_flash_func(write_data_bus)(uint8_t data) {
-    // Write the given byte to the given address
-    gpio_put_masked(0xFF0000, data << 16);
-}
-
-// Set the data bus to input mode
-static inline void __not_in_flash_func(set_data_bus_input)(void) {
-    // Set data lines to input (high impedance)
-    gpio_set_dir(PIN_D0, GPIO_IN);
-    gpio_set_dir(PIN_D1, GPIO_IN);
-    gpio_set_dir(PIN_D2, GPIO_IN);
-    gpio_set_dir(PIN_D3, GPIO_IN);
-    gpio_set_dir(PIN_D4, GPIO_IN);
-    gpio_set_dir(PIN_D5, GPIO_IN);
-    gpio_set_dir(PIN_D6, GPIO_IN);
-    gpio_set_dir(PIN_D7, GPIO_IN);
-
-    //gpio_set_dir_in_masked(0xFF << 16);
-}
-
-// Set the data bus to output mode
-static inline void __not_in_flash_func(set_data_bus_output)(void)
-{
-    gpio_set_dir(PIN_D0, GPIO_OUT);
-    gpio_set_dir(PIN_D1, GPIO_OUT);
-    gpio_set_dir(PIN_D2, GPIO_OUT);
-    gpio_set_dir(PIN_D3, GPIO_OUT);
-    gpio_set_dir(PIN_D4, GPIO_OUT);
-    gpio_set_dir(PIN_D5, GPIO_OUT);
-    gpio_set_dir(PIN_D6, GPIO_OUT);
-    gpio_set_dir(PIN_D7, GPIO_OUT);
-
-    //gpio_init_mask(0xFF << 16);
-    //gpio_set_dir_out_masked(0xFF << 16);
-
+    pio_sm_put(pio, sm1, data);
 }
 
 static inline void setup_data_gpio()
@@ -133,98 +96,118 @@ static inline void setup_gpio()
     gpio_init(PIN_BUSSDIR); gpio_set_dir(PIN_BUSSDIR, GPIO_IN); gpio_pull_up(PIN_BUSSDIR);
 }
 
-//this is old... not used anymore
-void __no_inline_not_in_flash_func(sm0_irq_handler_plain32)() {
-
-    if (!pio_sm_is_rx_fifo_empty(pio, sm0)) {
-        uint32_t addr_val = pio_sm_get_blocking(pio, sm0);
-        uint16_t addr = (uint16_t) (addr_val>>16);        
-
-        if (addr >= 0x4000 && addr <= 0xBFFF) {
-           // printf("0x%x\n", addr);
-
-            //uint32_t rom_addr = 0x1d + (addr - 0x4000);
-                
-            // Write the data directly from ROM (with the appropriate shift)
-            //uint8_t data = rom[rom_addr];
-            //printf("Data before transfer: %x\n", rom[rom_addr]);
-            //printf("Data at ROM address %x: %x\n", rom_addr, *(rom + rom_addr));
-
-            //dma_channel_set_read_addr(dma_chan, rom+rom_addr, true);
-            
-            //pio_sm_set_out_pins(pio, sm1, DATA_PINS, 8);
-            //dma_channel_set_read_addr(dma_chan, rom_sram+(addr - 0x4000), true);
-
-            //pio_sm_set_in_pins(pio, sm1, DATA_PINS);
-           // dma_channel_start(dma_chan);
-           // dma_channel_wait_for_finish_blocking(dma_chan);
-
-           //uint8_t data_received_from_sm1 = pio_sm_get_blocking(pio, sm1);
-            //printf("Data received from SM1: %x\n", data_received_from_sm1);
-            //dma_channel_wait_for_finish_blocking(dma_chan);
-            //printf("Data transferred via DMA: %x\n", dummy_dst[0]);
-
-        }
-        
-    }
-}
-
 // setup the capture address PIO state machine
-void setup_pio_capture_addr() {
+// window is the 64KB aligned SRAM area that mirrors the MSX address space; the state machine pushes
+// window | address for every read cycle of this slot
+void setup_pio_capture_addr(const uint8_t *window) {
     
-    uint offset0 = pio_add_program(pio, &msx_capture_addr_program); // Load the PIO program
+    uint offset0 = msx_capture_addr_add_program(pio, PIN_RD); // Load the PIO program
     pio_sm_config c0 = msx_capture_addr_program_get_default_config(offset0); // Get the default configuration
 
     // Initialize the control signals and address pins as PIO GPIOs:
-    //pio_gpio_init(pio, PIN_RD);  // /RD
     pio_gpio_init(pio, PIN_SLTSL);  // /SLTSL
     for (int i = 0; i < 16; i++) pio_gpio_init(pio, ADDR_PINS + i); // A0-A15
     sm_config_set_in_pins(&c0, PIN_A0);  // Configure input pins
+    sm_config_set_jmp_pin(&c0, PIN_SLTSL);  // Reads with /SLTSL high are skipped
+    sm_config_set_in_shift(&c0, false, false, 32);  // Shift left, window base ends up in the upper 16 bits
 
-    sm_config_set_wrap(&c0, offset0, offset0 + msx_capture_addr_program.length - 1);
     sm_config_set_fifo_join(&c0, PIO_FIFO_JOIN_NONE);  // Separate RX and TX FIFOs
     sm_config_set_clkdiv(&c0, 1.0f);  // MSX bus timing adjust
 
     pio_sm_init(pio, sm0, offset0, &c0);
+    pio_sm_put(pio, sm0, (uint32_t)window >> 16); // Upper 16 bits of the SRAM window address
     pio_sm_set_enabled(pio, sm0, true);
 
 }
 
+// setup the data output PIO state machine
+// The state machine owns the data bus direction, it only drives GPIO 16–23 while /RD is low
 void setup_pio_output_data() {
 
     for (int i = 0; i < 8; i++) pio_gpio_init(pio, DATA_PINS + i);
     pio_gpio_init(pio, PIN_RD);  // /RD
 
     // ----- Set up SM1 for data output -----
-    uint offset1 = pio_add_program(pio, &msx_output_data_program);
+    uint offset1 = msx_output_data_add_program(pio, PIN_RD);
     pio_sm_config c1 = msx_output_data_program_get_default_config(offset1);
     sm_config_set_out_pins(&c1, DATA_PINS, 8);  // Configure the 'out' pins: data bus on GPIO 16–23.
-    sm_config_set_set_pins(&c1, DATA_PINS, 8);  // Configure set pins
-    sm_config_set_out_shift(&c1, true, true, 8);  // Enable autopull so SM1 automatically pulls an 8-bit value when needed.
-    pio_sm_set_consecutive_pindirs(pio, sm1, DATA_PINS, 8, true);  // Set pins as outputs    
+    sm_config_set_out_shift(&c1, true, false, 32);  // Shift right, the program pulls explicitly
+    pio_sm_set_consecutive_pindirs(pio, sm1, DATA_PINS, 8, false);  // Data bus released until a read is served
     pio_sm_init(pio, sm1, offset1, &c1);
     pio_sm_set_enabled(pio, sm1, true);
 
-    dma_chan = dma_claim_unused_channel(true);
-    dma_channel_config c = dma_channel_get_default_config(dma_chan);
-    channel_config_set_high_priority(&c, true);
-    channel_config_set_transfer_data_size(&c, DMA_SIZE_8); // Byte transfer
-    channel_config_set_read_increment(&c, false); // No increment for ROM data
-    channel_config_set_write_increment(&c, false); // No increment for PIO TX FIFO
-    channel_config_set_dreq(&c, pio_get_dreq(pio, sm1, true)); // Pace transfer with PIO TX FIFO
+}
+
+// setup the chained DMA pair that turns captured addresses into data bus bytes
+// The address channel waits for the capture state machine and writes the SRAM address into the read address
+// trigger register of the data channel. The data channel copies that byte to the output state machine and
+// chains back to the address channel, so the pair keeps running without CPU intervention.
+void setup_dma_read_path() {
+
+    dma_addr_chan = dma_claim_unused_channel(true);
+    dma_data_chan = dma_claim_unused_channel(true);
+
+    dma_channel_config cd = dma_channel_get_default_config(dma_data_chan);
+    channel_config_set_high_priority(&cd, true);
+    channel_config_set_transfer_data_size(&cd, DMA_SIZE_8); // Byte transfer
+    channel_config_set_read_increment(&cd, false); // Read address is set by the address channel
+    channel_config_set_write_increment(&cd, false); // No increment for PIO TX FIFO
+    channel_config_set_dreq(&cd, pio_get_dreq(pio, sm1, true)); // Pace transfer with PIO TX FIFO
+    channel_config_set_chain_to(&cd, dma_addr_chan); // Re-arm the address channel
 
     dma_channel_configure(
-        dma_chan,
-        &c,
+        dma_data_chan,
+        &cd,
         &pio->txf[sm1], // Write data to PIO SM1 TX FIFO
-        NULL, // Read address to be set in IRQ handler
+        NULL, // Read address written by the address channel
         1, // Transfer one byte
-        false // Don't start yet
+        false // Started by the address channel
+    );
+
+    dma_channel_config ca = dma_channel_get_default_config(dma_addr_chan);
+    channel_config_set_high_priority(&ca, true);
+    channel_config_set_transfer_data_size(&ca, DMA_SIZE_32); // SRAM address
+    channel_config_set_read_increment(&ca, false); // No increment for PIO RX FIFO
+    channel_config_set_write_increment(&ca, false); // Always the same register
+    channel_config_set_dreq(&ca, pio_get_dreq(pio, sm0, false)); // Pace transfer with PIO RX FIFO
+
+    dma_channel_configure(
+        dma_addr_chan,
+        &ca,
+        &dma_hw->ch[dma_data_chan].al3_read_addr_trig, // Set read address and trigger the data channel
+        &pio->rxf[sm0], // Read the captured address from PIO SM0 RX FIFO
+        1, // Transfer one address
+        true // Start waiting for the first read cycle
     );
 
 }
 
+// preload_rom_sram - Copy the ROM image into rom_sram by DMA while the MSX is held with WAIT
+// Parameters:
+//   offset - Offset of the ROM image after the program binary
+//   size   - Size of the ROM image in bytes, at most MAX_MEM_SIZE
+void preload_rom_sram(uint32_t offset, uint32_t size)
+{
+    if (sram_loaded)
+        return; // Uploaded over USB, already in place
+
+    int chan = dma_claim_unused_channel(true);
+    dma_channel_config c = dma_channel_get_default_config(chan);
+    channel_config_set_transfer_data_size(&c, DMA_SIZE_8); // The image starts at an odd offset after the header
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, true);
 
+    gpio_init(PIN_WAIT); gpio_set_dir(PIN_WAIT, GPIO_OUT);
+    gpio_put(PIN_WAIT, 0); // Wait until we are ready to read the ROM
+    uint32_t start = time_us_32();
+    dma_channel_configure(chan, &c, rom_sram, rom + offset, size, true);
+    dma_channel_wait_for_finish_blocking(chan);
+    uint32_t elapsed = time_us_32() - start;
+    gpio_put(PIN_WAIT, 1); // Lets go!
+    dma_channel_unclaim(chan);
+
+    printf("ROM mode: SRAM, %lu bytes loaded in %lu us\n", (unsigned long)size, (unsigned long)elapsed);
+}
 
 // Dump the ROM data in hexdump format
 // debug function
@@ -290,928 +273,211 @@ void dump_rom(uint32_t size)
     }
 }
 
-// loadrom_plain32 - Load a simple 32KB (or less) ROM into the MSX directly from the pico flash
-// 32KB ROMS have two pages of 16Kb each in the following areas:
-// 0x4000-0x7FFF and 0x8000-0xBFFF
-// AB is on 0x0000, 0x0001
-// 16KB ROMS have only one page in the 0x4000-0x7FFF area
-// AB is on 0x0000, 0x0001
-void __no_inline_not_in_flash_func(loadrom_plain32)(uint32_t offset)
+// loadrom_plain_pio - Load a plain 16/32KB or a 48KB Linear0 ROM into the MSX using PIO and DMA only
+// The ROM is copied into the 64KB aligned SRAM window while the MSX is held with WAIT. From then on the capture
+// state machine, the chained DMA pair and the output state machine (set up at boot) serve every read, leaving both
+// cores free.
+// base_addr is 0x4000 for 16/32KB ROMs (AB is on 0x4000, 0x4001) and 0x0000 for 48KB Linear0 ROMs.
+void loadrom_plain_pio(uint32_t offset, uint32_t size, uint16_t base_addr)
 {
-    // Pre-calculate the constant mask for the address bus.
-    const uint32_t ADDR_MASK = 0x00FFFF;
-    const uint32_t DATA_MASK = 0xFF << 16;
-
-    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
-    while (true) 
-    {
-        // Read entire GPIO state once (assuming gpio_get_all is fast enough)
-        uint32_t gpio_state = gpio_get_all();
-
-        // Extract individual signals; adjust these bit positions if needed
-        bool sltsl = !(gpio_state & (1 << PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_state & (1 << PIN_RD));         // Read cycle (active low)
-
-        if (sltsl && rd) 
-        {
-            uint16_t addr = gpio_state & ADDR_MASK;
-            if (addr >= 0x4000 && addr <= 0xBFFF)
-            {
-                uint32_t rom_addr = offset + (addr - 0x4000);
-                
-                // Only switch if necessary. Set bus to output mode
-                gpio_set_dir_out_masked(DATA_MASK);
-                
-                // Write the data directly from ROM (with the appropriate shift)
-                uint32_t data = rom[rom_addr] << 16;
-                gpio_put_masked(DATA_MASK, data);
-                
-                // Wait for RD to go high (read cycle complete)
-                while (!(gpio_get(PIN_RD))) 
-                {
-                    tight_loop_contents();
-                }
-                
-                // Set data bus back to input mode after cycle completes
-                gpio_set_dir_in_masked(DATA_MASK);
-            }
-        }
-    }
-}
-
-// Tests with PIO and DMA when loading 32KB roms
-void __no_inline_not_in_flash_func(loadrom_plain32_pio)(uint32_t offset)
-{
-    setup_pio_capture_addr(); // Setup the address capture PIO state machine
-    setup_pio_output_data(); // Setup the data output PIO state machine
-
-    //gpio_init_mask(0xFF << 16); 
-
-    while (true) 
-    {
-        uint16_t addr = (uint16_t)(pio_sm_get_blocking(pio, sm0) >> 16); // Read the address bus   
-
-        if (addr >= 0x4000 && addr <= 0xBFFF) 
-        {
-            uint32_t rom_addr = offset + (addr - 0x4000);
-            dma_channel_set_read_addr(dma_chan, rom+rom_addr, true);
-        }
-
-    }
-   
-    
-}
-
-// loadrom_plain32 - Load a simple 32KB (or less) ROM into the MSX using SRAM buffer
-// 32KB ROMS have two pages of 16Kb each in the following areas:
-// 0x4000-0x7FFF and 0x8000-0xBFFF
-// AB is on 0x0000, 0x0001
-// 16KB ROMS have only one page in the 0x4000-0x7FFF area
-// AB is on 0x0000, 0x0001
-void loadrom_plain32_sram(uint32_t offset, uint32_t size)
-{
-    //setup the rom_sram buffer for the 32KB ROM
     gpio_init(PIN_WAIT); // Init wait signal pin
     gpio_set_dir(PIN_WAIT, GPIO_OUT); // Set the WAIT signal as output
     gpio_put(PIN_WAIT, 0); // Wait until we are ready to read the ROM
-    memset(rom_sram, 0, size); // Clear the SRAM buffer
-    memcpy(rom_sram + 0x4000, rom + offset, size); //for 32KB ROMs we start at 0x4000
-    gpio_put(PIN_WAIT, 1); // Lets go!
-
-    // Set data bus to input mode
-    set_data_bus_input();
-    while (true) 
+    const uint8_t *image = rom + offset;
+    if (sram_loaded) // Uploaded over USB at the start of rom_sram, move it out of the way of the window
     {
-         // Check control signals
-         bool sltsl = (gpio_get(PIN_SLTSL) == 0); // Slot select (active low)
-         bool rd = (gpio_get(PIN_RD) == 0);       // Read cycle (active low)
-
-         if (sltsl) {
-
-            uint16_t addr = read_address_bus();
-            if (addr >= 0x4000 && addr <= 0xBFFF) // Check if the address is within the ROM range
-            {
-                if (rd)
-                {
-                    set_data_bus_output(); // Drive data bus to output mode
-                    write_data_bus(rom_sram[addr]);  // Drive data onto the bus
-                    while (gpio_get(PIN_RD) == 0)  // Wait until the read cycle completes (RD goes high)
-                    {
-                        tight_loop_contents();
-                    }
-                    set_data_bus_input(); // Return data lines to input mode after cycle completes
-                }
-            } 
-         }
+        size = (size > 0xC000) ? 0xC000 : size;
+        memmove(rom_sram + 0x10000, rom_sram, size);
+        image = rom_sram + 0x10000;
     }
-}
-
+    plain_window_build(rom_sram, image, size, base_addr);
 
-// loadrom_linear48 - Load a simple 48KB Linear0 ROM into the MSX directly from the pico flash
-// Those ROMs have three pages of 16Kb each in the following areas:
-// 0x0000-0x3FFF, 0x4000-0x7FFF and 0x8000-0xBFFF
-// AB is on 0x4000, 0x4001
-void __no_inline_not_in_flash_func(loadrom_linear48)(uint32_t offset)
-{
-    const uint32_t DATA_BUS_MASK = 0xFF << 16;
-    const uint32_t ADDR_MASK = 0x00FFFF;
-    
-    // Initially set the data bus to input mode.
-    gpio_set_dir_in_masked(DATA_BUS_MASK);
+    setup_dma_read_path(); // Setup the DMA channels linking both state machines
+    setup_pio_capture_addr(rom_sram); // Setup the address capture PIO state machine
+    gpio_put(PIN_WAIT, 1); // Lets go!
 
     while (true) 
     {
-        // Read the entire GPIO state once per loop iteration.
-        uint32_t gpio_state = gpio_get_all();
-
-        // Extract control signals from the read state.
-        bool sltsl = !(gpio_state & (1 << PIN_SLTSL)); // Slot selected (active low)
-        bool rd    = !(gpio_state & (1 << PIN_RD));    // Read cycle (active low)
-
-        // Proceed only if both slot select and read are active.
-        if (sltsl && rd)
-        {
-            // Get the address bus value.
-            uint16_t addr = gpio_state & ADDR_MASK;
-            // Since addr is always >= 0, we only check the upper bound.
-            if (addr <= 0xBFFF)
-            {
-                uint32_t rom_addr = offset + addr;
-                // Switch the data bus to output mode.
-                gpio_set_dir_out_masked(DATA_BUS_MASK);
-                // Write the ROM data (shifted to match the data bus position).
-                gpio_put_masked(DATA_BUS_MASK, rom[rom_addr] << 16);
-
-                // Wait until the read cycle completes (RD goes high).
-                while ((gpio_get_all() & (1 << PIN_RD)) == 0)
-                {
-                    tight_loop_contents();
-                }
-                // Return the data bus to input mode.
-                gpio_set_dir_in_masked(DATA_BUS_MASK);
-            }
-        }
+        __wfe(); // Nothing left to do for the CPU
     }
 }
 
-// loadrom_linear48 - Load a simple 48KB Linear0 ROM into the MSX using SRAM buffer
-// Those ROMs have three pages of 16Kb each in the following areas:
-// 0x0000-0x3FFF, 0x4000-0x7FFF and 0x8000-0xBFFF
-// AB is on 0x4000, 0x4001
-void loadrom_linear48_sram(uint32_t offset, uint32_t size)
+// loadrom_mapper - Load a banked ROM into the MSX using the table driven mapper engine
+// The bank layouts are the ones of the multirom firmwares (common/multirom/mapper.c): a read is served from the
+// page pointer of its 8KB page and a write to a bank register rebuilds the pointers it drives.
+// With the Konami SCC mapper the SCC registers are mapped at 9800h - 98FFh while 3Fh is in bank 3, see scc.h
+// Parameters:
+//   offset      - Offset of the ROM image after the program binary
+//   size        - Size of the ROM image in bytes
+//   mapper_type - Mapper code of the ROM (mapper_codes.h)
+//   sram        - Serve the image from rom_sram, where bank values wrap on it, instead of the pico flash
+void __no_inline_not_in_flash_func(loadrom_mapper)(uint32_t offset, uint32_t size, uint8_t mapper_type, bool sram)
 {
-    // load the ROM into the SRAM buffer
-    gpio_init(PIN_WAIT); gpio_set_dir(PIN_WAIT, GPIO_OUT);
-    gpio_put(PIN_WAIT, 0); // Wait until we are ready to read the ROM
-    memset(rom_sram, 0, size); // Clear the SRAM buffer
-    memcpy(rom_sram, rom + offset, size);  // for 48KB Linear0 ROMs we start at 0x0000
-    gpio_put(PIN_WAIT, 1); // Lets go!
-
-    set_data_bus_input();     // Set data bus to input mode
-    while (true) 
+    if (!mapper_init(&mapper, mapper_type, sram ? rom_sram : rom + offset))
     {
-        // Check control signals
-        bool sltsl = (gpio_get(PIN_SLTSL) == 0); // Slot select (active low)
-        bool rd = (gpio_get(PIN_RD) == 0);       // Read cycle (active low)
-
-        if (sltsl)
-        {
-            uint16_t addr = read_address_bus();
-            if (rd)
-            {
-                if (addr >= 0x0000 && addr <= 0xBFFF) // Check if the address is within the ROM range
-                {
-                    set_data_bus_output();  // Drive data bus to output mode
-                    write_data_bus(rom_sram[addr]); // Drive data onto the bus
-                    while (gpio_get(PIN_RD) == 0) // Wait until the read cycle completes (RD goes high)
-                    {
-                        tight_loop_contents();
-                    }
-                    set_data_bus_input(); // Return data lines to input mode after cycle completes
-                }
-            }
-        }
+        printf("Unknown ROM type: %d\n", mapper_type);
+        return;
     }
-}
-
-
-// loadrom_konamiscc - Load a any Konami SCC ROM into the MSX directly from the pico flash
-// The KonamiSCC ROMs are divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments 
-// into the MSX's address space. Since the size of the mapper is 8Kb, the memory banks are:
-// Bank 1: 4000h - 5FFFh , Bank 2: 6000h - 7FFFh, Bank 3: 8000h - 9FFFh, Bank 4: A000h - BFFFh
-// And the address to change banks are:
-// Bank 1: 5000h - 57FFh (5000h used), Bank 2: 7000h - 77FFh (7000h used), Bank 3: 9000h - 97FFh (9000h used), Bank 4: B000h - B7FFh (B000h used)
-// AB is on 0x0000, 0x0001
-void __no_inline_not_in_flash_func(loadrom_konamiscc)(uint32_t offset)
-{
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
-
-    const uint32_t DATA_MASK = 0xFF << 16;
-    const uint32_t ADDR_MASK = 0x00FFFF;
-
-    gpio_set_dir_in_masked(DATA_MASK); // Set data bus to input mode
-    while (true) 
+    if (sram)
     {
-        // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        
-        if (sltsl)
-        {
-            uint32_t gpio_state = gpio_get_all();
-
-            uint16_t addr = gpio_state & ADDR_MASK; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF)  // Check if the address is within the ROM range
-            {
-                bool rd = !(gpio_state & (1 << PIN_RD));
-                bool wr = !(gpio_state & (1 << PIN_WR));
-
-                if (rd) 
-                {
-                    gpio_set_dir_out_masked(DATA_MASK); // Set data bus to output mode
-                    uint32_t rom_offset = offset + (bank_registers[(addr - 0x4000) >> 13] * 0x2000) + (addr & 0x1FFF); // Calculate the ROM offset
-                    uint32_t data = rom[rom_offset] << 16; // Read the data from the ROM
-                    gpio_put_masked(0xFF0000, data); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD)))  {tight_loop_contents();}
-             
-                    gpio_set_dir_in_masked(DATA_MASK); // Return data bus to input mode after cycle completes
-                }  else if (wr) 
-                {
-                    // Handle writes to bank switching addresses
-                    if ((addr >= 0x5000)  && (addr <= 0x57FF)) { 
-                        bank_registers[0] = (gpio_state >> 16) & 0xFF;
-                    } else if ((addr >= 0x7000) && (addr <= 0x77FF)) {
-                        bank_registers[1] = (gpio_state >> 16) & 0xFF;
-                    } else if ((addr >= 0x9000) && (addr <= 0x97FF)) {
-                        bank_registers[2] = (gpio_state >> 16) & 0xFF;
-                    } else if ((addr >= 0xB000) && (addr <= 0xB7FF)) {
-                        bank_registers[3] = (gpio_state >> 16) & 0xFF;
-                    }
-
-                    while (!(gpio_get(PIN_WR))) {tight_loop_contents();}
-                   
-                }  
-            }
-        }
+        preload_rom_sram(offset, size); // Load the ROM into the SRAM buffer
+        mapper_attach_sram(&mapper, size);
     }
-}
-
-void __no_inline_not_in_flash_func(loadrom_konamiscc_pio)(uint32_t offset)
-{
-    setup_pio_capture_addr(); // Setup the address capture PIO state machine
-    setup_pio_output_data(); // Setup the data output PIO state machine
 
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
+    bool konamiscc = (mapper_type == MAPPER_KONAMISCC);
+    bool scc_on = false; // The SCC registers are mapped at 9800h-98FFh
 
-    const uint32_t DATA_MASK = 0xFF << 16;
-    const uint32_t ADDR_MASK = 0x00FFFF;
-
-    gpio_set_dir_in_masked(DATA_MASK); // Set data bus to input mode
     while (true) 
     {
-        uint16_t addr = (uint16_t)(pio_sm_get_blocking(pio, sm0) >> 16); // Read the address bus   
+        uint32_t gpio_state = bus_sample(); // Sample control signals and address bus at once
 
-        if (addr >= 0x4000 && addr <= 0xBFFF) 
+        if (bus_active(gpio_state, BUS_SLOT_READ_MASK)) // Read cycle on this slot (both active low)
         {
-            bool rd = !(gpio_get(PIN_RD)); 
-            bool wr = !(gpio_get(PIN_WR)); 
-
-            if (rd) {
-                uint32_t rom_addr = offset + (addr - 0x4000);
-                dma_channel_set_read_addr(dma_chan, rom+rom_addr, true);
-            }
-            else if (wr) 
+            uint16_t addr = bus_addr(gpio_state);
+            const uint8_t *data = mapper_read_ptr(&mapper, addr);
+            if (scc_on && scc_register(addr))
+                write_data_bus(scc_read(&scc, addr)); // SCC waveform
+            else if (data)
+                write_data_bus(*data);
+            else
+                continue; // Page not mapped, the bus is left alone
+            while (!(bus_sample() & BUS_RD_MASK)) // Wait until the read cycle completes (RD goes high)
             {
-                // Handle writes to bank switching addresses
-                if ((addr >= 0x5000)  && (addr <= 0x57FF)) { 
-                    bank_registers[0] = (gpio_get_all() >> 16) & 0xFF;
-                } else if ((addr >= 0x7000) && (addr <= 0x77FF)) {
-                    bank_registers[1] = (gpio_get_all() >> 16) & 0xFF;
-                } else if ((addr >= 0x9000) && (addr <= 0x97FF)) {
-                    bank_registers[2] = (gpio_get_all() >> 16) & 0xFF;
-                } else if ((addr >= 0xB000) && (addr <= 0xB7FF)) {
-                    bank_registers[3] = (gpio_get_all() >> 16) & 0xFF;
-                }
-
-                while (!(gpio_get(PIN_WR))) {tight_loop_contents();}
+                tight_loop_contents();
             }
-
         }
-
-    }
-}
-
-// loadrom_konamiscc - Load a Konami SCC ROM (maximum of 128KB) into the MSX using SRAM buffer
-// The KonamiSCC ROMs are divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments 
-// into the MSX's address space. Since the size of the mapper is 8Kb, the memory banks are:
-//
-// Bank 1: 4000h - 5FFFh , Bank 2: 6000h - 7FFFh, Bank 3: 8000h - 9FFFh, Bank 4: A000h - BFFFh
-//
-// And the address to change banks are:
-//
-// Bank 1: 5000h - 57FFh (5000h used), Bank 2: 7000h - 77FFh (7000h used), Bank 3: 9000h - 97FFh (9000h used), Bank 4: B000h - B7FFh (B000h used)
-// AB is on 0x0000, 0x0001
-void loadrom_konamiscc_sram(uint32_t offset, uint32_t size)
-{
-    if (size > MAX_MEM_SIZE)
-    {
-        return;
-    }
-
-    // Load the ROM into the SRAM buffer
-    gpio_init(PIN_WAIT); gpio_set_dir(PIN_WAIT, GPIO_OUT);
-    gpio_put(PIN_WAIT, 0); // Wait until we are ready to read the ROM
-    memset(rom_sram, 0, size+offset); // Clear the SRAM buffer
-    memcpy(rom_sram, rom, size+offset);  // for 128KB KonamiSCC ROMs we start at 0x0000
-    gpio_put(PIN_WAIT, 1); // Lets go!
-
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
-
-    set_data_bus_input();
-    while (true) 
-    {
-        bool sltsl = (gpio_get(PIN_SLTSL) == 0); // Slot selected (active low)
-        bool rd = (gpio_get(PIN_RD) == 0);       // Read cycle (active low)
-        bool wr = (gpio_get(PIN_WR) == 0);       // Write cycle (active low)
-
-        if (sltsl)
+        else if (bus_active(gpio_state, BUS_SLOT_WRITE_MASK)) // Write cycle on this slot
         {
-            uint16_t addr = read_address_bus();
-            if (addr >= 0x4000 && addr <= 0xBFFF) 
+            uint16_t addr = bus_addr(gpio_state);
+            uint8_t value = bus_data(bus_sample()); // Data is valid while WR is low
+            if (scc_on && scc_register(addr))
+                scc_write(&scc, addr, value);
+            else
             {
-                if (rd) 
-                {
-                    uint16_t bank_index = (addr - 0x4000) / 0x2000; // Calculate the bank index
-                    uint16_t bank_offset = addr & 0x1FFF; // Calculate the offset within the bank
-                    uint32_t rom_offset = (bank_registers[bank_index] * 0x2000) + bank_offset + offset; // Calculate the ROM offset
-                    set_data_bus_output();
-                    write_data_bus(rom_sram[rom_offset]); // Drive data onto the bus
-                    while (gpio_get(PIN_RD) == 0) 
-                    {
-                        tight_loop_contents();
-                    }
-                    set_data_bus_input();
-                } else if (wr) 
-                {
-                    // Handle writes to bank switching addresses
-                    if (addr == 0x5000) {
-                        bank_registers[0] = read_data_bus(); // Read the data bus and store in bank register
-                    } else if (addr == 0x7000) {
-                        bank_registers[1] = read_data_bus();
-                    } else if (addr == 0x9000) {
-                        bank_registers[2] = read_data_bus();
-                    } else if (addr == 0xB000) {
-                        bank_registers[3] = read_data_bus();
-                    }
-
-                    while (!(gpio_get(PIN_WR)))
-                    {
-                        tight_loop_contents();
-                    }
-                }
+                mapper_write(&mapper, addr, value);
+                if (konamiscc && (addr & 0xF800) == 0x9000)
+                    scc_on = scc_enabled(value); // The SCC value is checked before the wrap
             }
-        }
-    }
-}
-
-// loadrom_konami - Load a Konami (without SCC) ROM into the MSX directly from the pico flash
-// The Konami (without SCC) ROM is divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Since the size of the mapper is 8Kb, the memory banks are:
-//
-//  Bank 1: 4000h - 5FFFh, Bank 2: 6000h - 7FFFh, Bank 3: 8000h - 9FFFh, Bank 4: A000h - BFFFh
-//
-// And the addresses to change banks are:
-//
-//	Bank 1: <none>, Bank 2: 6000h - 67FFh (6000h used), Bank 3: 8000h - 87FFh (8000h used), Bank 4: A000h - A7FFh (A000h used)
-// AB is on 0x0000, 0x0001
-void __no_inline_not_in_flash_func(loadrom_konami)(uint32_t offset)
-{
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
-
-    gpio_set_dir_in_masked(0xFF << 16);
-    while (true) 
-    {
-        // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
-
-        if (sltsl)
-        {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF) 
+            while (!(bus_sample() & BUS_WR_MASK)) // Wait until the write cycle completes (WR goes high)
             {
-                if (rd) 
-                {
-                    gpio_set_dir_out_masked(0xFF << 16);
-                    uint32_t rom_offset = offset + (bank_registers[(addr - 0x4000) >> 13] * 0x2000) + (addr & 0x1FFF); // Calculate the ROM offset
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16);
-                    while (!(gpio_get(PIN_RD))) 
-                    {
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16);
-
-                }else if (wr) {
-                    // Handle writes to bank switching addresses
-                    if ((addr >= 0x6000) && (addr <= 0x67FF)) {
-                        bank_registers[1] = read_data_bus();
-                    } else if ((addr >= 0x8000) && (addr <= 0x87FF)) {
-                        bank_registers[2] = read_data_bus();
-                    } else if ((addr >= 0xA000) && (addr <= 0xA7FF)) {
-                        bank_registers[3] = read_data_bus();
-                    }
-
-                    while (!(gpio_get(PIN_WR))) 
-                    {
-                        tight_loop_contents();
-                    }
-                }
+                tight_loop_contents();
             }
         }
     }
 }
 
-
-// loadrom_konami - Load a Konami (without SCC) ROM (MAXIMUM of 128KB) into the MSX using SRAM buffer
-// The Konami (without SCC) ROM is divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Since the size of the mapper is 8Kb, the memory banks are:
-//
-// Bank 1: 4000h - 5FFFh, Bank 2: 6000h - 7FFFh, Bank 3: 8000h - 9FFFh, Bank 4: A000h - BFFFh
-//
-// And the addresses to change banks are:
+// loadrom_megaram - Serve a writable ASCII8 style MegaRAM from the SRAM buffer
+// MegaRAM development mode: MEGARAM_SIZE bytes of SRAM split in 8KB pages, mapped with the ASCII8 bank registers.
+// Like the MegaRAM cartridges, an OUT to MEGARAM_PORT enables writes to the pages, and an IN from it goes back to
+// bank switching, so an MSX side loader selects a page, enables writes and fills it. The image from flash or from a
+// USB upload (see usbload.h) is the initial content, the rest of the RAM reads 0xFF. Nothing is written to the flash.
 //
-// Bank 1: <none>, Bank 2: 6000h - 67FFh (6000h used), Bank 3: 8000h - 87FFh (8000h used), Bank 4: A000h - A7FFh (A000h used)
-// AB is on 0x0000, 0x0001
-void loadrom_konami_sram(uint32_t offset, uint32_t size)
-{
-    gpio_init(PIN_WAIT); gpio_set_dir(PIN_WAIT, GPIO_OUT);
-    gpio_put(PIN_WAIT, 0); // Wait until we are ready to read the ROM
-    memset(rom_sram, 0, size+offset); // Clear the SRAM buffer
-    memcpy(rom_sram, rom, size+offset);  // for 12KB KonamiSCC ROMs we start at 0x0000
-    gpio_put(PIN_WAIT, 1); // Lets go!
-
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
-
-    set_data_bus_input();
-    while (true) 
-    {
-        bool sltsl = (gpio_get(PIN_SLTSL) == 0); // Slot selected (active low)
-        bool rd = (gpio_get(PIN_RD) == 0);       // Read cycle (active low)
-        bool wr = (gpio_get(PIN_WR) == 0);       // Write cycle (active low)
-
-        if (sltsl) {
-            uint16_t addr = read_address_bus();
-
-            if (rd) {
-                // Handle read requests within the ROM address range
-                if (addr >= 0x4000 && addr <= 0xBFFF) {
-                    // Determine the bank index based on the address
-                    uint8_t bank_index = (addr - 0x4000) / 0x2000;
-                    uint16_t bank_offset = addr & 0x1FFF;
-                    uint32_t rom_offset = (bank_registers[bank_index] * 0x2000) + bank_offset + offset;
-
-                    // Set data bus to output mode and write the data
-                    set_data_bus_output();
-                    write_data_bus(rom_sram[rom_offset]);
-
-                    // Wait for the read cycle to complete
-                    while (gpio_get(PIN_RD) == 0) {
-                        tight_loop_contents();
-                    }
-
-                    // Return data bus to input mode after the read cycle
-                    set_data_bus_input();
-                }
-            } else if (wr) {
-                // Handle writes to bank switching addresses
-                if (addr == 0x6000) {
-                    bank_registers[1] = read_data_bus();
-                } else if (addr == 0x8000) {
-                    bank_registers[2] = read_data_bus();
-                } else if (addr == 0xA000) {
-                    bank_registers[3] = read_data_bus();
-                }
-
-                while (!(gpio_get(PIN_WR))) {
-                    tight_loop_contents();
-                }
-            }
-        }
-    }
-}
-
-// loadrom_ascii8 - Load an ASCII8 ROM into the MSX directly from the pico flash
-// The ASCII8 ROM is divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Since the size of the mapper is 8Kb, the memory banks are:
-// 
 // Bank 1: 4000h - 5FFFh , Bank 2: 6000h - 7FFFh, Bank 3: 8000h - 9FFFh, Bank 4: A000h - BFFFh
 //
-// And the address to change banks are:
-// 
-// Bank 1: 6000h - 67FFh (6000h used), Bank 2: 6800h - 6FFFh (6800h used), Bank 3: 7000h - 77FFh (7000h used), Bank 4: 7800h - 7FFFh (7800h used)
-// AB is on 0x0000, 0x0001
-void __no_inline_not_in_flash_func(loadrom_ascii8)(uint32_t offset)
-{
-
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
-
-    gpio_set_dir_in_masked(0xFF << 16);
-    while (true) 
-    {
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
-
-        if (sltsl) {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF) 
-            {
-                if (rd) 
-                {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    uint32_t rom_offset = offset + (bank_registers[(addr - 0x4000) >> 13] * 0x2000) + (addr & 0x1FFF); // Calculate the ROM offset
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD)))  { // Wait for the read cycle to complete
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after the read cycle
-                } else if (wr)  // Handle writes to bank switching addresses
-                { 
-                    if ((addr >= 0x6000) && (addr <= 0x67FF)) { 
-                        bank_registers[0] = read_data_bus(); // Read the data bus and store in bank register
-                        //printf("Bank 1: %d\n", bank_registers[0]);
-                    } else if ((addr >= 0x6800) && (addr <= 0x6FFF)) {
-                        bank_registers[1] = read_data_bus();
-                        //printf("Bank 2: %d\n", bank_registers[1]);
-                    } else if ((addr >= 0x7000) && (addr <= 0x77FF)) {
-                        bank_registers[2] = read_data_bus();
-                        //printf("Bank 3: %d\n", bank_registers[2]);
-                    } else if ((addr >= 0x7800) && (addr <= 0x7FFF)) {
-                        bank_registers[3] = read_data_bus();
-                        //printf("Bank 4: %d\n", bank_registers[3]);
-                    }
-
-                    while (!(gpio_get(PIN_WR))) 
-                    {
-                        tight_loop_contents();
-                    }
-                }
-            }
-        }
-    }
-}
-
-// loadrom_ascii8 - Load an ASCII8 ROM into the MSX using SRAM buffer
-// The ASCII8 ROM is divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Since the size of the mapper is 8Kb, the memory banks are:
-// 
-// Bank 1: 4000h - 5FFFh , Bank 2: 6000h - 7FFFh, Bank 3: 8000h - 9FFFh, Bank 4: A000h - BFFFh
+// And the address to change banks are (writes disabled only):
 //
-// And the address to change banks are:
-// 
 // Bank 1: 6000h - 67FFh (6000h used), Bank 2: 6800h - 6FFFh (6800h used), Bank 3: 7000h - 77FFh (7000h used), Bank 4: 7800h - 7FFFh (7800h used)
-// AB is on 0x0000, 0x0001
-void loadrom_ascii8_sram(uint32_t offset, uint32_t size)
+void __no_inline_not_in_flash_func(loadrom_megaram)(uint32_t offset, uint32_t size)
 {
-    gpio_init(PIN_WAIT); gpio_set_dir(PIN_WAIT, GPIO_OUT);
-    gpio_put(PIN_WAIT, 0); // Wait until we are ready to read the ROM
-    memset(rom_sram, 0, MAX_MEM_SIZE); // Clear the SRAM buffer
-    memcpy(rom_sram, rom + offset, size);  // for 12KB KonamiSCC ROMs we start at 0x0000
-    gpio_put(PIN_WAIT, 1); // Lets go!
+    if (size > MEGARAM_SIZE)
+        size = MEGARAM_SIZE;
+    preload_rom_sram(offset, size);
+    memset(rom_sram + size, 0xFF, MEGARAM_SIZE - size);
+    printf("ROM mode: MegaRAM, %lu KB, %lu bytes of initial content, write enable on port %02Xh\n",
+           (unsigned long)(MEGARAM_SIZE >> 10), (unsigned long)size, MEGARAM_PORT);
 
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
+    mapper_init(&mapper, MAPPER_ASCII8, rom_sram); // The pages point to rom_sram and are written in place
+    mapper_attach_sram(&mapper, MEGARAM_SIZE); // Bank values wrap on the 32 pages
+    bool write_enabled = false;
 
-    set_data_bus_input();
     while (true) 
     {
-        bool sltsl = (gpio_get(PIN_SLTSL) == 0); // Slot selected (active low)
-        bool rd = (gpio_get(PIN_RD) == 0);       // Read cycle (active low)
-        bool wr = (gpio_get(PIN_WR) == 0);       // Write cycle (active low)
-
-        if (sltsl) {
-            uint16_t addr = read_address_bus();
-
-            if (rd) {
-                // Handle read requests within the ROM address range
-                if (addr >= 0x4000 && addr <= 0xBFFF) {
-                    // Determine the bank index based on the address
-                    uint32_t rom_offset = (bank_registers[(addr - 0x4000) / 0x2000] * 0x2000) + (addr & 0x1FFF);
-
-                    // Set data bus to output mode and write the data
-                    set_data_bus_output();
-                    write_data_bus(rom_sram[rom_offset]);
-
-                    // Wait for the read cycle to complete
-                    while (gpio_get(PIN_RD) == 0) {
-                        tight_loop_contents();
-                    }
-
-                    // Return data bus to input mode after the read cycle
-                    set_data_bus_input();
-                }
-            } else if (wr) {
-                // Handle writes to bank switching addresses
-                if (addr == 0x6000) {
-                    bank_registers[0] = read_data_bus(); // Read the data bus and store in bank register
-                } else if (addr == 0x6800) {
-                    bank_registers[1] = read_data_bus();
-                } else if (addr == 0x7000) {
-                    bank_registers[2] = read_data_bus();
-                } else if (addr == 0x7800) {
-                    bank_registers[3] = read_data_bus();
-                }
-                while (!(gpio_get(PIN_WR))) {
-                    tight_loop_contents();
-                }
+        uint32_t gpio_state = bus_sample(); // Sample control signals and address bus at once
+        uint16_t addr = bus_addr(gpio_state);
+
+        if (bus_active(gpio_state, BUS_SLOT_READ_MASK)) {
+            const uint8_t *data = mapper_read_ptr(&mapper, addr);
+            if (!data)
+                continue;
+            write_data_bus(*data);
+            while (!(bus_sample() & BUS_RD_MASK)) { // Wait for the read cycle to complete
+                tight_loop_contents();
             }
-        }
-    }
-}
-
-// loadrom_ascii16 - Load an ASCII16 ROM into the MSX directly from the pico flash
-// The ASCII16 ROM is divided into 16KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Since the size of the mapper is 16Kb, the memory banks are:
-//
-// Bank 1: 4000h - 7FFFh , Bank 2: 8000h - BFFFh
-//
-// And the address to change banks are:
-// Bank 1: 6000h - 67FFh (6000h used), Bank 2: 7000h - 77FFh (7000h and 77FFh used)
-void __no_inline_not_in_flash_func(loadrom_ascii16)(uint32_t offset)
-{
-    uint8_t bank_registers[2] = {0, 1}; // Initial banks 0 and 1 mapped
-
-    gpio_set_dir_in_masked(0xFF << 16);
-    while (true) {
-        // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
-
-        if (sltsl) {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF)  
-            {
-                if (rd) {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    uint32_t rom_offset = offset + (bank_registers[(addr >> 15) & 1] << 14) + (addr & 0x3FFF);
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD)))  // Wait for the read cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after the read cycle
+        } else if (bus_active(gpio_state, BUS_SLOT_WRITE_MASK)) {
+            uint8_t *data = (uint8_t *)mapper_read_ptr(&mapper, addr);
+            if (write_enabled && data)
+                *data = bus_data(bus_sample()); // Page write
+            else if (!write_enabled)
+                mapper_write(&mapper, addr, bus_data(bus_sample())); // 6000h, 6800h, 7000h, 7800h
+            while (!(bus_sample() & BUS_WR_MASK)) {
+                tight_loop_contents();
+            }
+        } else if (bus_active(gpio_state, BUS_IORQ_MASK) && (addr & 0xFF) == MEGARAM_PORT) {
+            if (!(gpio_state & BUS_WR_MASK)) {
+                write_enabled = true;
+                while (!(bus_sample() & BUS_WR_MASK)) {
+                    tight_loop_contents();
                 }
-                else if (wr) 
-                {
-                    // Update bank registers based on the specific switching addresses
-                    if ((addr >= 0x6000) && (addr <= 0x67FF)) {
-                        bank_registers[0] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if (addr >= 0x7000 && addr <= 0x77FF) {
-                        bank_registers[1] = (gpio_get_all() >> 16) & 0xFF;
-                    }
-                    while (!(gpio_get(PIN_WR))) {
-                        tight_loop_contents();
-                    }
+            } else if (!(gpio_state & BUS_RD_MASK)) {
+                write_enabled = false; // The bus is not driven, the MSX reads 0xFF
+                while (!(bus_sample() & BUS_RD_MASK)) {
+                    tight_loop_contents();
                 }
-                
             }
         }
     }
 }
 
-// loadrom_neo8 - Load an NEO8 ROM into the MSX directly from the pico flash
-// The NEO8 ROM is divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Size of a segment: 8 KB
-// Segment switching addresses:
-// Bank 0: 0000h~1FFFh, Bank 1: 2000h~3FFFh, Bank 2: 4000h~5FFFh, Bank 3: 6000h~7FFFh, Bank 4: 8000h~9FFFh, Bank 5: A000h~BFFFh
-// Switching address: 
-// 5000h (mirror at 1000h, 9000h and D000h), 
-// 5800h (mirror at 1800h, 9800h and D800h), 
-// 6000h (mirror at 2000h, A000h and E000h), 
-// 6800h (mirror at 2800h, A800h and E800h), 
-// 7000h (mirror at 3000h, B000h and F000h), 
-// 7800h (mirror at 3800h, B800h and F800h)
-void __no_inline_not_in_flash_func(loadrom_neo8)(uint32_t offset)
+// scc_audio - Core 1 loop of the Konami SCC mapper: synthesize the SCC into the I2S DAC
+// The DAC is driven as in the loadmp3 firmware of the audio cartridge, from PIO 1 (PICO_AUDIO_I2S_PIO) since the
+// bus uses PIO 0. Core 1 also keeps the USB upload watch, polled between two buffers. The worst render time of a
+// buffer is printed when it grows, against the time the buffer takes to play.
+void scc_audio()
 {
-    uint16_t bank_registers[6] = {0}; // 16-bit bank registers initialized to zero (12-bit segment, 4 MSB reserved)
-
-    gpio_set_dir_in_masked(0xFF << 16);    // Configure GPIO pins for input mode
-    while (true)
+    static audio_format_t audio_format = {
+        .sample_freq = SCC_SAMPLE_RATE,
+        .format = AUDIO_BUFFER_FORMAT_PCM_S16,
+        .channel_count = 2,
+    };
+
+    static struct audio_buffer_format producer_format = {
+        .format = &audio_format,
+        .sample_stride = 4,
+    };
+
+    static const struct audio_i2s_config config = {
+        .data_pin = PIN_I2S_DATA,
+        .clock_pin_base = PIN_I2S_BCLK,
+        .dma_channel = SCC_DMA_CHANNEL,
+        .pio_sm = 0,
+    };
+
+    struct audio_buffer_pool *pool = audio_new_producer_pool(&producer_format, 3, SCC_BUFFER_SAMPLES);
+    if (!pool || !audio_i2s_setup(&audio_format, &config) || !audio_i2s_connect(pool))
     {
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
-
-        if (sltsl)
-        {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read address bus
-
-            if (addr <= 0xBFFF)
-            {
-                if (rd)
-                {
-                    // Handle read access
-                    gpio_set_dir_out_masked(0xFF << 16); // Data bus output mode
-                    uint8_t bank_index = addr >> 13;     // Determine bank index (0-5)
-
-                    if (bank_index < 6)
-                    {
-                        uint32_t segment = bank_registers[bank_index] & 0x0FFF; // 12-bit segment number
-                        uint32_t rom_offset = offset + (segment << 13) + (addr & 0x1FFF); // Calculate ROM offset
-                        gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Place data on data bus
-                    }
-                    else
-                    {
-                        gpio_put_masked(0xFF0000, 0xFF << 16); // Invalid page handling (Page 3)
-                    }
-
-                    while (!(gpio_get(PIN_RD))) // Wait for read cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
-
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode
-                }
-                else if (wr)
-                {
-                    // Handle write access
-                    uint16_t base_addr = addr & 0xF800; // Mask to identify base address
-                    uint8_t bank_index = 6;             // Initialize to invalid bank
-
-                    // Determine bank index based on base address
-                    switch (base_addr)
-                    {
-                        case 0x5000:
-                        case 0x1000:
-                        case 0x9000:
-                        case 0xD000:
-                            bank_index = 0;
-                            break;
-                        case 0x5800:
-                        case 0x1800:
-                        case 0x9800:
-                        case 0xD800:
-                            bank_index = 1;
-                            break;
-                        case 0x6000:
-                        case 0x2000:
-                        case 0xA000:
-                        case 0xE000:
-                            bank_index = 2;
-                            break;
-                        case 0x6800:
-                        case 0x2800:
-                        case 0xA800:
-                        case 0xE800:
-                            bank_index = 3;
-                            break;
-                        case 0x7000:
-                        case 0x3000:
-                        case 0xB000:
-                        case 0xF000:
-                            bank_index = 4;
-                            break;
-                        case 0x7800:
-                        case 0x3800:
-                        case 0xB800:
-                        case 0xF800:
-                            bank_index = 5;
-                            break;
-                    }
-
-                    if (bank_index < 6)
-                    {
-                        uint8_t data = read_data_bus() & 0xFF; // Read 8-bit data from bus
-                        if (addr & 0x01)
-                        {
-                            // Write to MSB
-                            bank_registers[bank_index] = (bank_registers[bank_index] & 0x00FF) | (data << 8);
-                        }
-                        else
-                        {
-                            // Write to LSB
-                            bank_registers[bank_index] = (bank_registers[bank_index] & 0xFF00) | data;
-                        }
-
-                        // Ensure reserved MSB bits are zero
-                        bank_registers[bank_index] &= 0x0FFF;
-                    }
-
-                    while (!(gpio_get(PIN_WR))) // Wait for write cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
-                }
-            }
-        }
+        printf("SCC: I2S setup failed, no sound\n");
+        usbload_watch();
     }
-}
+    audio_i2s_set_enabled(true);
 
-// loadrom_neo16 - Load an NEO16 ROM into the MSX directly from the pico flash
-// The NEO16 ROM is divided into 16KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Size of a segment: 16 KB
-// Segment switching addresses:
-// Bank 0: 0000h~3FFFh, Bank 1: 4000h~7FFFh, Bank 2: 8000h~BFFFh
-// Switching address:
-// 5000h (mirror at 1000h, 9000h and D000h),
-// 6000h (mirror at 2000h, A000h and E000h),
-// 7000h (mirror at 3000h, B000h and F000h)
-void __no_inline_not_in_flash_func(loadrom_neo16)(uint32_t offset)
-{
-    // 16-bit bank registers initialized to zero (12-bit segment, 4 MSB reserved)
-    uint16_t bank_registers[3] = {0};
-
-    // Configure GPIO pins for input mode
-    gpio_set_dir_in_masked(0xFF << 16);
+    uint32_t budget = (uint32_t)(SCC_BUFFER_SAMPLES * 1000000ull / SCC_SAMPLE_RATE);
+    uint32_t worst = 0;
     while (true)
     {
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
-
-        if (sltsl)
+        struct audio_buffer *buffer = take_audio_buffer(pool, true);
+        uint32_t start = time_us_32();
+        scc_render(&scc, (int16_t *)buffer->buffer->bytes, buffer->max_sample_count);
+        uint32_t elapsed = time_us_32() - start;
+        buffer->sample_count = buffer->max_sample_count;
+        give_audio_buffer(pool, buffer);
+
+        if (elapsed > worst)
         {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read address bus
-            if (addr <= 0xBFFF)
-            {
-                if (rd)
-                {
-                    // Handle read access
-                    gpio_set_dir_out_masked(0xFF << 16); // Data bus output mode
-                    uint8_t bank_index = addr >> 14;     // Determine bank index (0-2)
-
-                    if (bank_index < 3)
-                    {
-                        uint32_t segment = bank_registers[bank_index] & 0x0FFF; // 12-bit segment number
-                        uint32_t rom_offset = offset + (segment << 14) + (addr & 0x3FFF); // Calculate ROM offset
-                        gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Place data on data bus
-                    }
-                    else
-                    {
-                        gpio_put_masked(0xFF0000, 0xFF << 16); // Invalid page handling
-                    }
-
-                    while (!(gpio_get(PIN_RD))) // Wait for read cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
-
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode
-                }
-                else if (wr)
-                {
-                    // Handle write access
-                    uint16_t base_addr = addr & 0xF800; // Mask to identify base address
-                    uint8_t bank_index = 3;             // Initialize to invalid bank
-
-                    // Determine bank index based on base address
-                    switch (base_addr)
-                    {
-                        case 0x5000:
-                        case 0x1000:
-                        case 0x9000:
-                        case 0xD000:
-                            bank_index = 0;
-                            break;
-                        case 0x6000:
-                        case 0x2000:
-                        case 0xA000:
-                        case 0xE000:
-                            bank_index = 1;
-                            break;
-                        case 0x7000:
-                        case 0x3000:
-                        case 0xB000:
-                        case 0xF000:
-                            bank_index = 2;
-                            break;
-                    }
-
-                    if (bank_index < 3)
-                    {
-                        uint8_t data = read_data_bus() & 0xFF; // Read 8-bit data from bus
-                        if (addr & 0x01)
-                        {
-                            // Write to MSB
-                            bank_registers[bank_index] = (bank_registers[bank_index] & 0x00FF) | (data << 8);
-                        }
-                        else
-                        {
-                            // Write to LSB
-                            bank_registers[bank_index] = (bank_registers[bank_index] & 0xFF00) | data;
-                        }
-
-                        // Ensure reserved MSB bits are zero
-                        bank_registers[bank_index] &= 0x0FFF;
-                    }
-
-                    while (!(gpio_get(PIN_WR))) // Wait for write cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
-                }
-            }
+            worst = elapsed;
+            printf("SCC: %lu us to render %lu samples, budget %lu us\n", (unsigned long)worst,
+                   (unsigned long)buffer->max_sample_count, (unsigned long)budget);
         }
+        usbload_poll();
     }
 }
 
@@ -1226,6 +492,7 @@ int __no_inline_not_in_flash_func(main)()
     // Initialize stdio
     stdio_init_all();
     setup_gpio();
+    setup_pio_output_data(); // The output state machine drives the data bus for every read handler
 
     char rom_name[ROM_NAME_MAX];
     memcpy(rom_name, rom, ROM_NAME_MAX);
@@ -1234,63 +501,48 @@ int __no_inline_not_in_flash_func(main)()
     uint32_t rom_size;
     memcpy(&rom_size, rom + ROM_NAME_MAX + 1, sizeof(uint32_t));
 
+    if (usbload_requested(rom_type)) // No ROM in flash, or the host asked for an upload: take it from USB
+    {
+        rom_size = usbload_receive(rom_sram, MAX_MEM_SIZE, &rom_type);
+        strcpy(rom_name, "USB upload");
+        sram_loaded = true;
+    }
+    if (rom_type == MAPPER_KONAMISCC)
+    {
+        scc_init(&scc, SCC_SAMPLE_RATE);
+        multicore_launch_core1(scc_audio); // SCC sound, and the upload watch between two buffers
+    }
+    else
+        multicore_launch_core1(usbload_watch); // A new upload from the host reboots into upload mode
+
     // Print the ROM name and type
     printf("ROM name: %s\n", rom_name);
     printf("ROM type: %d\n", rom_type);
     printf("ROM size: %d\n", rom_size);
 
-    // Load the ROM based on the detected type
-    // 1 - 16KB ROM
-    // 2 - 32KB ROM
-    // 3 - Konami SCC ROM
-    // 4 - 48KB Linear0 ROM
-    // 5 - ASCII8 ROM
-    // 6 - ASCII16 ROM
-    // 7 - Konami (without SCC) ROM
-    // 8 - NEO8 ROM
+    // Load the ROM based on the detected type (codes in mapper_codes.h)
+    // Konami SCC ROMs get the SCC sound on the I2S DAC, MegaRAM serves writable SRAM pages
+    // Mapped ROMs are copied to SRAM when they fit, larger ones are served from the flash
+    bool sram = sram_loaded || (rom_size <= MAX_MEM_SIZE);
+    if (!sram)
+        printf("ROM mode: flash, %lu bytes do not fit in %lu bytes of SRAM\n", (unsigned long)rom_size, (unsigned long)MAX_MEM_SIZE);
+
     switch (rom_type) 
     {
-        case 1:
-        case 2:
-            loadrom_plain32(0x1d); // flash version
-            //loadrom_plain32_dma(0x1d); // dma version
-            //loadrom_plain32_pio(0x1d); // pio version
-            //loadrom_plain32_sram(0x1d, rom_size); //sram version
-            //loadrom_plain32_sram(pio, sm_addr, 0x1d, rom_size);
-            //loadrom_plain32(pio, sm_addr, 0x1d);
-            break;
-        case 3:
-            loadrom_konamiscc(0x1d); // flash version
-            //loadrom_konamiscc_pio(0x1d); // pio version
-            //loadrom_konamiscc_sram(0x1d, rom_size);
-            break;
-        case 4:
-            loadrom_linear48(0x1d); // flash version
-            //loadrom_linear48_sram(0x1d, rom_size); //sram version
+        case MAPPER_PLAIN16:
+        case MAPPER_PLAIN32:
+            loadrom_plain_pio(0x1d, rom_size, 0x4000); // pio version, served from the SRAM window
             break;
-        case 5:
-            loadrom_ascii8(0x1d); // flash version
-            //loadrom_ascii8_sram(0x1d, rom_size); //sram version
+        case MAPPER_LINEAR48:
+            loadrom_plain_pio(0x1d, rom_size, 0x0000); // pio version, served from the SRAM window
             break;
-        case 6:
-            loadrom_ascii16(0x1d); //flash version
-            //loadrom_ascii16_sram(0x1d, rom_size); //sram version
-            break;
-        case 7:
-            loadrom_konami(0x1d); //flash version
-            //loadrom_konami_sram(0x1d, rom_size); //sram version
-            break;
-        case 8:
-            loadrom_neo8(0x1d); //flash version
-            break;
-        case 9:
-            loadrom_neo16(0x1d); //flash version
+        case MAPPER_MEGARAM:
+            loadrom_megaram(0x1d, rom_size);
             break;
         default:
-            printf("Unknown ROM type: %d\n", 1);
+            loadrom_mapper(0x1d, rom_size, rom_type, sram); // Banked ROMs, unknown codes are reported
             break;
     }
 
-
     return 0;
 }
@@ -14,57 +14,29 @@
 #ifndef LOADROM_H
 #define LOADROM_H
 
-#define MAX_MEM_SIZE        (131072+29)    // Maximum memory size
+#define MAX_MEM_SIZE        (384*1024)  // Largest ROM preloaded in SRAM, the rest of the 520KB is left to the SDK and stack
 #define ROM_NAME_MAX        20          // Maximum ROM name length
 #define SIZE_CONFIG_RECORD  29          // Size of the configuration record in the ROM
+#define MEGARAM_SIZE        (256*1024)  // MegaRAM mode: 32 writable 8KB pages in SRAM
+#define MEGARAM_PORT        0x8E        // MegaRAM mode: OUT enables writes to the pages, IN back to bank switching
 
-// -----------------------
-// User-defined pin assignments for the Raspberry Pi Pico
-// -----------------------
-// Address lines (A0-A15) as inputs from MSX
-#define PIN_A0     0 
-#define PIN_A1     1
-#define PIN_A2     2
-#define PIN_A3     3
-#define PIN_A4     4
-#define PIN_A5     5
-#define PIN_A6     6
-#define PIN_A7     7
-#define PIN_A8     8
-#define PIN_A9     9
-#define PIN_A10    10
-#define PIN_A11    11
-#define PIN_A12    12
-#define PIN_A13    13
-#define PIN_A14    14
-#define PIN_A15    15
-#define ADDR_PINS   0    // Address bus (A0-A15)
+#include "board.h"   // Pin numbers and bus masks of the board
 
-// Data lines (D0-D7)
-#define PIN_D0     16
-#define PIN_D1     17
-#define PIN_D2     18
-#define PIN_D3     19
-#define PIN_D4     20
-#define PIN_D5     21
-#define PIN_D6     22
-#define PIN_D7     23
-#define DATA_PINS   16   // Data bus (D0-D7)
+// I2S DAC for the SCC sound of the Konami SCC mapper, on the free GPIOs and wired as the audio cartridge DAC
+#define PIN_I2S_DATA    25  // Data (DIN)
+#define PIN_I2S_BCLK    29  // Bit clock, the left-right clock (WS/LRCK) must be the next GPIO
+#define PIN_I2S_WSEL    30  // Left-right clock
 
-// Control signals
-#define PIN_RD     24   // Read strobe from MSX
-#define PIN_WR     26   // Write strobe from MSX
-#define PIN_SLTSL  27   // Slot Select for this cartridge slot
-#define PIN_IORQ   28   // IO Request line from MSX
-#define PIN_WAIT    46  // WAIT line to MSX 
-#define PIN_BUSSDIR 47  // Bus direction line 
+#define SCC_BUFFER_SAMPLES  256     // Samples per I2S buffer, 5.8ms at 44100Hz
+#define SCC_DMA_CHANNEL     11      // Fixed by the I2S driver, clear of the channels the bus handlers claim
 
 // This symbol marks the end of the main program in flash.
 // The ROM data is concatenated immediately after this point.
 extern unsigned char __flash_binary_end;
 
-// Optionally copy the ROM into this SRAM buffer for faster access
-static uint8_t rom_sram[MAX_MEM_SIZE];
+// ROMs up to MAX_MEM_SIZE are copied into this SRAM buffer for faster access
+// 64KB aligned so it can also be used as the address space window of the PIO/DMA read path
+static uint8_t rom_sram[MAX_MEM_SIZE] __attribute__((aligned(0x10000)));
 
 // The ROM is concatenated right after the main program binary.
 // __flash_binary_end points to the end of the program in flash memory.
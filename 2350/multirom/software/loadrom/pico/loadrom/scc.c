@@ -0,0 +1,107 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// scc.c - Konami SCC (051649) sound chip emulation for the MSX PICOVERSE loadrom firmware
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <string.h>
+#include "scc.h"
+
+// scc_init - Reset the SCC, all channels silent
+// Parameters:
+//   s    - State to initialize
+//   rate - Output sample rate in Hz
+void scc_init(scc_t *s, uint32_t rate)
+{
+    memset(s, 0, sizeof(scc_t));
+    s->rate = rate;
+}
+
+// scc_write - Write an SCC register, called from the bus loop
+// Parameters:
+//   s     - SCC state
+//   addr  - Address of the write, 9800h-98FFh
+//   value - Byte written
+void __not_in_flash_func(scc_write)(scc_t *s, uint16_t addr, uint8_t value)
+{
+    uint8_t reg = addr & 0xFF;
+    if (reg < 0x80)
+    {
+        s->wave[reg >> 5][reg & 0x1F] = (int8_t)value;
+    }
+    else if (reg < 0xA0)
+    {
+        reg &= 0x0F;
+        if (reg < 10)
+        {
+            uint8_t ch = reg >> 1;
+            if (reg & 1)
+                s->period[ch] = (s->period[ch] & 0x0FF) | ((value & 0x0F) << 8);
+            else
+                s->period[ch] = (s->period[ch] & 0xF00) | value;
+        }
+        else if (reg < 15)
+            s->volume[reg - 10] = value & 0x0F;
+        else
+            s->enable = value & 0x1F;
+    }
+    else if (reg >= 0xE0)
+    {
+        s->deform = value;
+    }
+}
+
+// scc_read - Read an SCC register, called from the bus loop
+// Parameters:
+//   s    - SCC state
+//   addr - Address of the read, 9800h-98FFh
+// Returns:
+//   Waveform byte, or FFh for the write only registers
+uint8_t __not_in_flash_func(scc_read)(const scc_t *s, uint16_t addr)
+{
+    uint8_t reg = addr & 0xFF;
+    if (reg < 0x80)
+        return (uint8_t)s->wave[reg >> 5][reg & 0x1F];
+    if (reg >= 0xA0 && reg < 0xC0)
+        return (uint8_t)s->wave[3][reg & 0x1F];
+    return 0xFF;
+}
+
+// scc_render - Synthesize samples of the five channels, called from the core 1 audio loop
+// The phase steps are worked out once per call from the periods, so a buffer plays at the tones written before it
+// started; at 44100Hz a 256 sample buffer is 5.8ms, below the 1/60s the MSX music drivers update the SCC at.
+// Parameters:
+//   s       - SCC state
+//   out     - Interleaved stereo output, 2 * samples values
+//   samples - Number of samples to render
+void __not_in_flash_func(scc_render)(scc_t *s, int16_t *out, uint32_t samples)
+{
+    uint32_t step[SCC_CHANNELS];
+    int32_t volume[SCC_CHANNELS];
+    const volatile int8_t *wave[SCC_CHANNELS];
+
+    for (int ch = 0; ch < SCC_CHANNELS; ch++)
+    {
+        uint32_t period = s->period[ch];
+        bool on = (s->enable & (1 << ch)) && period >= SCC_MIN_PERIOD;
+        // Waveform index advance per output sample, in 1/2^27 steps: 2^32 / 32 * SCC_CLOCK / (period + 1) / rate
+        step[ch] = on ? (uint32_t)(((uint64_t)SCC_CLOCK << 27) / ((uint64_t)(period + 1) * s->rate)) : 0;
+        volume[ch] = on ? s->volume[ch] * SCC_GAIN : 0;
+        wave[ch] = s->wave[ch < 4 ? ch : 3];
+    }
+
+    for (uint32_t i = 0; i < samples; i++)
+    {
+        int32_t mix = 0;
+        for (int ch = 0; ch < SCC_CHANNELS; ch++)
+        {
+            s->phase[ch] += step[ch];
+            mix += wave[ch][s->phase[ch] >> 27] * volume[ch];
+        }
+        out[2 * i] = (int16_t)mix;
+        out[2 * i + 1] = (int16_t)mix;
+    }
+}
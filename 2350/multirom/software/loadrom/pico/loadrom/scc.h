@@ -0,0 +1,88 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// scc.h - Konami SCC (051649) sound chip emulation for the MSX PICOVERSE loadrom firmware
+//
+// With a Konami SCC ROM (mapper 3) the bus loop captures the writes to the SCC registers and serves their reads,
+// while core 1 synthesizes the five wavetable channels and sends them to an I2S DAC (see scc_audio in loadrom.c).
+// The registers are visible at 9800h-98FFh when the bank register at 9000h holds a value with the low 6 bits set
+// (3Fh), as on the real cartridge:
+//
+//   9800h-987Fh  Waveforms of channels 1-4, 32 signed samples each. Channel 5 plays the waveform of channel 4
+//   9880h-9889h  Periods of channels 1-5, low 8 bits then high 4 bits. Tone = 3579545 / (32 * (period + 1)) Hz
+//   988Ah-988Eh  Volumes of channels 1-5, 4 bits
+//   988Fh        Channel enable bits 0-4
+//   9890h-989Fh  Mirror of 9880h-988Fh
+//   98A0h-98BFh  Reads the waveform of channel 4 (5), writes are ignored
+//   98C0h-98DFh  Nothing
+//   98E0h-98FFh  Deformation register, write only
+//
+// Mixing is done in fixed point: each channel is a 32 bit phase accumulator whose top 5 bits index its waveform, the
+// sample is multiplied by the volume and the five products are added and scaled to 16 bits. CPU budget per sample:
+// about 20 cycles per channel, so roughly 100 cycles for the five channels and the stereo store, against the
+// 210MHz / 44100Hz = 4761 cycles core 1 has for each output sample (about 2%). The firmware prints the worst render
+// time of a buffer over USB, against the time the buffer takes to play. The file has no Pico dependency, so the host
+// tool sccwav renders register dumps to WAV with the same code.
+//
+// Only this loadrom firmware plays the SCC. The multirom firmwares serve Konami SCC ROMs through the shared mapper
+// engine without sound: they do not decode the SCC registers, and their core 1 runs the bus or Nextor handlers.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef SCC_H
+#define SCC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if PICO_ON_DEVICE
+#include "pico.h"
+#else
+#define __not_in_flash_func(f) f   // Host build (tool/src/sccwav.c)
+#endif
+
+#define SCC_CLOCK           3579545     // MSX clock, the SCC divides it by 32 * (period + 1)
+#define SCC_CHANNELS        5
+#define SCC_WAVE_SIZE       32
+#define SCC_MIN_PERIOD      9           // Shorter periods are ultrasonic, the channel is muted instead of aliasing
+#define SCC_GAIN            3           // 5 channels * 128 * 15 * 3 = 28800, below the 16 bit limit
+#define SCC_SAMPLE_RATE     44100       // Output rate, as the loadmp3 audio path
+
+// scc_enabled - True when the value written to the bank 3 register (9000h) maps the SCC registers
+static inline bool scc_enabled(uint8_t bank)
+{
+    return (bank & 0x3F) == 0x3F;
+}
+
+// scc_register - True when addr is in the SCC register area, to be checked with scc_enabled
+static inline bool scc_register(uint16_t addr)
+{
+    return (addr & 0xFF00) == 0x9800;
+}
+
+// SCC state
+// wave   - Waveforms of channels 1-4, channel 5 shares the fourth one
+// period - 12 bit periods, written by the bus core a byte at a time
+// volume - 4 bit volumes
+// enable - Channel enable bits
+// deform - Deformation register, stored but not emulated
+// phase  - Phase accumulators, the top 5 bits index the waveform (core 1 only)
+// rate   - Output sample rate
+typedef struct {
+    volatile int8_t wave[SCC_CHANNELS - 1][SCC_WAVE_SIZE];
+    volatile uint16_t period[SCC_CHANNELS];
+    volatile uint8_t volume[SCC_CHANNELS];
+    volatile uint8_t enable;
+    volatile uint8_t deform;
+    uint32_t phase[SCC_CHANNELS];
+    uint32_t rate;
+} scc_t;
+
+void scc_init(scc_t *s, uint32_t rate);
+void scc_write(scc_t *s, uint16_t addr, uint8_t value);
+uint8_t scc_read(const scc_t *s, uint16_t addr);
+void scc_render(scc_t *s, int16_t *out, uint32_t samples);
+
+#endif
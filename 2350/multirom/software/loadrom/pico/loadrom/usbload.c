@@ -0,0 +1,179 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// usbload.c - Upload a ROM over USB into SRAM for the MSX PICOVERSE loadrom firmware
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include <string.h>
+#if PICO_ON_DEVICE
+#include "pico/stdlib.h"
+#include "hardware/watchdog.h"
+#else
+// Host build (tool/src/usbload.c --loopback): the serial port is one end of a socket pair, the tool provides these
+#include <stdint.h>
+#define PICO_ERROR_TIMEOUT      (-1)
+int usbload_host_getchar(uint32_t timeout_us);
+int usbload_host_printf(const char *format, ...);
+uint32_t usbload_host_time_us();
+#define getchar_timeout_us(t)   usbload_host_getchar(t)
+#define getchar()               usbload_host_getchar(UINT32_MAX)
+#define printf                  usbload_host_printf
+#define time_us_32              usbload_host_time_us
+#endif
+#include "usbload.h"
+
+// crc32 - Update a CRC-32 (IEEE 802.3, the one of zip files) with one buffer
+static uint32_t crc32(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+    crc = ~crc;
+    while (size--)
+    {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+// wait_magic - Read the serial port until the upload magic is seen
+// Parameters:
+//   timeout_us - Longest wait for each byte, 0 to wait forever
+// Returns:
+//   true when the magic was received, false on a timeout
+static bool wait_magic(uint32_t timeout_us)
+{
+    int matched = 0;
+    while (matched < (int)sizeof(USBLOAD_MAGIC) - 1)
+    {
+        int c = timeout_us ? getchar_timeout_us(timeout_us) : getchar();
+        if (c == PICO_ERROR_TIMEOUT)
+            return false;
+        matched = (c == USBLOAD_MAGIC[matched]) ? matched + 1 : (c == USBLOAD_MAGIC[0]);
+    }
+    return true;
+}
+
+// read_bytes - Read a number of bytes from the serial port
+// Returns:
+//   true when all bytes were read, false if the host stopped sending for USBLOAD_TIMEOUT_US
+static bool read_bytes(uint8_t *dest, uint32_t size)
+{
+    while (size--)
+    {
+        int c = getchar_timeout_us(USBLOAD_TIMEOUT_US);
+        if (c == PICO_ERROR_TIMEOUT)
+            return false;
+        *dest++ = (uint8_t)c;
+    }
+    return true;
+}
+
+#if PICO_ON_DEVICE
+// usbload_requested - Tell whether the firmware has to wait for an upload instead of running a ROM from flash
+// Parameters:
+//   rom_type - Mapper code of the configuration record appended in flash
+// Returns:
+//   true if no ROM is appended to the firmware or the host asked for an upload before a reboot
+bool usbload_requested(uint8_t rom_type)
+{
+    if (watchdog_hw->scratch[USBLOAD_SCRATCH] == USBLOAD_REBOOT_FLAG)
+    {
+        watchdog_hw->scratch[USBLOAD_SCRATCH] = 0;
+        return true;
+    }
+    return (rom_type == 0x00) || (rom_type == 0xFF); // Erased flash after the firmware
+}
+#endif
+
+// usbload_receive - Wait for an upload and store the ROM image in SRAM
+// Bad uploads are answered with an error and the next one is awaited.
+// Parameters:
+//   dest     - SRAM buffer receiving the image
+//   max_size - Size of the buffer
+//   mapper   - Receives the mapper code sent by the host
+// Returns:
+//   Size of the ROM image
+uint32_t usbload_receive(uint8_t *dest, uint32_t max_size, uint8_t *mapper)
+{
+    printf("USB upload: waiting for a ROM\n");
+    while (true)
+    {
+        uint8_t header[USBLOAD_HEADER_SIZE - 4];
+        uint32_t size, crc;
+
+        wait_magic(0);
+        if (!read_bytes(header, sizeof(header)))
+        {
+            printf("ERROR timeout\n");
+            continue;
+        }
+        *mapper = header[0];
+        memcpy(&size, header + 1, sizeof(uint32_t));
+        memcpy(&crc, header + 5, sizeof(uint32_t));
+
+        if (!usbload_mapper_ok(*mapper))
+        {
+            printf("ERROR mapper %d\n", *mapper);
+            continue;
+        }
+        if (size == 0 || size > max_size)
+        {
+            printf("ERROR size %lu, at most %lu bytes\n", (unsigned long)size, (unsigned long)max_size);
+            continue;
+        }
+
+        printf("READY\n");
+        uint32_t start = time_us_32();
+        if (!read_bytes(dest, size))
+        {
+            printf("ERROR timeout\n");
+            continue;
+        }
+        uint32_t elapsed = time_us_32() - start;
+
+        if (crc32(0, dest, size) != crc)
+        {
+            printf("ERROR crc\n");
+            continue;
+        }
+        printf("OK %lu\n", (unsigned long)elapsed);
+        return size;
+    }
+}
+
+#if PICO_ON_DEVICE
+// reboot_upload - Reboot into upload mode
+static void reboot_upload()
+{
+    watchdog_hw->scratch[USBLOAD_SCRATCH] = USBLOAD_REBOOT_FLAG;
+    printf("REBOOT\n");
+    stdio_flush();
+    watchdog_reboot(0, 0, 10);
+    while (true)
+        tight_loop_contents();
+}
+
+// usbload_watch - Reboot into upload mode when the host starts an upload while a ROM runs (core 1)
+void usbload_watch()
+{
+    wait_magic(0);
+    reboot_upload();
+}
+
+// usbload_poll - Non blocking usbload_watch, for a core 1 loop that has other work to do
+void usbload_poll()
+{
+    static int matched = 0;
+    int c;
+    while ((c = getchar_timeout_us(0)) != PICO_ERROR_TIMEOUT)
+    {
+        matched = (c == USBLOAD_MAGIC[matched]) ? matched + 1 : (c == USBLOAD_MAGIC[0]);
+        if (matched == (int)sizeof(USBLOAD_MAGIC) - 1)
+            reboot_upload();
+    }
+}
+#endif
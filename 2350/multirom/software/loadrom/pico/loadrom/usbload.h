@@ -0,0 +1,48 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// usbload.h - Upload a ROM over USB into SRAM for the MSX PICOVERSE loadrom firmware
+//
+// Instead of building and flashing a UF2 for every test, a ROM image can be streamed over the USB serial port
+// straight into the SRAM buffer and started from there. The firmware waits for an upload when no ROM is appended
+// to it in flash, or after a reboot asked by the host. While a ROM runs, core 1 watches the serial port and a new
+// upload request reboots the pico into upload mode, so the host only has to open the port again.
+//
+// Protocol (all values little endian):
+//   host   -> device: "PVUP", mapper (1 byte), size (4 bytes), CRC-32 of the image (4 bytes)
+//   device -> host  : "READY\n" when the header is accepted, "REBOOT\n" when a ROM was running
+//   host   -> device: size bytes of ROM image
+//   device -> host  : "OK <us>\n" with the transfer time, or "ERROR <reason>\n"
+//
+// With MAPPER_MEGARAM the image is the initial content of the writable pages, so a development build is sent
+// straight into the RAM the MSX runs it from.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef USBLOAD_H
+#define USBLOAD_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mapper_codes.h"
+
+#define USBLOAD_MAGIC       "PVUP"          // Start of an upload request
+#define USBLOAD_HEADER_SIZE 13              // Magic, mapper, size and CRC-32
+#define USBLOAD_TIMEOUT_US  2000000         // Longest gap between two bytes of an upload
+#define USBLOAD_SCRATCH     0               // Watchdog scratch register asking for upload mode after a reboot
+#define USBLOAD_REBOOT_FLAG 0x50565550      // "PVUP", value of the scratch register
+
+bool usbload_requested(uint8_t rom_type);
+uint32_t usbload_receive(uint8_t *dest, uint32_t max_size, uint8_t *mapper);
+void usbload_watch();
+void usbload_poll();
+
+// usbload_mapper_ok - Tell whether the loadrom firmware serves a mapper code (see mapper_codes.h)
+static inline bool usbload_mapper_ok(uint8_t mapper)
+{
+    return (mapper >= MAPPER_PLAIN16 && mapper <= MAPPER_NEO16) || (mapper == MAPPER_MEGARAM);
+}
+
+#endif
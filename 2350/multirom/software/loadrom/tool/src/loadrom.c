@@ -22,6 +22,7 @@
 #include <stdlib.h>
 #include <dirent.h>
 #include "uf2format.h"
+#include "mapper_codes.h"
 
 #define CONFIG_FILE     "loadrom.cfg"          // this is the 29 bytes file with the information about the ROM to load
 #define COMBINED_FILE   "loadrom.cmb"          // this is the final binary file with the firmware, configuration and ROM
@@ -40,18 +41,7 @@ uint8_t detect_rom_type(const char *filename, uint32_t size);
 void write_padding(FILE *file, size_t current_size, size_t target_size, uint8_t padding_byte);
 void create_uf2_file(const char *combined_filename, const char *uf2_filename);
 
-const char *rom_types[] = {
-    "Unknown ROM type", // Default for invalid indices
-    "Plain16",          // Index 1
-    "Plain32",          // Index 2
-    "KonamiS",          // Index 3
-    "Linear0",          // Index 4
-    "ASCII8",           // Index 5
-    "ASCII16",          // Index 6
-    "Konami",           // Index 7
-    "NEO8",             // Index 8
-    "NEO16"             // Index 9
-};
+const char *rom_types[] = MAPPER_NAMES;
 
 // Function to get the size of a file
 // Parameters:
@@ -307,6 +297,7 @@ int main(int argc, char *argv[])
         printf("  7: Konami\n");
         printf("  8: NEO8\n");
         printf("  9: NEO16\n");
+        printf(" 14: MegaRAM (writable 256KB in SRAM, the ROM file is its initial content)\n");
         return 1;
     }
 
@@ -360,9 +351,9 @@ int main(int argc, char *argv[])
         // Check if a forced mapper value was provided as a second parameter
         if (argc >= 3) {
             int forced_mapper = atoi(argv[2]);
-            // Validate forced value (adjust valid range as needed)
-            if (forced_mapper < 1 || forced_mapper > 9) {
-                printf("Forced mapper must be between 1 and 9.\n");
+            // Validate forced value: the mappers served by the loadrom firmware
+            if ((forced_mapper < MAPPER_PLAIN16 || forced_mapper > MAPPER_NEO16) && forced_mapper != MAPPER_MEGARAM) {
+                printf("Forced mapper must be between 1 and 9, or 14.\n");
                 fclose(rom_file);
                 fclose(output_file);
                 return 1;
@@ -0,0 +1,143 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// sccwav.c - Console application to render Konami SCC register dumps to a WAV file
+//
+// The SCC synthesis of the loadrom firmware (pico/loadrom/scc.c) has no Pico dependency and is built here, so the
+// sound of a register sequence can be listened to, or compared with the recording of a real cartridge or an
+// emulator, without flashing a pico. The dump is a list of register writes, as logged by an emulator debugger
+// watching 9800h-98FFh, separated by the time to render between them.
+//
+// Dump lines (numbers in hexadecimal, '#' starts a comment):
+//   w <addr> <value>        write an SCC register (9800-98FF, or only the low byte)
+//   t <ms>                  render ms milliseconds (decimal) with the registers as they are
+//
+// Usage: sccwav <dump> <output.wav>
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include "scc.h"
+
+#define MAX_LINE        256
+#define CHUNK_SAMPLES   256         // Rendered at a time, as the SCC_BUFFER_SAMPLES buffers of the firmware
+
+static scc_t scc;
+
+// put_le - Write a little endian value of size bytes
+static void put_le(FILE *file, uint32_t value, int size)
+{
+    for (int i = 0; i < size; i++)
+        fputc((value >> (8 * i)) & 0xFF, file);
+}
+
+// write_wav_header - Write the header of a 16 bit stereo PCM WAV file holding samples samples
+static void write_wav_header(FILE *file, uint32_t samples)
+{
+    uint32_t data_size = samples * 4;
+    fwrite("RIFF", 1, 4, file);
+    put_le(file, 36 + data_size, 4);
+    fwrite("WAVEfmt ", 1, 8, file);
+    put_le(file, 16, 4);                    // Format chunk size
+    put_le(file, 1, 2);                     // PCM
+    put_le(file, 2, 2);                     // Channels
+    put_le(file, SCC_SAMPLE_RATE, 4);
+    put_le(file, SCC_SAMPLE_RATE * 4, 4);   // Bytes per second
+    put_le(file, 4, 2);                     // Block align
+    put_le(file, 16, 2);                    // Bits per sample
+    fwrite("data", 1, 4, file);
+    put_le(file, data_size, 4);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc != 3)
+    {
+        printf("Usage: sccwav <dump> <output.wav>\n");
+        return 1;
+    }
+
+    FILE *dump = fopen(argv[1], "r");
+    if (!dump)
+    {
+        printf("Failed to open %s\n", argv[1]);
+        return 1;
+    }
+    FILE *wav = fopen(argv[2], "wb");
+    if (!wav)
+    {
+        printf("Failed to create %s\n", argv[2]);
+        fclose(dump);
+        return 1;
+    }
+
+    scc_init(&scc, SCC_SAMPLE_RATE);
+    write_wav_header(wav, 0); // Sizes filled in at the end
+
+    char line[MAX_LINE];
+    int line_number = 0;
+    int errors = 0;
+    uint32_t writes = 0;
+    uint32_t samples = 0;
+    uint64_t fraction = 0; // Sample remainder of the t lines, in 1/1000 samples
+    clock_t render_time = 0;
+    int16_t buffer[2 * CHUNK_SAMPLES];
+    while (fgets(line, sizeof(line), dump))
+    {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+
+        char op;
+        unsigned a = 0, b = 0;
+        int fields = sscanf(line, " %c %x %x", &op, &a, &b);
+        if (fields <= 0)
+            continue;
+
+        if (op == 'w' && fields == 3)
+        {
+            scc_write(&scc, (uint16_t)(0x9800 | (a & 0xFF)), (uint8_t)b);
+            writes++;
+        }
+        else if (op == 't' && sscanf(line, " t %u", &a) == 1)
+        {
+            fraction += (uint64_t)a * SCC_SAMPLE_RATE;
+            uint32_t count = (uint32_t)(fraction / 1000);
+            fraction %= 1000;
+            while (count)
+            {
+                uint32_t n = (count < CHUNK_SAMPLES) ? count : CHUNK_SAMPLES;
+                clock_t start = clock();
+                scc_render(&scc, buffer, n);
+                render_time += clock() - start;
+                fwrite(buffer, sizeof(int16_t), 2 * n, wav); // Little endian hosts
+                samples += n;
+                count -= n;
+            }
+        }
+        else
+        {
+            printf("%4d: syntax error\n", line_number);
+            errors++;
+        }
+    }
+    fclose(dump);
+
+    fseek(wav, 0, SEEK_SET);
+    write_wav_header(wav, samples);
+    fclose(wav);
+
+    double seconds = (double)render_time / CLOCKS_PER_SEC;
+    printf("%u register writes, %u samples (%.2f s) written to %s\n", writes, samples,
+           (double)samples / SCC_SAMPLE_RATE, argv[2]);
+    if (samples)
+        printf("Render time on this host: %.1f ns per sample\n", seconds * 1e9 / samples);
+    return errors ? 1 : 0;
+}
@@ -0,0 +1,511 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// usbload.c - Console application to upload a ROM over USB to the MSX PICOVERSE 2350 loadROM firmware
+//
+// The ROM image is streamed over the USB serial port of the pico straight into its SRAM, so a ROM can be tested on
+// the MSX without building and flashing a UF2 file. Flash loadrom.uf2 once without a ROM (or any loadrom UF2), then
+// run this tool for every new build of the ROM and reset the MSX. If a ROM is running, the firmware reboots into
+// upload mode first and the tool opens the port again.
+//
+// The upload protocol is described in usbload.h of the firmware:
+//   host   -> device: "PVUP", mapper (1 byte), size (4 bytes), CRC-32 of the image (4 bytes), all little endian
+//   device -> host  : "READY" when the header is accepted, "REBOOT" when a ROM was running
+//   host   -> device: size bytes of ROM image
+//   device -> host  : "OK <us>" with the transfer time, or "ERROR <reason>"
+//
+// With --loopback the upload code of the firmware (pico/loadrom/usbload.c, built in with a getchar_timeout_us and
+// printf shim) runs in a child process connected through a socket pair, which checks both sides of the protocol on
+// Linux without a pico.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#define strcasecmp _stricmp
+#else
+#include <strings.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <termios.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/wait.h>
+#endif
+#include "usbload.h"
+
+#define MAX_ROM_SIZE        (384*1024)      // Size of the SRAM buffer of the firmware
+#define CHUNK_SIZE          4096            // Bytes written to the port at once
+#define REPLY_TIMEOUT_MS    5000            // Longest wait for a reply line
+#define REOPEN_TIMEOUT_MS   10000           // Longest wait for the port to come back after a reboot
+#define MAX_LINE            128             // Longest reply line
+
+const char *rom_types[] = MAPPER_NAMES;
+
+#ifdef _WIN32
+typedef HANDLE port_t;
+#define PORT_NONE INVALID_HANDLE_VALUE
+#else
+typedef int port_t;
+#define PORT_NONE (-1)
+#endif
+
+// now_ms - Monotonic time in milliseconds
+static uint32_t now_ms()
+{
+#ifdef _WIN32
+    return GetTickCount();
+#else
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint32_t)(ts.tv_sec * 1000 + ts.tv_nsec / 1000000);
+#endif
+}
+
+// sleep_ms - Wait a number of milliseconds
+static void sleep_ms(uint32_t ms)
+{
+#ifdef _WIN32
+    Sleep(ms);
+#else
+    usleep(ms * 1000);
+#endif
+}
+
+// crc32 - Update a CRC-32 (IEEE 802.3, the one of zip files) with one buffer
+uint32_t crc32(uint32_t crc, const uint8_t *data, uint32_t size)
+{
+    crc = ~crc;
+    while (size--)
+    {
+        crc ^= *data++;
+        for (int i = 0; i < 8; i++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+// port_open - Open the USB serial port of the pico in raw mode
+// Parameters:
+// name - Port name, /dev/ttyACM0 on Linux or COM3 on Windows
+// Returns:
+// The open port or PORT_NONE
+port_t port_open(const char *name)
+{
+#ifdef _WIN32
+    char path[64];
+    snprintf(path, sizeof(path), "\\\\.\\%s", name);
+    HANDLE h = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, 0, NULL, OPEN_EXISTING, 0, NULL);
+    if (h == INVALID_HANDLE_VALUE)
+        return PORT_NONE;
+
+    DCB dcb = { .DCBlength = sizeof(DCB) };
+    GetCommState(h, &dcb);
+    dcb.BaudRate = CBR_115200; // Ignored by USB CDC
+    dcb.ByteSize = 8;
+    dcb.Parity = NOPARITY;
+    dcb.StopBits = ONESTOPBIT;
+    dcb.fBinary = TRUE;
+    dcb.fDtrControl = DTR_CONTROL_ENABLE; // The pico only sends when DTR is set
+    SetCommState(h, &dcb);
+
+    COMMTIMEOUTS timeouts = { .ReadIntervalTimeout = MAXDWORD, .ReadTotalTimeoutMultiplier = MAXDWORD,
+                              .ReadTotalTimeoutConstant = 100 };
+    SetCommTimeouts(h, &timeouts);
+    return h;
+#else
+    int fd = open(name, O_RDWR | O_NOCTTY);
+    if (fd < 0)
+        return PORT_NONE;
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) == 0)
+    {
+        cfmakeraw(&tio);
+        tcsetattr(fd, TCSANOW, &tio);
+    }
+    return fd;
+#endif
+}
+
+// port_close - Close the serial port
+void port_close(port_t port)
+{
+#ifdef _WIN32
+    CloseHandle(port);
+#else
+    close(port);
+#endif
+}
+
+// port_write - Write a buffer to the serial port
+// Returns:
+// 0 on success, -1 if the port went away (the pico rebooted)
+int port_write(port_t port, const uint8_t *data, uint32_t size)
+{
+    while (size)
+    {
+#ifdef _WIN32
+        DWORD n = 0;
+        if (!WriteFile(port, data, size > CHUNK_SIZE ? CHUNK_SIZE : size, &n, NULL) || n == 0)
+            return -1;
+#else
+        ssize_t n = write(port, data, size > CHUNK_SIZE ? CHUNK_SIZE : size);
+        if (n <= 0)
+            return -1;
+#endif
+        data += n;
+        size -= n;
+    }
+    return 0;
+}
+
+// port_read_byte - Read one byte from the serial port
+// Returns:
+// The byte, -1 on a timeout or -2 if the port went away
+int port_read_byte(port_t port, uint32_t timeout_ms)
+{
+    uint8_t c;
+#ifdef _WIN32
+    uint32_t start = now_ms();
+    do
+    {
+        DWORD n = 0;
+        if (!ReadFile(port, &c, 1, &n, NULL))
+            return -2;
+        if (n == 1)
+            return c;
+    } while ((now_ms() - start) < timeout_ms);
+    return -1;
+#else
+    struct pollfd pfd = { .fd = port, .events = POLLIN };
+    int r = poll(&pfd, 1, (int)timeout_ms);
+    if (r == 0)
+        return -1;
+    if (r < 0 || read(port, &c, 1) != 1)
+        return -2;
+    return c;
+#endif
+}
+
+// port_read_line - Read one reply line, without the line end
+// Returns:
+// 0 on success, -1 on a timeout or -2 if the port went away
+int port_read_line(port_t port, char *line, uint32_t timeout_ms)
+{
+    int len = 0;
+    uint32_t start = now_ms();
+    while ((now_ms() - start) < timeout_ms)
+    {
+        int c = port_read_byte(port, timeout_ms);
+        if (c < 0)
+            return c;
+        if (c == '\r')
+            continue;
+        if (c == '\n')
+        {
+            if (len == 0)
+                continue;
+            line[len] = 0;
+            return 0;
+        }
+        if (len < MAX_LINE - 1)
+            line[len++] = (char)c;
+    }
+    return -1;
+}
+
+// port_reopen - Open the port again once the pico is back from a reboot
+port_t port_reopen(const char *name)
+{
+    uint32_t start = now_ms();
+    sleep_ms(500); // Let the old device disappear first
+    while ((now_ms() - start) < REOPEN_TIMEOUT_MS)
+    {
+        port_t port = port_open(name);
+        if (port != PORT_NONE)
+            return port;
+        sleep_ms(100);
+    }
+    return PORT_NONE;
+}
+
+// upload - Run the host side of the protocol on an open port
+// Parameters:
+// port   - Open port, replaced by the new one if the pico rebooted
+// name   - Port name, to open it again after a reboot (NULL in loopback mode)
+// data   - ROM image
+// size   - Size of the ROM image in bytes
+// mapper - Mapper code
+// Returns:
+// 0 on success, 1 on failure
+int upload(port_t *portp, const char *name, const uint8_t *data, uint32_t size, uint8_t mapper)
+{
+    port_t port = *portp;
+    uint8_t header[USBLOAD_HEADER_SIZE];
+    uint32_t crc = crc32(0, data, size);
+    char line[MAX_LINE];
+
+    memcpy(header, USBLOAD_MAGIC, 4);
+    header[4] = mapper;
+    for (int i = 0; i < 4; i++)
+    {
+        header[5 + i] = (size >> (8 * i)) & 0xFF;
+        header[9 + i] = (crc >> (8 * i)) & 0xFF;
+    }
+
+    for (int attempt = 0; attempt < 2; attempt++)
+    {
+        if (port_write(port, header, sizeof(header)) != 0)
+        {
+            printf("Failed to write to the port\n");
+            return 1;
+        }
+
+        int r;
+        while ((r = port_read_line(port, line, REPLY_TIMEOUT_MS)) == 0)
+        {
+            if (!strcmp(line, "READY") || !strcmp(line, "REBOOT") || !strncmp(line, "ERROR", 5))
+                break;
+            printf("  pico: %s\n", line); // Other firmware messages
+        }
+
+        if (r == 0 && !strcmp(line, "READY"))
+        {
+            uint32_t start = now_ms();
+            if (port_write(port, data, size) != 0 || port_read_line(port, line, REPLY_TIMEOUT_MS) != 0)
+            {
+                printf("No answer after the ROM image\n");
+                return 1;
+            }
+            if (strncmp(line, "OK", 2))
+            {
+                printf("Upload failed: %s\n", line);
+                return 1;
+            }
+            uint32_t elapsed = now_ms() - start;
+            unsigned long device_us = strtoul(line + 2, NULL, 10);
+            printf("Uploaded %u bytes in %u ms (%lu us on the pico), CRC-32 %08X\n", size, elapsed, device_us, crc);
+            return 0;
+        }
+        if (r == 0 && !strncmp(line, "ERROR", 5))
+        {
+            printf("Upload refused: %s\n", line);
+            return 1;
+        }
+        if (!name || attempt)
+            break;
+
+        // A ROM was running: the pico reboots into upload mode and comes back as a new device
+        printf("Waiting for the pico to reboot into upload mode...\n");
+        port_close(port);
+        port = *portp = port_reopen(name);
+        if (port == PORT_NONE)
+        {
+            printf("Port %s did not come back\n", name);
+            return 1;
+        }
+    }
+    printf("No answer from the pico\n");
+    return 1;
+}
+
+// Serial port of the firmware upload code when it runs in the loopback child
+static port_t device_port = PORT_NONE;
+
+// usbload_host_getchar - getchar_timeout_us of the firmware upload code, reading device_port
+// The child exits when the host end of the socket pair is closed.
+// Parameters:
+// timeout_us - Longest wait, UINT32_MAX to wait forever (getchar)
+// Returns:
+// The byte or -1 (PICO_ERROR_TIMEOUT) on a timeout
+int usbload_host_getchar(uint32_t timeout_us)
+{
+    uint32_t timeout_ms = (timeout_us == UINT32_MAX) ? REPLY_TIMEOUT_MS : (timeout_us + 999) / 1000;
+    while (1)
+    {
+        int c = port_read_byte(device_port, timeout_ms);
+        if (c == -2)
+            exit(1);
+        if (c >= 0 || timeout_us != UINT32_MAX)
+            return c;
+    }
+}
+
+// usbload_host_printf - printf of the firmware upload code, writing to device_port
+int usbload_host_printf(const char *format, ...)
+{
+    char line[MAX_LINE];
+    va_list args;
+    va_start(args, format);
+    int len = vsnprintf(line, sizeof(line), format, args);
+    va_end(args);
+    if (len > 0)
+        port_write(device_port, (const uint8_t *)line, len < MAX_LINE ? len : MAX_LINE - 1);
+    return len;
+}
+
+// usbload_host_time_us - time_us_32 of the firmware upload code
+uint32_t usbload_host_time_us()
+{
+    return now_ms() * 1000;
+}
+
+#ifndef _WIN32
+// loopback_device - Run the upload code of the firmware on the other end of a socket pair
+// Parameters:
+// fd     - Device end of the socket pair
+// data   - ROM image sent by the host
+// size   - Size of the ROM image in bytes
+// mapper - Mapper code sent by the host
+// Returns:
+// 0 if usbload_receive returned the image and mapper that were sent, 1 otherwise
+int loopback_device(int fd, const uint8_t *data, uint32_t size, uint8_t mapper)
+{
+    static uint8_t sram[MAX_ROM_SIZE];
+    uint8_t received;
+
+    device_port = fd;
+    uint32_t got = usbload_receive(sram, MAX_ROM_SIZE, &received);
+    return got != size || received != mapper || memcmp(sram, data, size) != 0;
+}
+
+// loopback - Upload to a device emulated by a child process
+int loopback(const uint8_t *data, uint32_t size, uint8_t mapper)
+{
+    int sv[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, sv) != 0)
+    {
+        printf("Failed to create the socket pair\n");
+        return 1;
+    }
+
+    fflush(stdout); // Do not print the pending output twice
+    pid_t pid = fork();
+    if (pid == 0)
+    {
+        close(sv[0]);
+        exit(loopback_device(sv[1], data, size, mapper));
+    }
+    close(sv[1]);
+
+    // A mapper the firmware does not serve has to be refused, and the next upload still accepted
+    int port = sv[0];
+    printf("Loopback: sending %s, expecting a refusal\n", rom_types[MAPPER_ASCII8_SRAM]);
+    int result = !upload(&port, NULL, data, size, MAPPER_ASCII8_SRAM);
+    if (!result)
+        result = upload(&port, NULL, data, size, mapper);
+    int status = 1;
+    close(sv[0]);
+    waitpid(pid, &status, 0);
+    printf("Loopback: %s\n", (result == 0 && WIFEXITED(status) && WEXITSTATUS(status) == 0) ? "PASS" : "FAIL");
+    return result || !WIFEXITED(status) || WEXITSTATUS(status);
+}
+#endif
+
+// parse_mapper - Get a mapper code from its number or its name in rom_types
+// Returns:
+// Mapper code, 0 if unknown
+uint8_t parse_mapper(const char *arg)
+{
+    char *end;
+    long n = strtol(arg, &end, 10);
+    if (*end == 0)
+        return (n > 0 && n <= MAPPER_LAST && usbload_mapper_ok((uint8_t)n)) ? (uint8_t)n : 0;
+    for (int i = 1; i <= MAPPER_LAST; i++)
+    {
+        if (usbload_mapper_ok((uint8_t)i) && !strcasecmp(arg, rom_types[i]))
+            return (uint8_t)i;
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[])
+{
+    printf("MSX PICOVERSE 2350 USB ROM Loader v1.0\n");
+    printf("(c) 2025 The Retro Hacker\n\n");
+
+    if (argc != 4)
+    {
+        printf("Usage: usbload <port> <romfile> <mapper>\n");
+        printf("       usbload --loopback <romfile> <mapper>\n");
+        printf("mapper is one of:");
+        for (int i = 1; i <= MAPPER_LAST; i++)
+        {
+            if (usbload_mapper_ok((uint8_t)i))
+                printf(" %d (%s)", i, rom_types[i]);
+        }
+        printf("\n");
+        return 1;
+    }
+
+    uint8_t mapper = parse_mapper(argv[3]);
+    if (!mapper)
+    {
+        printf("Unknown mapper %s\n", argv[3]);
+        return 1;
+    }
+
+    FILE *file = fopen(argv[2], "rb");
+    if (!file)
+    {
+        printf("Failed to open file %s\n", argv[2]);
+        return 1;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    if (size <= 0 || size > MAX_ROM_SIZE)
+    {
+        printf("ROM size %ld is not between 1 and %d bytes\n", size, MAX_ROM_SIZE);
+        fclose(file);
+        return 1;
+    }
+    uint8_t *data = malloc(size);
+    if (!data || fread(data, 1, size, file) != (size_t)size)
+    {
+        printf("Failed to read file %s\n", argv[2]);
+        fclose(file);
+        return 1;
+    }
+    fclose(file);
+    printf("ROM: %s, %ld bytes, mapper %s\n", argv[2], size, rom_types[mapper]);
+
+    int result;
+    if (!strcmp(argv[1], "--loopback"))
+    {
+#ifdef _WIN32
+        printf("Loopback mode is not available on Windows\n");
+        result = 1;
+#else
+        result = loopback(data, (uint32_t)size, mapper);
+#endif
+    }
+    else
+    {
+        port_t port = port_open(argv[1]);
+        if (port == PORT_NONE)
+        {
+            printf("Failed to open port %s\n", argv[1]);
+            free(data);
+            return 1;
+        }
+        result = upload(&port, argv[1], data, (uint32_t)size, mapper);
+        if (port != PORT_NONE)
+            port_close(port);
+        if (result == 0)
+            printf("Reset the MSX to start the ROM\n");
+    }
+
+    free(data);
+    return result;
+}
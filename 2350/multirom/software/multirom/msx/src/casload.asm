@@ -0,0 +1,175 @@
+; MSX PICOVERSE PROJECT
+; (c) 2025 Cristiano Goncalves
+; The Retro Hacker
+;
+; casload.asm - CAS loader ROM for the MSX PICOVERSE 2350 multirom
+;
+; Served at 4000h when a CAS image is started from the menu (see pico/multirom/cas.h). INIT copies the BIOS page 0
+; to this page, which the firmware keeps as a page 0 copy, and asks the firmware to patch the tape routines of the
+; copy. A small routine left in RAM runs from H.STKE once BASIC is up: it maps page 0 to the cartridge slot, so the
+; BIOS runs from the patched copy, and types the command loading the first file of the tape. Needs 32KB of RAM.
+; Assembled with sdasz80 and linked with sdldz80 (see the Makefile).
+;
+; This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+; License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+ENASLT		.equ 0x0024
+GETPNT		.equ 0xF3FA		; Keyboard buffer read pointer
+PUTPNT		.equ 0xF3F8		; Keyboard buffer write pointer
+KEYBUF		.equ 0xFBF0
+EXPTBL		.equ 0xFCC1		; Expanded flags of the primary slots
+H_STKE		.equ 0xFEDA		; Hook called once BASIC is initialized
+
+CAS_STATUS	.equ 0x9C		; Firmware status (in) and command (out) port
+CMD_PATCH	.equ 0x03		; Patch the tape routines of the page 0 copy
+ST_ERROR	.equ 0x01
+ST_PRESENT	.equ 0x80		; A CAS image is selected
+TYPE_BINARY	.equ 0x10		; Status bits 5-4: type of the first file
+TYPE_BASIC	.equ 0x20
+TYPE_ASCII	.equ 0x30
+
+STUB_RAM	.equ 0xC000		; Free BASIC program area while BASIC starts, the stub runs once before any program
+
+	.area	_HEADER (ABS)
+	.org	#0x4000
+
+	.db	#0x41,#0x42
+	.dw	INIT
+	.org	#0x4010
+
+INIT:
+	in	a,(#CAS_STATUS)
+	and	#ST_PRESENT		; Started from the menu as a ROM, nothing to do
+	ret	z
+
+	ld	hl,#0x0000		; BIOS page 0 to the page 0 copy of the firmware
+	ld	de,#0x4000
+	ld	bc,#0x4000
+	ldir
+	ld	a,#CMD_PATCH
+	out	(#CAS_STATUS),a
+	in	a,(#CAS_STATUS)
+	and	#ST_ERROR		; Unknown BIOS jump table, the tape stays on the BIOS routines
+	ret	nz
+
+	ld	hl,#STUB		; Stub to RAM
+	ld	de,#STUB_RAM
+	ld	bc,#STUB_END-STUB
+	ldir
+	ld	hl,#H_STKE		; Previous hook, run by the stub when it is done
+	ld	de,#RAM_OLDHOOK
+	ld	bc,#5
+	ldir
+	call	GETSLT
+	ld	(RAM_SLOT),a
+
+	in	a,(#CAS_STATUS)		; Command for the first file
+	and	#0x30
+	ld	hl,#CMD_BLOAD
+	cp	#TYPE_BINARY
+	jr	z,SETCMD
+	ld	hl,#CMD_CLOAD
+	cp	#TYPE_BASIC
+	jr	z,SETCMD
+	ld	hl,#CMD_RUN		; ASCII listing, or unknown: RUN"CAS:" reports the error
+SETCMD:
+	ld	c,(hl)
+	ld	b,#0
+	inc	hl
+	ld	de,#RAM_COMMAND
+	ld	(RAM_CMDLEN),bc
+	ldir
+
+	di
+	ld	a,#0xC3			; H.STKE: JP STUB_RAM
+	ld	(H_STKE),a
+	ld	hl,#STUB_RAM
+	ld	(H_STKE+1),hl
+	ei
+	ret
+
+; GETSLT - Slot ID (E000SSPP) of page 1, this ROM
+GETSLT:
+	in	a,(#0xA8)
+	rrca
+	rrca
+	and	#0x03			; Primary slot
+	ld	c,a
+	ld	b,#0
+	ld	hl,#EXPTBL
+	add	hl,bc
+	ld	a,(hl)
+	and	#0x80			; Expanded flag
+	or	c
+	ld	c,a
+	inc	hl			; SLTTBL entry of the same primary slot
+	inc	hl
+	inc	hl
+	inc	hl
+	ld	a,(hl)
+	and	#0x0C			; Secondary slot
+	or	c
+	ret
+
+; Commands typed for each file type, length first
+CMD_BLOAD:
+	.db	#14
+	.ascii	"BLOAD"
+	.db	#34
+	.ascii	"CAS:"
+	.db	#34
+	.ascii	",R"
+	.db	#13
+CMD_CLOAD:
+	.db	#10
+	.ascii	"CLOAD"
+	.db	#13
+	.ascii	"RUN"
+	.db	#13
+CMD_RUN:
+	.db	#10
+	.ascii	"RUN"
+	.db	#34
+	.ascii	"CAS:"
+	.db	#34,#13
+
+; Stub copied to STUB_RAM, called from H.STKE. Only the absolute addresses of its data are relocated, to the
+; RAM_ symbols below.
+STUB:
+	ld	hl,#RAM_OLDHOOK		; Put the previous hook back, the stub runs once
+	ld	de,#H_STKE
+	ld	bc,#5
+	ldir
+	ld	a,(RAM_SLOT)		; Page 0 to the cartridge: the patched copy is the same code, ENASLT goes on
+	ld	h,#0x00
+	call	ENASLT
+	ei
+	ld	hl,#RAM_COMMAND		; Type the command
+	ld	de,#KEYBUF
+	ld	bc,(RAM_CMDLEN)
+	ldir
+	ld	(PUTPNT),de
+	ld	hl,#KEYBUF
+	ld	(GETPNT),hl
+OLDHOOK:
+	.rept	5			; Previous H.STKE, ends with RET
+		.db	#0xC9
+	.endm
+SLOT:
+	.db	#0
+CMDLEN:
+	.dw	#0
+COMMAND:
+	.rept	16
+		.db	#0
+	.endm
+STUB_END:
+
+RAM_OLDHOOK	.equ STUB_RAM+OLDHOOK-STUB
+RAM_SLOT	.equ STUB_RAM+SLOT-STUB
+RAM_CMDLEN	.equ STUB_RAM+CMDLEN-STUB
+RAM_COMMAND	.equ STUB_RAM+COMMAND-STUB
+
+	; Padding to get a 16K ROM
+	.org	#0x7FFF
+	.db	#0xFF
@@ -92,10 +92,14 @@ void init_driver (uint8_t reduced_drive_count,uint8_t nr_allocated_drives)
 
     printf("\n\nCard: ");
 
+    if (!select_protocol())
+    {
+        printf("Update the firmware!\r\n");
+        return;
+    }
+
     write_command(0x01);
-    delay_ms(1000);
-    uint8_t sd_init = read_status();
-    if (sd_init==0x00)
+    if (wait_ready())
     {
 
         // initializing the microSD card and filling the workarea with info
@@ -105,6 +109,10 @@ void init_driver (uint8_t reduced_drive_count,uint8_t nr_allocated_drives)
         workarea.serial = getSDSerial();
 
         printf("%s microSD\r\n",workarea.manufacturer_name);
+
+        uint32_t stats[3];
+        if (getSDCacheStats(stats) && (stats[0] || stats[1])) // after a reset, the sectors of the last session
+            printf("Cache: %lu hits, %lu misses, %lu read ahead\r\n",stats[0],stats[1],stats[2]);
         
         delay_ms(1000);
 
@@ -94,6 +94,44 @@ void    write_data_multiple (uint8_t* buffer,uint8_t len)
     __endasm;
 }
 
+// read_sector_data - Read the 512 bytes of a sector from the data port
+void read_sector_data (uint8_t* buffer)  __z88dk_fastcall __naked
+{
+    __asm
+    ld c, #DATA_PORT
+    ld b, #0
+    .db 0xED,0xB2 ;inir, 256 bytes
+    .db 0xED,0xB2 ;inir
+    ret
+    __endasm;
+}
+
+// write_sector_data - Write the 512 bytes of a sector to the data port
+void write_sector_data (uint8_t* buffer)  __z88dk_fastcall __naked
+{
+    __asm
+    ld c, #DATA_PORT
+    ld b, #0
+    .db 0xED,0xB3 ;otir, 256 bytes
+    .db 0xED,0xB3 ;otir
+    ret
+    __endasm;
+}
+
+// wait_ready - Poll the interface status until the last command is done
+// Returns true when it succeeded, false when it failed or the interface stayed busy for WAIT_POLLS reads
+bool wait_ready ()
+{
+    uint32_t polls = WAIT_POLLS;
+    uint8_t status;
+    while ((status = read_status()) & ST_BUSY)
+    {
+        if (--polls == 0)
+            return false;
+    }
+    return (status & (ST_READY | ST_ERROR)) == ST_READY;
+}
+
 #pragma disable_warning 85	// because the var msg is not used in C context
 void msx_wait (uint16_t times_jiffy)  __z88dk_fastcall __naked
 {
@@ -118,11 +156,20 @@ void delay_ms (uint16_t milliseconds)
     msx_wait (milliseconds/20);
 }
 
+// select_protocol - Ask the interface for the status protocol of this driver (pico/multirom/io.h)
+// Returns false with a firmware that predates it, which answers 00h or FFh instead of a status
+bool select_protocol()
+{
+    write_command(0x0B);
+    return wait_ready();
+}
+
 uint8_t getManufacturerID() 
 {
     write_command(0x03);
-    //delay_ms(50);
-    return read_status();
+    if (!wait_ready())
+        return 0xFF;
+    return read_data();
 }
 
 uint32_t getSDCapacity() 
@@ -130,10 +177,11 @@ uint32_t getSDCapacity()
     uint32_t sd_capacity;
     sd_capacity = 0;
     write_command(0x05); 
+    if (!wait_ready())
+        return 0;
     for (uint8_t i=0;i<4;i++)
     {
-       delay_ms(60);
-       uint8_t byte = read_status();
+       uint8_t byte = read_data();
        sd_capacity |= (uint32_t)byte<<(8 * i);
     }
     return sd_capacity;
@@ -144,15 +192,32 @@ uint32_t getSDSerial()
     uint32_t sd_serial;
     sd_serial = 0;
     write_command(0x04); 
+    if (!wait_ready())
+        return 0;
     for (uint8_t i=0;i<4;i++)
     {
-        delay_ms(60);
-        uint8_t byte = read_status();
+        uint8_t byte = read_data();
         sd_serial |= (uint32_t)byte<<(8 * i);
     }
     return sd_serial;
 }
 
+// getSDCacheStats - Counters of the interface since power on: sectors found in its cache, sectors read from the
+// card and sectors found read ahead
+bool getSDCacheStats(uint32_t* counters)
+{
+    write_command(0x09);
+    if (!wait_ready())
+        return false;
+    for (uint8_t c=0;c<3;c++)
+    {
+        counters[c] = 0;
+        for (uint8_t i=0;i<4;i++)
+            counters[c] |= (uint32_t)read_data()<<(8 * i);
+    }
+    return true;
+}
+
 bool read_write_disk_sectors (bool writing,uint8_t nr_sectors,uint32_t* sector,uint8_t* sector_buffer)
 {
     if (!writing)
@@ -175,35 +240,20 @@ bool sd_disk_read (uint8_t nr_sectors,uint8_t* lba,uint8_t* sector_buffer)
     //printf("Reading %d sectors\r\n", nr_sectors);
 
     uint8_t nr = nr_sectors;
-    uint16_t offset = 0;
-
-    uint8_t x = 1;
 
     //printf("LBA: %02X %02X %02X %02X\r\n", lba[0], lba[1], lba[2], lba[3]);
-    //delay_ms(50);
     write_command(0x06);
-    //delay_ms(20);
     write_command(lba[3]);
     write_command(lba[2]);
     write_command(lba[1]);
     write_command(lba[0]);
-    //delay_ms(20);
+    write_command(nr_sectors); // one command for all the sectors, the interface reads ahead while we drain them
     write_command(0x06);
-    delay_ms(50); // read from sd is expensive
-    for (uint16_t i = 0; i < 512; i++) {
-        sector_buffer[offset + i] = read_data();
-    }
-    offset += 512;
-    //printf("Read sector %d\r\n", x++);
-
-    while (nr > 1) {
-        write_command(0x07);
-        delay_ms(50); // read from sd is expensive
-        for (uint16_t i = 0; i < 512; i++) {
-            sector_buffer[offset + i] = read_data();
-        }
-        offset += 512;
-        //printf("Read sector %d\r\n", x++);
+    while (nr > 0) {
+        if (!wait_ready()) // the next sector is in the buffer of the interface when it is ready
+            return false;
+        read_sector_data(sector_buffer);
+        sector_buffer += 512;
         nr--;
     }
 
@@ -212,22 +262,34 @@ bool sd_disk_read (uint8_t nr_sectors,uint8_t* lba,uint8_t* sector_buffer)
 
 bool sd_disk_write (uint8_t nr_sectors,uint8_t* lba,uint8_t* sector_buffer)
 {
-    printf("Writing %d sectors\r\n",nr_sectors);
-    //printf("LBA: %02X %02X %02X %02X\r\n",lba[0],lba[1],lba[2],lba[3]);
+    //printf("Writing %d sectors\r\n",nr_sectors);
+
+    uint8_t nr = nr_sectors;
 
-    //delay_ms(50);
+    //printf("LBA: %02X %02X %02X %02X\r\n",lba[0],lba[1],lba[2],lba[3]);
     write_command(0x08);
-    //delay_ms(80);
     write_command (lba[3]);
     write_command (lba[2]);
     write_command (lba[1]);
     write_command (lba[0]);
-    //delay_ms(80);
+    write_command(nr_sectors); // one command for all the sectors, the interface buffers them and writes them later
     write_command(0x08);
-    delay_ms(50);
-    for (uint16_t i = 0; i < 512; i++) {
-        write_data(sector_buffer[i]);
+    while (nr > 0) {
+        if (!wait_ready()) // the write buffer of the interface has room for the next sector when it is ready
+            return false;
+        write_sector_data(sector_buffer);
+        sector_buffer += 512;
+        nr--;
     }
 
-    return true;
+    if (!wait_ready()) // ready once the last sector is buffered, error if a buffered write failed
+        return false;
+    return sd_disk_flush(); // the sectors are on the card when DOS is told the write is done
+}
+
+// sd_disk_flush - Ask the interface to write its buffered sectors, returns once the card has them
+bool sd_disk_flush ()
+{
+    write_command(0x0A);
+    return wait_ready();
 }
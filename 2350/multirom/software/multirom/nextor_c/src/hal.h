@@ -4,14 +4,23 @@
 #define CMD_PORT  0x9E
 #define DATA_PORT 0x9F
 
+// Status bits read from CMD_PORT (see pico/multirom/io.h)
+#define ST_BUSY   0x80  // The last command still runs, the other bits are not valid yet
+#define ST_READY  0x40  // The last command is done, its reply if any can be read from DATA_PORT
+#define ST_ERROR  0x01  // The last command failed
+
+#define WAIT_POLLS 200000UL // Status reads before a command is given up, several seconds: longer than a card initialization
+
 void hal_init ();
 void hal_deinit ();
 
 bool    supports_80_column_mode ();
 
+bool select_protocol();
 uint8_t getManufacturerID();
 uint32_t getSDCapacity();
 uint32_t getSDSerial();
+bool getSDCacheStats(uint32_t* counters);
 
 void    write_command (uint8_t command)  __z88dk_fastcall __naked;
 void    write_data (uint8_t data)  __z88dk_fastcall __naked;
@@ -20,10 +29,14 @@ uint8_t read_status ()  __z88dk_fastcall __naked;
 //bool    pressed_ESC() __z88dk_fastcall __naked;
 void    read_data_multiple (uint8_t* buffer,uint8_t len);
 void    write_data_multiple (uint8_t* buffer,uint8_t len);
+void    read_sector_data (uint8_t* buffer)  __z88dk_fastcall __naked;
+void    write_sector_data (uint8_t* buffer)  __z88dk_fastcall __naked;
+bool    wait_ready ();
 void    delay_ms (uint16_t milliseconds);
 
 bool read_write_disk_sectors (bool writing,uint8_t nr_sectors,uint32_t* sector,uint8_t* sector_buffer);
 bool sd_disk_read (uint8_t nr_sectors,uint8_t* lba,uint8_t* sector_buffer);
 bool sd_disk_write (uint8_t nr_sectors,uint8_t* lba,uint8_t* sector_buffer);
+bool sd_disk_flush ();
 
 #endif //__HAL_H_
\ No newline at end of file
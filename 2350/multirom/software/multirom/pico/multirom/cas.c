@@ -0,0 +1,169 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// cas.c - Instant loading of CAS cassette images for the MSX PICOVERSE multirom firmware
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "cas.h"
+
+#define CAS_HEADER_SIZE 8
+#define BIOS_TAPION     0x00E1      // BIOS jump table entries replaced by the patch
+#define BIOS_TAPIN      0x00E4
+#define BIOS_TAPOOF     0x00E7
+#define Z80_JP          0xC3
+
+cas_t * volatile cas_active;
+
+// Block header of the CAS format, at 8 byte aligned offsets of the image
+static const uint8_t cas_header[CAS_HEADER_SIZE] = { 0x1F, 0xA6, 0xDE, 0xBA, 0xCC, 0x13, 0x7D, 0x74 };
+
+// Z80 code replacing the BIOS tape routines, written over the TAPION routine of the copy
+static const uint8_t tape_code[] = {
+    // TAPION: LD A,CAS_CMD_TAPION / OUT (CAS_PORT_STATUS),A / IN A,(CAS_PORT_STATUS) / RRCA / RET
+    0x3E, CAS_CMD_TAPION, 0xD3, CAS_PORT_STATUS, 0xDB, CAS_PORT_STATUS, 0x0F, 0xC9,
+    // TAPIN: IN A,(CAS_PORT_STATUS) / RRCA / IN A,(CAS_PORT_DATA) / RET (IN A,(n) keeps CY)
+    0xDB, CAS_PORT_STATUS, 0x0F, 0xDB, CAS_PORT_DATA, 0xC9,
+    // TAPOOF: LD A,CAS_CMD_TAPOOF / OUT (CAS_PORT_STATUS),A / EI / RET
+    0x3E, CAS_CMD_TAPOOF, 0xD3, CAS_PORT_STATUS, 0xFB, 0xC9,
+};
+#define TAPIN_AT    8   // Offsets of the routines in tape_code
+#define TAPOOF_AT   14
+
+// find_header - Return the offset following the next block header at or after pos, or 0 if there is none
+static uint32_t __not_in_flash_func(find_header)(const cas_t *c, uint32_t pos)
+{
+    for (pos = (pos + 7) & ~7u; pos + CAS_HEADER_SIZE <= c->size; pos += 8)
+    {
+        if (memcmp(c->image + pos, cas_header, CAS_HEADER_SIZE) == 0)
+            return pos + CAS_HEADER_SIZE;
+    }
+    return 0;
+}
+
+// file_type - Type of the file whose header block starts at data
+static uint8_t file_type(const cas_t *c, uint32_t data)
+{
+    static const uint8_t ids[] = { 0xD0, 0xD3, 0xEA }; // CAS_TYPE_BINARY, CAS_TYPE_BASIC, CAS_TYPE_ASCII
+    if (!data || data + 10 > c->size)
+        return CAS_TYPE_UNKNOWN;
+    for (int t = 0; t < 3; t++)
+    {
+        int i = 0;
+        while (i < 10 && c->image[data + i] == ids[t])
+            i++;
+        if (i == 10)
+            return t + 1;
+    }
+    return CAS_TYPE_UNKNOWN;
+}
+
+// word_at - Little endian word of the BIOS copy
+static inline uint16_t word_at(const uint8_t *bios, uint16_t addr)
+{
+    return bios[addr] | (bios[addr + 1] << 8);
+}
+
+// patch - Point the TAPION, TAPIN and TAPOOF entries of the BIOS copy to tape_code
+// The code is written over the original TAPION routine, which is not used any more. Returns false if the jump
+// table does not have the expected layout.
+static bool patch(cas_t *c)
+{
+    uint8_t *bios = c->bios;
+    if (bios[BIOS_TAPION] != Z80_JP || bios[BIOS_TAPIN] != Z80_JP || bios[BIOS_TAPOOF] != Z80_JP)
+        return false;
+    uint16_t at = word_at(bios, BIOS_TAPION + 1);
+    if (at < 0x0100 || at + sizeof(tape_code) > CAS_BIOS_SIZE)
+        return false;
+
+    memcpy(bios + at, tape_code, sizeof(tape_code));
+    bios[BIOS_TAPIN + 1] = (at + TAPIN_AT) & 0xFF;
+    bios[BIOS_TAPIN + 2] = (at + TAPIN_AT) >> 8;
+    bios[BIOS_TAPOOF + 1] = (at + TAPOOF_AT) & 0xFF;
+    bios[BIOS_TAPOOF + 2] = (at + TAPOOF_AT) >> 8;
+    return true;
+}
+
+// cas_init - Insert a CAS image
+// Parameters:
+//   c     - State to initialize
+//   image - CAS image
+//   size  - Size of the image in bytes
+//   bios  - CAS_BIOS_SIZE bytes receiving the BIOS page 0 copy, served to the MSX at 0000h
+void cas_init(cas_t *c, const uint8_t *image, uint32_t size, uint8_t *bios)
+{
+    memset(c, 0, sizeof(cas_t));
+    c->image = image;
+    c->size = size;
+    c->bios = bios;
+    c->type = file_type(c, find_header(c, 0));
+}
+
+// cas_command - Run a command written to CAS_PORT_STATUS, called from the core 1 port loop
+void __not_in_flash_func(cas_command)(cas_t *c, uint8_t cmd)
+{
+    c->error = false;
+    switch (cmd)
+    {
+        case CAS_CMD_TAPION:
+        {
+            uint32_t data = find_header(c, c->pos);
+            if (!c->motor)
+            {
+                c->motor = true;
+                c->start = time_us_32();
+                c->loaded = 0;
+            }
+            c->error = (data == 0);
+            c->pos = data ? data : c->size;
+            c->blocks += (data != 0);
+            break;
+        }
+        case CAS_CMD_TAPOOF:
+            if (c->motor)
+            {
+                c->elapsed = time_us_32() - c->start;
+                c->report = true;
+            }
+            c->motor = false;
+            break;
+        case CAS_CMD_PATCH:
+            c->error = c->patched || !patch(c);
+            c->patched = true; // The copy is final, even if it could not be patched
+            break;
+        case CAS_CMD_REWIND:
+            c->pos = 0;
+            break;
+        default:
+            c->error = true;
+            break;
+    }
+}
+
+// cas_read - Read CAS_PORT_STATUS or CAS_PORT_DATA, called from the core 1 port loop
+uint8_t __not_in_flash_func(cas_read)(cas_t *c, uint8_t port)
+{
+    bool end = c->pos >= c->size;
+    if (port == CAS_PORT_STATUS)
+        return CAS_ST_PRESENT | (c->motor ? CAS_ST_MOTOR : 0) | (c->type << CAS_ST_TYPE_SHIFT) | ((c->error || end) ? CAS_ST_ERROR : 0);
+    if (end)
+        return 0xFF;
+    c->loaded++;
+    return c->image[c->pos++];
+}
+
+// cas_report - Print the load time of the last tape read over USB, called from the core 1 loop
+void cas_report()
+{
+    cas_t *c = cas_active;
+    if (!c || !c->report)
+        return;
+    c->report = false;
+    printf("CAS: %lu bytes in %lu us, %lu blocks read, tape at %lu/%lu\n", (unsigned long)c->loaded,
+           (unsigned long)c->elapsed, (unsigned long)c->blocks, (unsigned long)c->pos, (unsigned long)c->size);
+}
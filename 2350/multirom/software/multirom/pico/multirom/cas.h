@@ -0,0 +1,87 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// cas.h - Instant loading of CAS cassette images for the MSX PICOVERSE multirom firmware
+//
+// A CAS image of the catalog is loaded through the BIOS tape routines, at bus speed instead of 1200 baud. The CAS
+// loader ROM (msx/src/casload.asm) is served at 4000h. Its INIT routine copies the BIOS page 0 by writing it to its
+// own page 1, the write capture stores those bytes as a page 0 copy in the ROM window, and the loader asks for
+// the patch: the TAPION, TAPIN and TAPOOF entries of the copy are pointed to short routines using the ports below.
+// Once BASIC is started the loader switches page 0 to the cartridge, so every BIOS call is served from the patched
+// copy, and types the command that loads the first file of the tape (BLOAD"CAS:",R, CLOAD or RUN"CAS:").
+//
+// The ports are served by core 1, as the Nextor ports (see io.c).
+//   CAS_PORT_STATUS out - Command: CAS_CMD_*
+//   CAS_PORT_STATUS in  - Status: CAS_ST_* and the type of the first file
+//   CAS_PORT_DATA   in  - Next byte of the tape (TAPIN), 0xFF and CAS_ST_ERROR set at the end of the tape
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef CAS_H
+#define CAS_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define CAS_PORT_STATUS     0x9C
+#define CAS_PORT_DATA       0x9D
+
+// Commands
+#define CAS_CMD_TAPION      0x01        // Skip to the data following the next block header
+#define CAS_CMD_TAPOOF      0x02        // End of a tape read
+#define CAS_CMD_PATCH       0x03        // The BIOS page 0 copy is complete, patch its tape entries
+#define CAS_CMD_REWIND      0x04        // Back to the start of the tape
+
+// Status bits
+#define CAS_ST_ERROR        0x01        // Last command failed or no byte left, the patched entries return it in CY
+#define CAS_ST_TYPE_SHIFT   4           // Bits 5-4: type of the first file, CAS_TYPE_*
+#define CAS_ST_TYPE_MASK    0x30
+#define CAS_ST_MOTOR        0x40        // Between TAPION and TAPOOF
+#define CAS_ST_PRESENT      0x80        // A CAS image is selected
+
+// File types, from the 10 byte identifier after the first block header
+#define CAS_TYPE_UNKNOWN    0
+#define CAS_TYPE_BINARY     1           // 10 x D0h, BLOAD
+#define CAS_TYPE_BASIC      2           // 10 x D3h, CLOAD
+#define CAS_TYPE_ASCII      3           // 10 x EAh, LOAD/RUN
+
+#define CAS_BIOS_SIZE       0x4000      // BIOS page 0 copy
+
+// CAS image state
+// image   - CAS image in flash
+// pos     - Next byte of the tape
+// bios    - BIOS page 0 copy served by the cartridge, patched by CAS_CMD_PATCH
+// type    - Type of the first file
+// error   - Last command failed
+// motor   - Between TAPION and TAPOOF
+// patched - The tape entries of the copy are patched, page 0 writes are not captured any more
+// blocks  - Block headers found by TAPION
+// start   - Time of the first TAPION of the current read, for the load time report
+// loaded  - Bytes read since then
+// elapsed - Time from the first TAPION to TAPOOF, reported with loaded by cas_report
+typedef struct {
+    const uint8_t *image;
+    uint32_t size;
+    uint32_t pos;
+    uint8_t *bios;
+    uint8_t type;
+    bool error;
+    bool motor;
+    volatile bool patched;
+    uint32_t blocks;
+    uint32_t start;
+    uint32_t loaded;
+    uint32_t elapsed;
+    volatile bool report;
+} cas_t;
+
+extern cas_t * volatile cas_active; // CAS image served on the ports, NULL when none
+
+void cas_init(cas_t *c, const uint8_t *image, uint32_t size, uint8_t *bios);
+void cas_command(cas_t *c, uint8_t cmd);
+uint8_t cas_read(cas_t *c, uint8_t port);
+void cas_report();
+
+#endif
@@ -0,0 +1,127 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// expander.c - Slot expander mode of the MSX PICOVERSE multirom firmware
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "expander.h"
+#include "busclock.h"
+
+static mapper_t ram_mapper; // RAM subslot: every page points to the RAM, there is no bank register
+
+expander_stats_t expander_stats;
+
+// expander_refresh - Rebuild the fused page table from the subslot selected for each page
+static void __not_in_flash_func(expander_refresh)(expander_t *e)
+{
+    uint8_t reg = e->reg;
+    for (uint8_t p = 0; p < MAPPER_PAGES; p++)
+    {
+        mapper_t *m = e->sub[(reg >> ((p >> 1) << 1)) & 0x03]; // Two bits per 16KB page
+        e->page[p] = m ? m->page[p] : NULL;
+    }
+}
+
+// expander_init - Build the subslots and select subslot 0 on every page, as after a reset
+// Parameters:
+//   e      - Expander state to initialize
+//   nextor - Mapper serving the Nextor ROM
+//   game   - Mapper serving the ROM selected in the menu
+//   ram    - EXPANDER_RAM_SIZE bytes for the RAM subslot, or NULL to leave it empty
+void expander_init(expander_t *e, mapper_t *nextor, mapper_t *game, uint8_t *ram)
+{
+    memset(e, 0, sizeof(expander_t));
+    e->sub[EXPANDER_NEXTOR] = nextor;
+    e->sub[EXPANDER_GAME] = game;
+
+    if (ram)
+    {
+        memset(&ram_mapper, 0, sizeof(mapper_t));
+        memset(ram_mapper.write_action, MAPPER_WR_NONE, sizeof(ram_mapper.write_action));
+        for (uint8_t p = 0; p < MAPPER_PAGES; p++)
+            ram_mapper.page[p] = ram; // Indexed by the MSX address, no bias needed
+        e->sub[EXPANDER_RAM] = &ram_mapper;
+        e->ram = ram;
+    }
+
+    e->reg = 0x00;
+    e->reg_inv = 0xFF;
+    expander_refresh(e);
+}
+
+// expander_write - Apply a write cycle of the slot to the secondary slot register or to the selected subslot
+// Runs in the write capture interrupt, on the core serving the reads, so the fused table never changes in the
+// middle of a read.
+void __not_in_flash_func(expander_write)(expander_t *e, uint16_t addr, uint8_t data)
+{
+    if (addr == EXPANDER_REG_ADDR)
+    {
+        e->reg = data;
+        e->reg_inv = ~data;
+        expander_refresh(e);
+        return;
+    }
+
+    uint8_t s = (e->reg >> ((addr >> 14) << 1)) & 0x03;
+    if (s == EXPANDER_RAM && e->ram)
+    {
+        e->ram[addr] = data;
+        return;
+    }
+
+    mapper_t *m = e->sub[s];
+    if (m && m->write_action[addr >> 11] != MAPPER_WR_NONE)
+    {
+        mapper_write(m, addr, data);
+        expander_refresh(e); // The bank may drive pages selected on another subslot, rebuild them all
+    }
+}
+
+// expander_bench_start - Clear the read loop timing and start SysTick on the CPU clock
+// SysTick is a 24-bit down counter; the read loop takes a stamp per iteration.
+void expander_bench_start()
+{
+    systick_hw->csr = 0;
+    systick_hw->rvr = 0x00FFFFFF;
+    systick_hw->cvr = 0;
+    systick_hw->csr = 0x05; // Enabled, processor clock, no interrupt
+    memset((void *)&expander_stats, 0, sizeof(expander_stats));
+}
+
+// expander_report - Print the read loop timing against the /RD budget, at most once per EXPANDER_REPORT_US
+// Runs on core 1 so the read loop on core 0 is not interrupted to print. A read is seen at worst one idle iteration
+// after /RD goes low and the byte is queued serve_max later, which must fit in the /RD pulse minus the data setup.
+void expander_report()
+{
+    static uint32_t last_time = 0;
+    static uint32_t last_reads = 0;
+
+    uint32_t now = time_us_32();
+    uint32_t reads = expander_stats.reads;
+    if ((now - last_time) < EXPANDER_REPORT_US || reads == last_reads)
+        return;
+
+    uint32_t sys_mhz = clock_get_hz(clk_sys) / 1000000;
+    uint32_t idle_ns = expander_stats.idle_max * 1000 / sys_mhz;
+    uint32_t serve_ns = expander_stats.serve_max * 1000 / sys_mhz;
+    uint32_t rd_ns = busclock.rd_ns ? busclock.rd_ns : 560; // Standard 3.58MHz bus when it was not measured
+    uint32_t budget_ns = (rd_ns > EXPANDER_SETUP_NS) ? rd_ns - EXPANDER_SETUP_NS : 0;
+
+    printf("Slot expander loop: %lu reads/s, worst latency %lu ns (detect %lu + serve %lu), budget %lu ns: %s\n",
+           (unsigned long)((uint64_t)(reads - last_reads) * 1000000 / (now - last_time)),
+           (unsigned long)(idle_ns + serve_ns), (unsigned long)idle_ns, (unsigned long)serve_ns,
+           (unsigned long)budget_ns, (idle_ns + serve_ns <= budget_ns) ? "OK" : "TOO SLOW");
+
+    last_time = now;
+    last_reads = reads;
+    expander_stats.idle_max = 0; // Worst case of the next period only
+    expander_stats.serve_max = 0;
+}
@@ -0,0 +1,80 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// expander.h - Slot expander mode of the MSX PICOVERSE multirom firmware
+//
+// The cartridge answers as an expanded slot. The secondary slot register at 0xFFFF selects, for every 16KB page
+// (two bits per page, page 0 in bits 0-1), one of four subslots:
+//
+// - EXPANDER_NEXTOR: the Nextor ROM of the catalog, so the SD card bridge served by io.c is usable
+// - EXPANDER_GAME:   the ROM selected in the menu, with its own mapper
+// - EXPANDER_RAM:    64KB of RAM (when enabled)
+// - the last subslot is empty
+//
+// Reading 0xFFFF returns the register inverted, as the BIOS expects from an expanded slot. Each subslot is a mapper
+// engine instance (see mapper.h) and the expander keeps one fused page table built from the subslot selected for
+// each page, so a read is served with the same single lookup as a plain mapper. Register and bank register writes
+// rebuild the fused table from the write capture interrupt.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef EXPANDER_H
+#define EXPANDER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mapper.h"
+
+#define EXPANDER_REG_ADDR   0xFFFF      // Secondary slot register
+#define EXPANDER_SUBSLOTS   4
+#define EXPANDER_NEXTOR     0           // Subslot serving the Nextor ROM
+#define EXPANDER_GAME       1           // Subslot serving the ROM selected in the menu
+#define EXPANDER_RAM        2           // Subslot serving the RAM
+#define EXPANDER_RAM_SIZE   0x10000     // The RAM covers the whole subslot
+#define EXPANDER_SETUP_NS   200         // Data must be on the bus this long before /RD goes high (Z80 sampling point,
+                                        // data setup and bus transceiver delay)
+#define EXPANDER_REPORT_US  1000000     // Interval between two benchmark reports
+
+// Expander state
+// page    - Fused read pointer per 8KB page, taken from the subslot selected for the page (pre-biased like mapper_t)
+// reg     - Secondary slot register
+// reg_inv - Value read back at EXPANDER_REG_ADDR
+// sub     - Mapper serving each subslot, NULL for an empty subslot
+// ram     - RAM of the RAM subslot, indexed by the MSX address, NULL when there is no RAM subslot
+typedef struct {
+    const uint8_t * volatile page[MAPPER_PAGES];
+    volatile uint8_t reg;
+    volatile uint8_t reg_inv;
+    mapper_t *sub[EXPANDER_SUBSLOTS];
+    uint8_t *ram;
+} expander_t;
+
+// Read loop timing, measured with SysTick when the benchmark is built in (in CPU cycles)
+// idle_max  - Longest loop iteration without a read to serve: worst delay between /RD going low and the loop seeing it
+// serve_max - Longest time from the bus sample of a read cycle to the byte queued in the output state machine
+// reads     - Read cycles served
+typedef struct {
+    volatile uint32_t idle_max;
+    volatile uint32_t serve_max;
+    volatile uint32_t reads;
+} expander_stats_t;
+
+extern expander_stats_t expander_stats;
+
+void expander_init(expander_t *e, mapper_t *nextor, mapper_t *game, uint8_t *ram);
+void expander_write(expander_t *e, uint16_t addr, uint8_t data);
+void expander_bench_start();
+void expander_report();
+
+// expander_read_ptr - Return the pointer that serves a read of addr, or NULL if the address is not mapped
+static inline const uint8_t *expander_read_ptr(const expander_t *e, uint16_t addr)
+{
+    if (addr == EXPANDER_REG_ADDR)
+        return (const uint8_t *)&e->reg_inv;
+    const uint8_t *p = e->page[addr >> 13];
+    return p ? p + addr : NULL;
+}
+
+#endif
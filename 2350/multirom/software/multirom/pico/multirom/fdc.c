@@ -0,0 +1,368 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// fdc.c - WD2793 floppy disk controller emulation for the MSX PICOVERSE multirom firmware
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <string.h>
+#include "fdc.h"
+
+#define CMD_TYPE_II     0x80
+#define CMD_TYPE_III    0xC0
+#define CMD_FORCE_INT   0xD0
+#define CMD_MULTI       0x10        // Type II: go on with the next sector
+#define CMD_UPDATE      0x10        // Type I step: update the track register
+#define CMD_HEADLOAD    0x08        // Type I: load the head
+#define CMD_VERIFY      0x04        // Type I: check the track register against the head position
+#define CMD_INT_NOW     0x08        // Force interrupt: raise INTRQ at once
+
+fdc_t * volatile fdc_active;
+
+// disk - DSK image in the selected drive, NULL if there is none
+// Only drive A exists: 7FFDh bits 1-0 at 00 or 10 select it.
+static inline const uint8_t *disk(const fdc_t *f)
+{
+    return ((f->drive & 0x01) == 0) ? f->image : NULL;
+}
+
+// cache_find - Return the cache entry holding a track, or NULL
+static fdc_track_t *__not_in_flash_func(cache_find)(fdc_t *f, int16_t track)
+{
+    for (int i = 0; i < FDC_CACHE_TRACKS; i++)
+    {
+        if (f->cache[i].track == track)
+            return &f->cache[i];
+    }
+    return NULL;
+}
+
+// done - End the command and raise INTRQ
+static void __not_in_flash_func(done)(fdc_t *f, uint8_t status)
+{
+    f->drq = false;
+    f->count = 0;
+    f->pending = false;
+    f->status = status;
+    f->intrq = true;
+}
+
+// transfer - Start streaming a buffer through the data register
+static void __not_in_flash_func(transfer)(fdc_t *f, const uint8_t *buffer, uint16_t count)
+{
+    f->buffer = buffer;
+    f->index = 0;
+    f->count = count;
+    f->status |= FDC_ST_DRQ;
+    f->drq = true;
+}
+
+// read_sector - Serve the sector register of a type II read from the track cache, or ask core 1 for the track
+static void __not_in_flash_func(read_sector)(fdc_t *f)
+{
+    uint8_t side = f->side & 0x01;
+    if (f->sector_reg < 1 || f->sector_reg > FDC_SECTORS || f->track_reg != f->head || side >= f->sides)
+    {
+        done(f, FDC_ST_RNF); // No such ID field on the track
+        return;
+    }
+
+    int16_t track = f->head * 2 + side;
+    fdc_track_t *t = cache_find(f, track);
+    if (!t)
+    {
+        f->pending = true; // Resumed by fdc_idle once fdc_service copied the track
+        f->load = track;
+        __sev(); // Core 1 may sleep in io_main
+        return;
+    }
+
+    f->pending = false;
+    f->hits++;
+    t->age = f->clock;
+    transfer(f, t->data + (f->sector_reg - 1) * FDC_SECTOR_SIZE, FDC_SECTOR_SIZE);
+}
+
+// transfer_done - The last byte of a sector or ID field was read
+static void __not_in_flash_func(transfer_done)(fdc_t *f)
+{
+    f->drq = false;
+    f->status &= ~FDC_ST_DRQ;
+
+    if ((f->command & 0xF0) == CMD_TYPE_III)
+    {
+        f->sector_reg = f->id[0]; // READ ADDRESS copies the track field to the sector register
+        done(f, 0);
+    }
+    else if (f->command & CMD_MULTI)
+    {
+        f->sector_reg++;
+        read_sector(f); // Ends with RNF after the last sector of the track, as on the real controller
+    }
+    else
+    {
+        done(f, 0);
+    }
+}
+
+// type1 - Restore, seek and step commands, completed at once
+static void __not_in_flash_func(type1)(fdc_t *f, uint8_t cmd)
+{
+    int dir = 0;
+    switch (cmd >> 5)
+    {
+        case 0: // Restore (0x0X) and seek (0x1X)
+            if (cmd & 0x10)
+            {
+                int head = (int)f->head + ((int)f->data_reg - (int)f->track_reg);
+                f->head = (head < 0) ? 0 : (head > FDC_TRACKS + 1) ? FDC_TRACKS + 1 : head;
+                f->track_reg = f->data_reg;
+            }
+            else
+            {
+                f->head = 0;
+                f->track_reg = 0;
+            }
+            break;
+        case 1: dir = f->step_dir; break;  // Step
+        case 2: dir = 1; break;            // Step in
+        default: dir = -1; break;          // Step out
+    }
+
+    if (dir)
+    {
+        f->step_dir = dir;
+        if (dir > 0 || f->head > 0)
+            f->head += dir;
+        if (cmd & CMD_UPDATE)
+            f->track_reg += dir;
+    }
+    if (f->head >= FDC_TRACKS + 2)
+        f->head = FDC_TRACKS + 1; // Mechanical stop
+
+    uint8_t status = (cmd & CMD_HEADLOAD) ? FDC_ST_HEADLOADED : 0;
+    if ((cmd & CMD_VERIFY) && (!disk(f) || f->track_reg != f->head || f->head >= FDC_TRACKS))
+        status |= FDC_ST_SEEKERR;
+    f->type1 = true;
+    done(f, status);
+}
+
+// command - Start a command written to 7FF8h
+static void __not_in_flash_func(command)(fdc_t *f, uint8_t cmd)
+{
+    if ((cmd & 0xF0) == CMD_FORCE_INT)
+    {
+        bool busy = f->status & FDC_ST_BUSY;
+        f->drq = false;
+        f->count = 0;
+        f->pending = false;
+        f->status = busy ? (f->status & ~(FDC_ST_BUSY | FDC_ST_DRQ)) : 0;
+        if (!busy)
+            f->type1 = true;
+        f->intrq = (cmd & CMD_INT_NOW) != 0;
+        return;
+    }
+    if (f->status & FDC_ST_BUSY)
+        return; // Only a force interrupt is accepted while busy
+
+    f->command = cmd;
+    f->intrq = false;
+    f->drq = false;
+    f->count = 0;
+
+    if (!(cmd & CMD_TYPE_II))
+    {
+        type1(f, cmd);
+        return;
+    }
+
+    f->type1 = false;
+    if (!disk(f))
+    {
+        done(f, FDC_ST_NOTREADY);
+        return;
+    }
+
+    switch (cmd & 0xF0)
+    {
+        case 0x80: // Read sector
+        case 0x90:
+            f->status = FDC_ST_BUSY;
+            read_sector(f);
+            break;
+        case 0xC0: // Read address: ID field of the next sector passing under the head
+            f->id[0] = f->head;
+            f->id[1] = f->side & 0x01;
+            f->id[2] = (f->clock % FDC_SECTORS) + 1;
+            f->id[3] = 2; // 512 byte sectors
+            f->id[4] = 0; // CRC, not checked by the disk ROMs
+            f->id[5] = 0;
+            f->status = FDC_ST_BUSY;
+            transfer(f, f->id, sizeof(f->id));
+            break;
+        case 0xE0: // Read track: the raw track layout is not emulated, completes without data
+            done(f, 0);
+            break;
+        default: // Write sector and write track: the images in flash are read only
+            done(f, FDC_ST_WRPROT);
+            break;
+    }
+}
+
+// fdc_init - Reset the controller and insert a DSK image in drive A
+// Parameters:
+//   f     - Controller state to initialize
+//   image - DSK image (360KB single sided or 720KB double sided), NULL for an empty drive
+//   size  - Size of the image in bytes
+//   cache - FDC_CACHE_SIZE bytes of SRAM for the track cache
+void fdc_init(fdc_t *f, const uint8_t *image, uint32_t size, uint8_t *cache)
+{
+    memset(f, 0, sizeof(fdc_t));
+    f->image = image;
+    f->image_size = size;
+    f->sides = (size > FDC_TRACKS * FDC_TRACK_SIZE) ? 2 : 1;
+    f->step_dir = 1;
+    f->type1 = true;
+    f->load = -1;
+    for (int i = 0; i < FDC_CACHE_TRACKS; i++)
+    {
+        f->cache[i].track = -1;
+        f->cache[i].data = cache + i * FDC_TRACK_SIZE;
+    }
+}
+
+// fdc_read - Read a controller register, called for read cycles at 7FF8h-7FFFh
+uint8_t __not_in_flash_func(fdc_read)(fdc_t *f, uint16_t addr)
+{
+    switch (addr & 0x07)
+    {
+        case 0: // Status
+        {
+            f->intrq = false;
+            f->clock++;
+            uint8_t status = f->status;
+            if (f->type1)
+            {
+                if (!disk(f))
+                    return status | FDC_ST_NOTREADY;
+                if (f->head == 0)
+                    status |= FDC_ST_TRACK0;
+                if ((f->clock % FDC_INDEX_PERIOD) < FDC_INDEX_PERIOD / 8)
+                    status |= FDC_ST_INDEX;
+                status |= FDC_ST_WRPROT;
+            }
+            return status;
+        }
+        case 1:
+            return f->track_reg;
+        case 2:
+            return f->sector_reg;
+        case 3: // Data
+            if (f->count)
+            {
+                f->data_reg = f->buffer[f->index++];
+                if (--f->count == 0)
+                    transfer_done(f);
+            }
+            return f->data_reg;
+        case 4: // Side select
+            return f->side & 0x01;
+        case 5: // Drive select and motor
+            return f->drive;
+        case 7: // Controller outputs, active low: bit 6 INTRQ, bit 7 DRQ
+            return (f->intrq ? 0x00 : 0x40) | (f->drq ? 0x00 : 0x80);
+        default:
+            return 0xFF;
+    }
+}
+
+// fdc_write - Write a controller register, called for write cycles at 7FF8h-7FFFh
+void __not_in_flash_func(fdc_write)(fdc_t *f, uint16_t addr, uint8_t data)
+{
+    switch (addr & 0x07)
+    {
+        case 0:
+            command(f, data);
+            break;
+        case 1:
+            if (!(f->status & FDC_ST_BUSY))
+                f->track_reg = data;
+            break;
+        case 2:
+            if (!(f->status & FDC_ST_BUSY))
+                f->sector_reg = data;
+            break;
+        case 3:
+            f->data_reg = data;
+            break;
+        case 4:
+            f->side = data & 0x01;
+            break;
+        case 5:
+            f->drive = data;
+            break;
+    }
+}
+
+// fdc_idle - Resume a command whose track has been copied, called by the bus loop between cycles
+void __not_in_flash_func(fdc_idle)(fdc_t *f)
+{
+    if (f->pending && f->load < 0)
+        read_sector(f); // Asks for the track again if it was recycled in between
+}
+
+// fdc_service - Copy the track a command waits for into the cache, called from the core 1 loop
+// The oldest entry is recycled. No entry is in use by a transfer while a track is requested, because type II
+// commands only ask for a track before their first byte.
+// Returns:
+//   true if a track was copied
+bool fdc_service(fdc_t *f)
+{
+    int16_t track = f->load;
+    if (track < 0)
+        return false;
+
+    fdc_track_t *victim = NULL;
+    for (int i = 0; i < FDC_CACHE_TRACKS && !victim; i++)
+    {
+        if (f->cache[i].track == track)
+            victim = &f->cache[i]; // Already there
+    }
+    for (int i = 0; i < FDC_CACHE_TRACKS && !victim; i++)
+    {
+        fdc_track_t *t = &f->cache[i];
+        if (t->track < 0)
+            victim = t; // Free entry
+    }
+    if (!victim)
+    {
+        victim = &f->cache[0];
+        for (int i = 1; i < FDC_CACHE_TRACKS; i++)
+        {
+            if ((int32_t)(f->cache[i].age - victim->age) < 0)
+                victim = &f->cache[i];
+        }
+    }
+
+    if (victim->track != track)
+    {
+        uint32_t offset = (uint32_t)((f->sides == 2) ? track : track >> 1) * FDC_TRACK_SIZE;
+        victim->track = -1;
+        __sync_synchronize();
+        if (offset + FDC_TRACK_SIZE <= f->image_size)
+            memcpy(victim->data, f->image + offset, FDC_TRACK_SIZE);
+        else
+            memset(victim->data, 0xE5, FDC_TRACK_SIZE); // Short image: unformatted filler
+        victim->age = f->clock;
+        f->misses++;
+        __sync_synchronize();
+        victim->track = track;
+    }
+
+    __sync_synchronize();
+    if (f->load == track)
+        f->load = -1;
+    return true;
+}
@@ -0,0 +1,129 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// fdc.h - WD2793 floppy disk controller emulation for the MSX PICOVERSE multirom firmware
+//
+// A disk ROM written for the Philips WD2793 interface (VG-8250 and compatibles) is served at 4000h-7FFFh with the
+// controller registers at 7FF8h-7FFFh, and drive A holds a DSK image of the catalog. The emulation has no mechanics:
+// whole tracks are copied to an SRAM track cache and sectors are transferred as fast as the disk ROM polls for them.
+//
+// The register side (fdc_read, fdc_write, fdc_idle) runs on the bus core and never waits. A command that needs a
+// track not in the cache stays busy until fdc_service, called from the core 1 loop, has copied it and fdc_idle has
+// resumed it; the disk ROM polls the busy bit anyway. The file has no Pico dependency, so the host tool fdcreplay
+// can replay register sequences against it.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef FDC_H
+#define FDC_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#if PICO_ON_DEVICE
+#include "pico.h"
+#include "hardware/sync.h"
+#else
+#define __not_in_flash_func(f) f   // Host build (tool/src/fdcreplay.c)
+#define __sev()                    // No other core to wake up
+#endif
+
+#define FDC_REG_BASE        0x7FF8      // First register of the Philips interface
+#define FDC_SECTOR_SIZE     512
+#define FDC_SECTORS         9           // Sectors per track of 360KB and 720KB images
+#define FDC_TRACKS          80
+#define FDC_TRACK_SIZE      (FDC_SECTORS * FDC_SECTOR_SIZE)
+#define FDC_CACHE_TRACKS    4           // Tracks kept in SRAM
+#define FDC_CACHE_SIZE      (FDC_CACHE_TRACKS * FDC_TRACK_SIZE)
+#define FDC_INDEX_PERIOD    64          // Status reads per emulated revolution, the index bit is set for 1/8 of it
+
+// Status register bits
+#define FDC_ST_BUSY         0x01
+#define FDC_ST_INDEX        0x02        // Type I
+#define FDC_ST_DRQ          0x02        // Type II and III
+#define FDC_ST_TRACK0       0x04        // Type I
+#define FDC_ST_LOST         0x04        // Type II and III
+#define FDC_ST_CRC          0x08
+#define FDC_ST_SEEKERR      0x10        // Type I
+#define FDC_ST_RNF          0x10        // Type II and III
+#define FDC_ST_HEADLOADED   0x20        // Type I
+#define FDC_ST_WRPROT       0x40
+#define FDC_ST_NOTREADY     0x80
+
+// Track cache entry
+// track - Physical track * 2 + side held, -1 if free
+// age   - Last use, the oldest entry is recycled
+// data  - FDC_TRACK_SIZE bytes of SRAM
+typedef struct {
+    volatile int16_t track;
+    uint32_t age;
+    uint8_t *data;
+} fdc_track_t;
+
+// Controller state
+// image      - DSK image, NULL when drive A is empty
+// sides      - 1 for 360KB images, 2 for 720KB images
+// status     - Status register
+// track_reg  - Track register
+// sector_reg - Sector register
+// data_reg   - Data register
+// command    - Last command
+// side       - Side select register (7FFCh)
+// drive      - Drive and motor register (7FFDh)
+// head       - Physical head position
+// step_dir   - Direction of the last step, +1 or -1
+// drq, intrq - Data request and interrupt request outputs (7FFFh)
+// type1      - The status register has the type I layout
+// pending    - A type II command waits for its track
+// load       - Track (* 2 + side) fdc_service has to copy before the command can go on, -1 if none
+// buffer     - Sector being transferred
+// index      - Next byte of the sector, count bytes left
+// id         - ID field returned by READ ADDRESS
+// clock      - Status reads, drive the emulated index pulse and the cache ages
+// hits       - Sector transfers served from the track cache
+// misses     - Track copies done by fdc_service
+typedef struct {
+    const uint8_t *image;
+    uint32_t image_size;
+    uint8_t sides;
+    volatile uint8_t status;
+    uint8_t track_reg;
+    uint8_t sector_reg;
+    uint8_t data_reg;
+    uint8_t command;
+    uint8_t side;
+    uint8_t drive;
+    uint8_t head;
+    int8_t step_dir;
+    volatile bool drq;
+    volatile bool intrq;
+    bool type1;
+    bool pending;
+    volatile int16_t load;
+    const uint8_t *buffer;
+    uint16_t index;
+    uint16_t count;
+    uint8_t id[6];
+    uint32_t clock;
+    uint32_t hits;
+    volatile uint32_t misses;
+    fdc_track_t cache[FDC_CACHE_TRACKS];
+} fdc_t;
+
+extern fdc_t * volatile fdc_active; // Controller served by the bus core, NULL when none
+
+void fdc_init(fdc_t *f, const uint8_t *image, uint32_t size, uint8_t *cache);
+uint8_t fdc_read(fdc_t *f, uint16_t addr);
+void fdc_write(fdc_t *f, uint16_t addr, uint8_t data);
+void fdc_idle(fdc_t *f);
+bool fdc_service(fdc_t *f);
+
+// fdc_register - True when addr is one of the controller registers
+static inline bool fdc_register(uint16_t addr)
+{
+    return (addr & 0xFFF8) == FDC_REG_BASE;
+}
+
+#endif
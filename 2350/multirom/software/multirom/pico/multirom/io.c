@@ -1,374 +1,810 @@
 #include <stdio.h>
 #include <string.h>
 #include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
+#include "hardware/structs/scb.h"
 #include "hw_config.h"
 #include "multirom.h"
 #include "io.h"
+#include "segcache.h"
+#include "swap.h"
+#include "expander.h"
+#include "save.h"
+#include "fdc.h"
+#include "cas.h"
+#include "lowpower.h"
+
+// Interface state, shared by the port interrupt and the worker loop of core 1
+static uint8_t  data_buffer[512];
+static volatile uint16_t data_to_send = 0;
+static volatile uint16_t data_byte_index = 0;
+
+static uint8_t ctrl_to_receive = 0;
+static uint8_t address_for = 0;         // Command (0x06 or 0x08) the block address is being received for
+static volatile uint32_t block_address = 0;
+static volatile uint16_t block_number = 0; // Sectors of the last read, 1-256
+static uint16_t write_count = 0;        // Sectors of the write being set up, 1-256
+
+// Sectors of the reads, fetched by the worker and drained by the port interrupt. The counters are free running,
+// the sector of count n is ring_lba + n and sits in ring[n % IO_RING_SECTORS]. After a sequential read the worker
+// goes on past read_count (read-ahead), and the next read starts on the sectors already there.
+static uint8_t ring[IO_RING_SECTORS][512];
+static uint32_t ring_lba = 0;              // Card sector of count 0 (worker)
+static bool ring_valid = false;            // The sectors from ring_tail to ring_head are the card sectors (worker)
+static bool sequential = false;            // The last read started where the previous one ended (worker)
+static uint32_t next_lba = 0;              // Sector following the last read (worker)
+static volatile bool reading = false;      // A read is set up, its sectors are sent from the ring
+static volatile uint16_t read_count = 0;   // End count of the read in progress
+static volatile uint16_t ring_head = 0;    // End count of the sectors fetched by the worker
+static volatile uint16_t ring_tail = 0;    // Count of the next sector sent to the MSX
+static volatile uint16_t ring_index = 0;   // Next byte of the sector at ring_tail
+static volatile bool read_error = false;   // The card failed, the sectors before ring_head are still sent
+static volatile uint32_t read_seq = 0;     // Reads started by the port interrupt
+static uint32_t active_seq = 0;            // Read set up in the ring (worker), a driver timeout ends it early
+static volatile uint32_t read_time = 0;    // Time the read command was written, for the latency
+static bool latency_pending = false;       // The first sector of the read is not ready yet (worker)
+
+// LRU cache of the sectors of small reads, the FAT and directory sectors MSX-DOS reads over and over (worker)
+static uint8_t cache[IO_CACHE_SECTORS][512];
+static uint32_t cache_lba[IO_CACHE_SECTORS];
+static uint32_t cache_used[IO_CACHE_SECTORS]; // Time of the last use, 0 when the entry is free
+static uint32_t cache_clock = 0;
+
+// Counters since power on, read by the MSX with command 0x09. They survive an MSX reset, so the driver shows
+// those of the last session when it starts
+static struct {
+    uint32_t hits;          // Sectors of reads found in the cache
+    uint32_t misses;        // Sectors of reads fetched from the card
+    uint32_t ahead_hits;    // Sectors of reads found read ahead
+} io_totals;
+
+// Write-back buffer: the port interrupt stores the sectors sent by the MSX and acknowledges them at once, the
+// worker writes them to the card later. The counters are free running, the sector of count n is in
+// wbuf[n % IO_WRITE_SECTORS] and goes to the card sector wbuf_lba[n % IO_WRITE_SECTORS].
+static uint8_t wbuf[IO_WRITE_SECTORS][512];
+static uint32_t wbuf_lba[IO_WRITE_SECTORS];
+static volatile uint16_t write_head = 0;   // Sectors received from the MSX
+static volatile uint16_t write_tail = 0;   // Sectors written to the card
+static volatile bool writing = false;      // A write command is receiving its sectors
+static volatile uint16_t write_left = 0;   // Sectors still to come for the write command
+static volatile uint32_t write_lba = 0;    // Card sector of the next sector to come
+static volatile uint16_t write_index = 0;  // Next byte of the sector being received
+static volatile uint32_t write_time = 0;   // Time the last sector was received
+static volatile uint32_t write_errors = 0; // Buffered sectors the card failed to write (worker)
+static volatile bool write_lost = false;   // Bytes of the write command were sent while BUSY
+static uint32_t write_errors_reported = 0; // Errors already reported to the MSX
+
+static bool block_read = false;
+static bool block_write = false;
+
+static volatile uint8_t io_status = IO_ST_READY; // Read from port 0x9E (control)
+static volatile uint8_t io_job = 0;     // Command left to the worker, 0 when idle
+static uint8_t data_reg = 0;            // Last SPI response from port 0x9F (data)
+static volatile bool legacy = true;     // Protocol of the first driver until 0x0B selects the current one, see io.h
+
+static BYTE const pdrv = 0;             // Physical drive number
+static volatile DSTATUS ds = 1;         // Disk status (1 = not initialized)
+
+// Sequential read throughput and read-ahead counters, printed over USB at the end of each read burst
+static struct {
+    uint32_t sectors;       // Sectors read from the card in the burst, read-ahead included
+    uint32_t start;         // Time the first read of the burst started
+    uint32_t last;          // Time the last sector was ready
+    uint32_t sd_us;         // Time spent in disk_read
+    uint32_t commands;      // Read commands of the burst
+    uint32_t requested;     // Sectors asked by the read commands
+    uint32_t ahead;         // Sectors read ahead
+    uint32_t hits;          // Requested sectors found read ahead
+    uint32_t dropped;       // Sectors read ahead and never requested
+    uint32_t latency_us;    // Sum of the times from a read command to its first sector ready
+    uint32_t latency_max;
+    uint32_t written;       // Sectors written to the card
+    uint32_t write_cmds;    // Card writes, one multi-block transfer (CMD25) for each run of consecutive sectors
+    uint32_t write_us;      // Time spent in disk_write
+} io_stats;
+
+// io_start - Leave a command to the worker, the status reads BUSY until it is done
+static inline void __not_in_flash_func(io_start)(uint8_t cmd)
+{
+    data_to_send = 0;
+    reading = false;
+    writing = false;
+    io_job = cmd;
+    io_status = IO_ST_BUSY;
+}
 
-void __not_in_flash_func(io_main)(){
+// io_finish - Complete a command, with reply bytes to read from port 0x9F when ok
+static inline void __not_in_flash_func(io_finish)(bool ok, uint16_t reply)
+{
+    data_byte_index = 0;
+    data_to_send = ok ? reply : 0;
+    reading = false;
+    writing = false;
+    io_status = IO_ST_READY | (ok ? 0 : IO_ST_ERROR);
+}
 
-    uint8_t  data_buffer[512];
-    uint16_t data_to_send = 0;
-    uint16_t data_to_receive = 0;
-    uint16_t data_byte_index = 0;
+// io_start_read - Leave a read of block_number sectors at block_address to the worker, which sets up the ring
+static inline void __not_in_flash_func(io_start_read)()
+{
+    read_time = time_us_32();
+    read_seq++;
+    io_start(0x06);
+}
 
-    uint8_t ctrl_to_receive = 0;
-    uint32_t block_address = 0;
-    uint8_t block_number = 0;
+// write_errors_pending - True when buffered sectors failed to be written since the last report, which this one is
+static inline bool __not_in_flash_func(write_errors_pending)()
+{
+    uint32_t errors = write_errors;
+    bool pending = (errors != write_errors_reported);
+    write_errors_reported = errors;
+    return pending;
+}
 
-    bool block_read = false;
-    bool block_write = false;
+// port_status - Status of PORT_CONTROL
+// During a read, READY tells that the next sector is in the ring, or that all of them were sent. During a write,
+// READY tells that the write buffer has room for the next sector.
+static inline uint8_t __not_in_flash_func(port_status)()
+{
+    if (writing)
+        return ((uint16_t)(write_head - write_tail) < IO_WRITE_SECTORS) ? IO_ST_READY : IO_ST_BUSY;
+    if (!reading)
+        return io_status;
+    uint16_t count = read_count;
+    uint16_t tail = ring_tail;
+    if (tail == count || ring_head != tail)
+        return IO_ST_READY;
+    return read_error ? (IO_ST_READY | IO_ST_ERROR) : IO_ST_BUSY;
+}
 
-    uint8_t ctrl_reg = 0;  // Last value written to port 0x9E (control)
-    uint8_t data_reg = 0;     // Last SPI response from port 0x9F (data)
+// legacy_status - PORT_CONTROL for the first driver: the reply bytes of 0x03-0x05, then 00h when the last command
+// succeeded and FFh when it failed or still runs. That driver waits fixed times instead of polling.
+static inline uint8_t __not_in_flash_func(legacy_status)()
+{
+    if (data_to_send > 0)
+    {
+        data_to_send--;
+        return data_buffer[data_byte_index++];
+    }
+    return (port_status() == IO_ST_READY) ? 0x00 : 0xFF;
+}
 
-    BYTE const pdrv = 0;  // Physical drive number
-    DSTATUS ds = 1; // Disk status (1 = not initialized)
+// address_phase - Receive the block address of a read or write next, then its sector count unless legacy
+static inline void __not_in_flash_func(address_phase)(uint8_t cmd)
+{
+    address_for = cmd;
+    ctrl_to_receive = 5;
+    if (legacy)
+    {
+        ctrl_to_receive = 4; // One sector, without the count byte
+        if (cmd == 0x06)
+            block_number = 1;
+        else
+            write_count = 1;
+    }
+}
 
-    while (true) {
-        
-        
-
-        bool iorq  = !gpio_get(PIN_IORQ);
-        bool sltsl = !gpio_get(PIN_SLTSL);
-
-        if ((iorq) && (!sltsl)){ 
-            uint32_t gpiostates = gpio_get_all();
-            uint8_t busdata = (gpiostates >> 16) & 0xFF;
-            uint8_t port = gpiostates & 0xFF;
-            
-            bool wr = !gpio_get(PIN_WR);
-            bool rd = !gpio_get(PIN_RD);
-            if (wr)
+// control_write - Write to port 0x9E: a command, or a byte of the block address of 0x06 and 0x08
+static void __not_in_flash_func(control_write)(uint8_t busdata)
+{
+    if (io_job)
+    {
+        if (io_job != 0x06)
+            return; // One command at a time, the driver polls the status before the next one
+        // The driver gave up the read (a timeout): end it here, so the byte is taken as its next command and the
+        // address bytes after it are not. The worker sees it and stops filling the ring.
+        reading = false;
+        io_job = 0;
+        io_status = IO_ST_READY | IO_ST_ERROR;
+    }
+
+    // this is to receive the address to read/write from/to the SD card from cmd_06 and cmd_08
+    // when called first time, next 4 writes will have the 32 bit address of the block to read/write and the fifth one
+    // the sector count
+    if (ctrl_to_receive > 0)
+    {
+        if ((ctrl_to_receive == 1) && !legacy && (address_for == 0x06))
+            block_number = busdata ? busdata : 256; // The last byte is the sector count, 0 for 256
+        else if ((ctrl_to_receive == 1) && !legacy)
+            write_count = busdata ? busdata : 256;
+        else
+            block_address = (block_address << 8) | busdata; // Shift left and add the new byte
+        ctrl_to_receive--;
+        if (ctrl_to_receive == 0)
+        {
+            block_read = (address_for == 0x06);
+            block_write = (address_for == 0x08);
+        }
+        return;
+    }
+
+    bool present = !(ds & STA_NOINIT);
+    switch (busdata)
+    {
+        // 0x01 = SD card initialization
+        case 0x01:
+            io_start(busdata);
+            break;
+
+        // 0x02 = SD card presence
+        case 0x02:
+            io_finish(present, 0);
+            break;
+
+        // 0x03 = SD card manufacturer ID, one byte on port 0x9F
+        case 0x03:
+            if (present)
+                data_buffer[0] = (uint8_t)ext_bits16(sd_get_by_num(0)->state.CID, 127, 120);
+            io_finish(present, 1);
+            break;
+
+        // 0x04 = SD card serial number, four bytes on port 0x9F (little-endian)
+        case 0x04:
+            if (present)
+            {
+                DWORD serial = ext_bits16(sd_get_by_num(0)->state.CID, 55, 24);
+                memcpy(data_buffer, &serial, 4);
+            }
+            io_finish(present, 4);
+            break;
+
+        // 0x05 = SD card capacity (number of blocks), four bytes on port 0x9F (little-endian)
+        case 0x05:
+            if (present)
+                io_start(busdata);
+            else
+                io_finish(false, 0);
+            break;
+
+        // 0x06 = Read SD card blocks with 512 bytes in size
+        // when called first time, next 4 writes will have the 32 bit address of the first block to read and the
+        // fifth one the number of blocks. The second 0x06 starts the read: every time the status is READY the next
+        // 512 reads of port 0x9F return the data of the next block, until all of them were read
+        case 0x06:
+            if (!present)
+                io_finish(false, 0);
+            else if (!block_read)
+                address_phase(busdata);
+            else
             {
-                // Write transaction: the MSX is writing to the port.
-
-                // Port 0x9E (Control Write): Set the control register.
-                if (port == 0x9E)
-                {
-                    // this is to receive the address to read/write from/to the SD card from cmd_06 and cmd_08
-                    // when called first time, next 4 writes will have the 32 bit address of the block to read/write
-                    if (ctrl_to_receive > 0) // here we need to receive the address to read/write from/to the SD card
-                    {
-                        // On the next calls, receive the address to read from the SD card
-                        // and set the data_to_send to 512 bytes (4096 bits)
-                        block_address = (block_address << 8) | busdata; // Shift left and add the new byte
-                        ctrl_to_receive--;
-                        if (ctrl_to_receive == 1) {
-                            block_number = busdata;
-                            printf("Number of blocks to read/write: %d\n", block_number);
-                        }
-                        if (ctrl_to_receive == 0) {
-                                //printf("MSX: SD card block address: %d\n", block_address);
-                                block_read = true;
-                                block_write = true;
-                        }
-                    }
-
-                    //printf("MSX Write 0x9E: Control=0x%02x\n", busdata);
-                    //printf("BUSDATA == 0x01: %d\n", busdata == 1);
-                    // 0x01 = SD card initialization
-                    if (busdata == 0x01) {
-                        if (ds & STA_NOINIT) {
-                            // Initialize the SD card if it hasn't been initialized yet
-                            ds = disk_initialize(pdrv);
-                            if (ds & STA_NOINIT) {
-                                //printf("Error: SD card initialization failed\n");
-                                ctrl_reg = 0xFF; // Set control register to error state
-                            }
-                            else {
-                                //printf("SD card initialized successfully\n");
-                                ctrl_reg = 0x00; // Set control register to success state
-                            }
-                        }
-                        else {
-                            //printf("SD card already initialized\n");
-                            ctrl_reg = 0x00; // Set control register to success state
-                        }
-                    }
-                    
-                    // 0x02 = SD card presence
-                    if (busdata == 0x02) {
-                        if (!(ds & STA_NOINIT)) {
-                            //printf("MSX: SD card is present\n");
-                            ctrl_reg = 0x00;
-                        }
-                        else {
-                            //printf("MSX: SD card is not present or not initialized\n");
-                            ctrl_reg = 0xFF; // Set control register to error state
-                        }
-                    }
-
-                    // 0x03 = SD card manufacturer ID 
-                    if (busdata == 0x03) {
-                        if (!(ds & STA_NOINIT)) {
-                            sd_card_t *sd_card = sd_get_by_num(0);
-                            ctrl_reg = (uint8_t)ext_bits16(sd_card->state.CID, 127, 120);
-                            //printf("MSX: SD card manufacturer ID: 0x%02X\n", ctrl_reg);
-                        }
-                        else {
-                           // printf("MSX: SD card is not present or not initialized\n");
-                            ctrl_reg = 0xFF; // Set control register to error state
-                        }
-                    }
-
-                    // 0x04 = SD card serial number
-                    if (busdata == 0x04) {
-                        if (!(ds & STA_NOINIT)) {
-                            if (data_to_send == 0) {
-                                // On the first call, query the SD card serial number and store on the data buffer
-                                // set the data_to_send to 4 bytes (32 bits)
-                                memset(data_buffer, 0, 32);
-                                sd_card_t *sd_card = sd_get_by_num(0);
-                                DWORD serial = ext_bits16(sd_card->state.CID, 55, 24);
-                                //printf("MSX: SD card serial number: %d\n", serial);
-                                memcpy(data_buffer, &serial, 4);
-                                data_to_send = 4;
-                                data_byte_index = 0;
-                            }
-
-                        }
-                        else {
-                            //printf("MSX: SD card is not present or not initialized\n");
-                            ctrl_reg = 0xFF; // Set control register to error state
-                        }
-                    }
-
-                    // 0x05 = SD card capacity (number of blocks), returned one byte per call (little-endian)
-                    if (busdata == 0x05) {
-                        // Use static variables to keep the state across calls.
-                        DWORD capacity = 0;
-
-                        if (!(ds & STA_NOINIT)) {
-                            if (data_to_send == 0) {
-                                memset(data_buffer, 0, 32);
-                                // On the first call, query the SD card capacity and store on the data buffer
-                                // set the data_to_send to 4 bytes (32 bits)
-                                DRESULT dr = disk_ioctl(pdrv, GET_SECTOR_COUNT, &capacity); // Get the capacity of the SD card
-                                //printf("MSX: SD card capacity: %d\n", capacity); 
-                                if (dr != RES_OK) {
-                                    // If there is an error, signal error and reset index.
-                                    ctrl_reg = 0xFF;
-                                    data_to_send = 0;
-                                    break;
-                                }
-                                else {
-                                    //printf("Sending 4 bytes of SD card capacity: %d\n", capacity);
-                                    data_to_send = 4;        // 4 bytes (32 bits)
-                                    data_byte_index = 0;     // Reset index
-                                    memcpy(data_buffer, &capacity, 4); // Copy capacity to data buffer
-                                    //for (int i = 0; i < 4; i++) {
-                                    //    printf("data_buffer[%d]: %d\n", i, data_buffer[i]);
-                                   // }
-                                }
-                            }
-
-                        }
-                        else {
-                            // SD card not present or not initialized
-                            ctrl_reg = 0xFF;
-                        }
-                    }
-
-                    // 0x06 = Read an specific SD card block with 512 bytes in size
-                    // when called first time, next 4 writes will have the 32 bit address of the block to read
-                    // then, the next 512 reads will return the data from the block
-                    if (busdata == 0x06) {
-                        if (!(ds & STA_NOINIT)) {
-                            if (!block_read) {
-                                // On the first call, set the ctrl_to_receive to 4 as we are expecting 4 bytes (32 bits)
-                                // for the address of the block to read from the SD card
-                                // set the data_to_send to 4 bytes (32 bits)
-                                ctrl_to_receive = 4;
-                            }
-                            else // here we need to read the data from the SD card to the buffer
-                            {
-                                // On the next call, read the data from the SD card to the buffer and set the data_to_send to 512 bytes (4096 bits)
-                                //memset(data_buffer, 0, 512); // Clear data buffer
-                                DRESULT dr = disk_read(pdrv, (BYTE*)data_buffer, block_address, 1); // Read one sector from the SD card
-                                if (dr != RES_OK) {
-                                    // If there is an error, signal error and reset index.
-                                    ctrl_reg = 0xFF;
-                                    data_to_send = 0;
-                                    break;
-                                }
-                                else {
-                                    data_to_send = 512; // Set data to send to 512 bytes (4096 bits)
-                                    data_byte_index = 0; // Reset index
-                                    block_read = false; // Reset block read flag
-
-                                    // debug print the data buffer
-                                    //printf("MSX: SD card block data for block %d:\n", block_address);
-                                    /*for (int i = 0; i < 512; i += 16) {
-                                        // Print the address (in hexadecimal, 4 digits)
-                                       printf("%04X: ", i);
-                                        // Print 16 bytes per line
-                                        for (int j = 0; j < 16; j++) {
-                                                printf("%02X ", data_buffer[i + j]);
-                                        }
-                                        printf("\n");
-                                    }*/
-
-                                }
-                            }
-                        }
-                        else {
-                            // SD card not present or not initialized
-                            ctrl_reg = 0xFF;
-                        }
-                        
-                    }
-
-                    // 0x07 = Read the next card block with 512 bytes in size
-                    // can only be executed after the 0x06 command
-                    if (busdata == 0x07) {
-                        if (!(ds & STA_NOINIT)) {
-                            //memset(data_buffer, 0, 512);
-                            block_address++;
-                            DRESULT dr = disk_read(pdrv, (BYTE*)data_buffer, block_address, 1); // Read one sector from the SD card
-                            if (dr != RES_OK) {
-                                // If there is an error, signal error and reset index.
-                                ctrl_reg = 0xFF;
-                                data_to_send = 0;
-                                break;
-                            }
-                            else {
-                                data_to_send = 512; // Set data to send to 512 bytes (4096 bits)
-                                data_byte_index = 0; // Reset index
-
-                                 // debug print the data buffer
-                                 //printf("MSX: SD card block data for block %d:\n", block_address);
-                                 //for (int i = 0; i < 512; i += 16) {
-                                     // Print the address (in hexadecimal, 4 digits)
-                                     //printf("%04X: ", i);
-                                     // Print 16 bytes per line
-                                     //for (int j = 0; j < 16; j++) {
-                                     //        printf("%02X ", data_buffer[i + j]);
-                                    // }
-                                    // printf("\n");
-                                // }
-                            }
-                        }
-                        else {
-                            // SD card not present or not initialized
-                            ctrl_reg = 0xFF;
-                        }
-                    }
-
-                    // 0x08 = Write a 512 byte block to the SD card
-                    if (busdata == 0x08) {
-                        if (!(ds & STA_NOINIT)) {
-                            if (!block_write) {
-                                // On the first call, set the ctrl_to_receive to 4 as we are expecting 4 bytes (32 bits)
-                                // for the address of the block to write to the SD card
-                                // set the data_to_send to 4 bytes (32 bits)
-                                //printf("First call, will collect the address to write to the SD card\n");
-                                ctrl_to_receive = 4;
-                            }
-                            else
-                            {
-                                //printf("Lets write the sector to the microSD card\n");
-                                //printf("Now you need to transfer the buffer using port 0x9f\n");
-                                block_write = true;
-                                data_to_receive = 512; // Set data to send to 512 bytes (4096 bits)
-                                data_byte_index = 0; // Reset index
-                            }
-
-                        }
-                        else {
-                            // SD card not present or not initialized
-                            ctrl_reg = 0xFF;
-                        }
-                    }
-                    
-                }
-                else if (port == 0x9F) // Port 0x9F (Data Write): Send the byte to the media
-                {
-                    if (!(ds & STA_NOINIT)) {
-                        //we are receiving an out on port 0x9f to receive data from the MSX and write to SD card
-                        if (data_to_receive > 0) {
-                            data_buffer[data_byte_index] = busdata; // Store the data in the buffer
-                            //printf("Index: %d, Data: 0x%02x\n", data_byte_index, busdata);
-                            data_byte_index++; // Increment the buffer index
-                            data_to_receive--; // Decrement the data to receive
-                        }
-
-                        // if we don't have any more data to receive, and the buffer is full, write the block to the SD card
-                        if ((data_to_receive == 0) && (block_write)) {
-                                printf("MSX: Writing block %d to SD card\n", block_address);
-                                /*printf("Data buffer to write to SD card:\n");
-                                for (int i = 0; i < 512; i += 16) {
-                                        // Print the address (in hexadecimal, 4 digits)
-                                       printf("%04X: ", i);
-                                        // Print 16 bytes per line
-                                        for (int j = 0; j < 16; j++) {
-                                                printf("%02X ", data_buffer[i + j]);
-                                        }
-                                        printf("\n");
-                                    }*/
-                                DRESULT dr = disk_write(pdrv, (BYTE*)data_buffer, block_address, 1); // Write one sector to the SD card
-                                if (dr != RES_OK) {
-                                    // If there is an error, signal error and reset index.
-                                    ctrl_reg = 0xFF;
-                                }
-                                block_write = false; // Reset block read flag
-                            }
-                        
-                        //printf("MSX Write 0x9F: Data Sent=0x%02x, Received=0x%02x\n", data_reg, spi_handle_data_register(data_reg, true));
-                        //printf("MSX Write 0x9F: Data Sent to microSD=0x%02x, Received=0x%02x\n", spi_tx, spi_rx);
-                    }
-
-                }
-                // Wait until the write strobe is released.
-                while (!gpio_get(PIN_WR)) tight_loop_contents();
+                block_read = false;
+                io_start_read();
+            }
+            break;
 
+        // 0x07 = Read the card block following the last 0x06 or 0x07 read
+        case 0x07:
+            if (present)
+            {
+                block_address += block_number;
+                block_number = 1;
+                io_start_read();
             }
-            else if (rd)
+            else
+                io_finish(false, 0);
+            break;
+
+        // 0x08 = Write SD card blocks with 512 bytes in size
+        // when called first time, next 4 writes will have the 32 bit address of the first block to write and the
+        // fifth one the number of blocks. The second 0x08 starts the write: every time the status is READY the next
+        // 512 bytes written to port 0x9F are the data of the next block. READY after the last one: the blocks are in
+        // the write buffer, ERROR if buffered blocks failed to be written to the card since the last report
+        case 0x08:
+            if (!present)
+                io_finish(false, 0);
+            else if (!block_write)
+                address_phase(busdata);
+            else
             {
-                // Read transaction: the MSX is reading from the port.
-                uint8_t out_val;
-
-                if (port == 0x9E)
-                {
-                    if (data_to_send > 0) {
-                        // Return the next byte of the capacity (little-endian order)
-                        out_val = data_buffer[data_byte_index];
-                        data_byte_index++;
-                        data_to_send--;
-                        //printf("MSX Read 0x9E: Control=0x%02x\n", out_val);
-                    }
-                    else {
-                        // No extra data to send, return just the control register value.
-                        out_val = ctrl_reg;
-                    }
-                    //printf("MSX Read 0x9E: Control=0x%02x\n", out_val);
-                }
-                else if (port == 0x9F)
-                {
-                    if (data_to_send > 0) {
-                        // Return the next byte of the data buffer
-                        out_val = data_buffer[data_byte_index];
-                        data_byte_index++;
-                        data_to_send--;
-                    }
-                    else {
-                        // No extra data to send, return just the last SPI response.
-                        out_val = data_reg;
-                    }
-                }
-
-                if ((port == 0x9E) || (port == 0x9F))
-                {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    gpio_put_masked(0xFF0000, out_val << 16); // Write the data to the data bus
-                    while (!gpio_get(PIN_RD)) tight_loop_contents();
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after cycle completes
-
-                }
+                block_write = false;
+                data_to_send = 0;
+                write_lba = block_address;
+                write_left = write_count;
+                write_index = 0;
+                write_lost = false;
+                writing = true;
+            }
+            break;
+
+        // 0x09 = Read statistics since power on, twelve bytes on port 0x9F (little-endian):
+        // sectors found in the cache, sectors read from the card, sectors found read ahead
+        case 0x09:
+            memcpy(data_buffer, &io_totals, sizeof(io_totals));
+            io_finish(true, sizeof(io_totals));
+            break;
+
+        // 0x0A = Flush: write the buffered blocks to the card. READY once the card has them, ERROR if buffered
+        // blocks failed to be written since the last report
+        case 0x0A:
+            if (present)
+                io_start(busdata);
+            else
+                io_finish(false, 0);
+            break;
+
+        // 0x0B = Select the protocol of io.h, sent first by the driver of nextor_c/src. Until then the interface
+        // answers as the first driver expects it, the one of nextor_c/dist/nextor.rom
+        case 0x0B:
+            legacy = false;
+            io_finish(true, 0);
+            break;
+
+        default:
+            break;
+    }
+}
 
+// data_write - Write to port 0x9F: the next byte of a block to write, stored in the write buffer
+static void __not_in_flash_func(data_write)(uint8_t busdata)
+{
+    if (!writing)
+        return;
+    uint16_t head = write_head;
+    if ((uint16_t)(head - write_tail) == IO_WRITE_SECTORS)
+    {
+        write_lost = true; // Sent while BUSY, the byte is dropped and the write reported as failed
+        return;
+    }
+    uint16_t slot = head % IO_WRITE_SECTORS;
+    wbuf[slot][write_index++] = busdata;
+    if (write_index < 512)
+        return;
+
+    write_index = 0;
+    wbuf_lba[slot] = write_lba++;
+    write_time = time_us_32();
+    __compiler_memory_barrier(); // The sector is in the buffer before the worker sees it
+    write_head = head + 1; // Publish the sector to the worker
+    if (--write_left == 0)
+        io_finish(!write_lost && !write_errors_pending(), 0); // Acknowledged, the worker writes it to the card later
+}
+
+// io_port_irq_handler - Serve the I/O ports on every I/O cycle of the MSX (/IORQ falling edge, core 1)
+// The handler preempts the worker loop, so the status is answered while an SD card operation runs. Commands that
+// access the card only set BUSY and leave the operation to io_worker.
+static void __not_in_flash_func(io_port_irq_handler)()
+{
+    gpio_acknowledge_irq(PIN_IORQ, GPIO_IRQ_EDGE_FALL);
+
+    uint32_t gpiostates = bus_sample();
+    while (bus_active(gpiostates, BUS_IORQ_MASK) && (gpiostates & BUS_RD_MASK) && (gpiostates & BUS_WR_MASK))
+        gpiostates = bus_sample(); // The strobe follows /IORQ, none comes for an interrupt acknowledge
+    if (!bus_active(gpiostates, BUS_IORQ_MASK) || bus_active(gpiostates, BUS_SLTSL_MASK))
+        return;
+
+    uint8_t port = bus_addr(gpiostates) & 0xFF;
+    if (bus_active(gpiostates, BUS_WR_MASK))
+    {
+        // Write transaction: the MSX is writing to the port.
+        uint8_t busdata = bus_data(gpiostates);
+        if (port == PORT_CONTROL)
+            control_write(busdata);
+        else if (port == PORT_DATAREG) // Port 0x9F (Data Write): Send the byte to the media
+            data_write(busdata);
+        else if (port == CAS_PORT_STATUS) // CAS image command (see cas.h)
+        {
+            cas_t *cas = cas_active;
+            if (cas)
+                cas_command(cas, busdata);
+        }
+        // Wait until the write strobe is released.
+        while (!(bus_sample() & BUS_WR_MASK)) tight_loop_contents();
+        return;
+    }
+
+    // Read transaction: the MSX is reading from the port.
+    uint8_t out_val;
+    if (port == PORT_CONTROL)
+        out_val = legacy ? legacy_status() : port_status();
+    else if (port == PORT_DATAREG)
+    {
+        if (data_to_send > 0) {
+            // Return the next byte of the data buffer
+            out_val = data_buffer[data_byte_index++];
+            data_to_send--;
+        }
+        else if (reading && (ring_tail != read_count) && (ring_tail != ring_head)) {
+            // Next byte of a read, the ring slot is freed for the worker after its last byte
+            out_val = ring[ring_tail % IO_RING_SECTORS][ring_index];
+            if (++ring_index == 512) {
+                ring_index = 0;
+                ring_tail++;
             }
         }
-        tight_loop_contents();
+        else {
+            // No extra data to send, return just the last SPI response.
+            out_val = data_reg;
+        }
+    }
+    else if ((port == CAS_PORT_STATUS) || (port == CAS_PORT_DATA))
+    {
+        cas_t *cas = cas_active;
+        out_val = cas ? cas_read(cas, port) : 0x00; // Status 0x00: no CAS image, the loader boots normally
+    }
+    else
+        return;
+
+    pio_sm_put(pio, sm1, out_val); // The output state machine drives the data bus until /RD goes high
+    while (!(bus_sample() & BUS_RD_MASK)) tight_loop_contents();
+}
+
+// cache_find - Entry holding the sector lba, or -1
+static int cache_find(uint32_t lba)
+{
+    for (int i = 0; i < IO_CACHE_SECTORS; i++)
+        if (cache_used[i] && cache_lba[i] == lba)
+            return i;
+    return -1;
+}
+
+// cache_put - Keep a copy of the sector lba, in its entry or in the least recently used one
+static void cache_put(uint32_t lba, const uint8_t *data)
+{
+    int entry = cache_find(lba);
+    if (entry < 0)
+    {
+        entry = 0;
+        for (int i = 1; i < IO_CACHE_SECTORS && cache_used[entry]; i++)
+            if (cache_used[i] < cache_used[entry])
+                entry = i;
     }
+    memcpy(cache[entry], data, 512);
+    cache_lba[entry] = lba;
+    cache_used[entry] = ++cache_clock;
 }
 
+// cache_clear - Forget all the sectors, the card may have been changed
+static void cache_clear()
+{
+    memset(cache_used, 0, sizeof(cache_used));
+    cache_clock = 0;
+}
+
+// io_latency - Account the time from the read command to its first sector ready
+static void io_latency()
+{
+    uint32_t us = time_us_32() - read_time;
+    io_stats.latency_us += us;
+    if (us > io_stats.latency_max)
+        io_stats.latency_max = us;
+    latency_pending = false;
+}
+
+// io_read_begin - Set up the ring for the read of block_number sectors at block_address
+// When the first sector was read ahead, the sectors before it are dropped and the read starts on the ones in the
+// ring. The counters are moved back by whole rings so they stay small and every sector keeps its slot.
+static void io_read_begin()
+{
+    uint32_t seq = read_seq;
+    active_seq = seq;
+    uint32_t lba = block_address;
+    uint16_t count = block_number;
+    uint16_t tail = ring_tail;
+    uint16_t head = ring_head;
+    uint32_t offset = lba - ring_lba;
+
+    io_stats.last = time_us_32(); // A read served from the ring or the cache also keeps the burst going
+    if (io_stats.commands == 0)
+        io_stats.start = io_stats.last;
+    io_stats.commands++;
+    io_stats.requested += count;
+    if (ring_valid && offset >= tail && offset < head)
+    {
+        uint16_t hits = (head - offset < count) ? head - offset : count;
+        io_stats.dropped += offset - tail;
+        io_stats.hits += hits;
+        io_totals.ahead_hits += hits;
+        uint16_t shift = offset & ~(IO_RING_SECTORS - 1);
+        ring_lba += shift;
+        tail = offset - shift;
+        head -= shift;
+    }
+    else
+    {
+        if (ring_valid)
+            io_stats.dropped += head - tail;
+        ring_lba = lba;
+        tail = 0;
+        head = 0;
+    }
+
+    ring_valid = true;
+    sequential = (lba == next_lba);
+    next_lba = lba + count;
+    ring_tail = tail;
+    ring_head = head;
+    ring_index = 0;
+    read_error = false;
+    read_count = tail + count;
+    latency_pending = true;
+    if (head != tail)
+        io_latency();
+
+    uint32_t irq = save_and_disable_interrupts();
+    if (io_job == 0x06 && read_seq == seq)
+        reading = true; // Last: from here the port interrupt sends the sectors, unless the driver gave up already
+    restore_interrupts(irq);
+}
+
+// io_fetch - Read the next sectors after ring_head into the free slots of the ring, at most want of them
+// Up to IO_READ_CHUNK sectors are read at once, a multi-block transfer (CMD18) when there is more than one, so the
+// MSX drains a part of the ring while the card fills the other. Returns the sectors read, 0 while the ring has no
+// room for them, or -1 when the card failed.
+static int io_fetch(uint16_t want)
+{
+    uint16_t head = ring_head;
+    uint16_t free = IO_RING_SECTORS - (uint16_t)(head - ring_tail);
+    uint16_t slot = head % IO_RING_SECTORS;
+    uint16_t n = (want < IO_READ_CHUNK) ? want : IO_READ_CHUNK;
+    if (n == 0 || n > free)
+        return 0; // Wait for room for the whole transfer, the MSX is reading the ring
+    if (n > IO_RING_SECTORS - slot)
+        n = IO_RING_SECTORS - slot; // No wrap inside a transfer
+
+    uint32_t start = time_us_32();
+    bool ok = (disk_read(pdrv, (BYTE*)ring[slot], ring_lba + head, n) == RES_OK); // Read n sectors from the SD card
+    io_stats.last = time_us_32();
+    io_stats.sd_us += io_stats.last - start;
+    if (!ok)
+        return -1;
+    io_stats.sectors += n;
+    ring_head = head + n; // Publish the sectors to the port interrupt
+    return n;
+}
+
+// io_read_step - Fetch the next sectors of the read in progress. Returns true when the read is complete.
+static bool io_read_step()
+{
+    if (!reading || read_seq != active_seq)
+        return true; // Given up by the driver
+
+    uint16_t head = ring_head;
+    int16_t left = (int16_t)(read_count - head);
+    if (left <= 0)
+        return true; // All of it was read ahead
+    bool small = (block_number <= IO_CACHE_MAX_READ);
+    int got;
+    int entry = small ? cache_find(ring_lba + head) : -1;
+    if (entry >= 0)
+    {
+        if ((uint16_t)(head - ring_tail) == IO_RING_SECTORS)
+            return false; // No free slot yet
+        memcpy(ring[head % IO_RING_SECTORS], cache[entry], 512);
+        cache_used[entry] = ++cache_clock;
+        ring_head = head + 1;
+        io_totals.hits++;
+        sequential = false; // FAT or directory sectors, not a file being read through
+        got = 1;
+    }
+    else
+    {
+        got = io_fetch(left);
+        if (got < 0)
+        {
+            read_error = true;
+            sequential = false;
+            return true;
+        }
+        io_totals.misses += got;
+        for (int i = 0; small && i < got; i++)
+            cache_put(ring_lba + head + i, ring[(head + i) % IO_RING_SECTORS]);
+    }
+    if (got > 0 && latency_pending)
+        io_latency();
+    return got == left;
+}
+
+// io_read_ahead - Go on reading after a sequential read while no command is waiting, up to IO_AHEAD_SECTORS
+// sectors past it. One transfer at a time, so a new command waits at most for one of them.
+static void io_read_ahead()
+{
+    if (!ring_valid || !sequential)
+        return;
+    int16_t ahead = (int16_t)(ring_head - read_count);
+    if (ahead < 0 || ahead >= IO_AHEAD_SECTORS)
+        return;
+    int got = io_fetch(IO_AHEAD_SECTORS - ahead);
+    if (got < 0)
+        sequential = false; // Past the end of the card, or a card error the next read reports
+    else
+        io_stats.ahead += got;
+}
+
+// io_flush_run - Write the oldest run of consecutive buffered sectors to the card, up to IO_WRITE_CHUNK of them
+// A run of more than one sector is a multi-block transfer (CMD25). The cached copies of the sectors are updated
+// (write-through) and the ring is dropped, it may hold their old data.
+static void io_flush_run()
+{
+    uint16_t tail = write_tail;
+    uint16_t pending = write_head - tail;
+    if (pending == 0)
+        return;
+    uint16_t slot = tail % IO_WRITE_SECTORS;
+    uint32_t lba = wbuf_lba[slot];
+    uint16_t n = 1;
+    while (n < pending && n < IO_WRITE_CHUNK && slot + n < IO_WRITE_SECTORS && wbuf_lba[slot + n] == lba + n)
+        n++;
+
+    uint32_t start = time_us_32();
+    bool ok = (disk_write(pdrv, (BYTE*)wbuf[slot], lba, n) == RES_OK); // Write n sectors to the SD card
+    io_stats.last = time_us_32();
+    io_stats.write_us += io_stats.last - start;
+    io_stats.write_cmds++;
+    if (ok)
+        io_stats.written += n;
+    else
+        write_errors += n;
+
+    ring_valid = false;
+    for (uint16_t i = 0; i < n; i++)
+    {
+        int entry = cache_find(lba + i);
+        if (entry < 0)
+            continue;
+        if (ok)
+            memcpy(cache[entry], wbuf[slot + i], 512); // Write-through: the cache keeps the new data
+        else
+            cache_used[entry] = 0; // Unknown content on the card
+    }
+    write_tail = tail + n; // Frees the slots for the port interrupt
+}
+
+// io_flush - Write all the buffered sectors to the card
+static void io_flush()
+{
+    while (write_head != write_tail)
+        io_flush_run();
+}
+
+// io_worker - Run the command left by the port interrupt, the only place the SD card is accessed
+static void io_worker()
+{
+    uint8_t cmd = io_job;
+    if (!cmd)
+    {
+        uint16_t pending = write_head - write_tail;
+        if (pending >= IO_WRITE_CHUNK || (pending && (time_us_32() - write_time) >= IO_FLUSH_IDLE_US))
+            io_flush_run(); // Buffer pressure, or the MSX stopped writing
+        else if (!pending)
+            io_read_ahead();
+        return;
+    }
+
+    if (cmd == 0x06)
+    {
+        if (read_seq != active_seq)
+        {
+            io_flush(); // The card has the sectors written before the read
+            io_read_begin();
+        }
+        if (io_read_step())
+        {
+            uint32_t irq = save_and_disable_interrupts();
+            if (io_job == 0x06 && read_seq == active_seq)
+                io_job = 0; // The status of a read comes from the ring, see port_status
+            restore_interrupts(irq); // A command may have ended the read and started another job meanwhile
+        }
+        return;
+    }
+
+    bool ok = false;
+    uint16_t reply = 0;
+    switch (cmd)
+    {
+        case 0x01:
+            if (!(ds & STA_NOINIT))
+                io_flush(); // Sectors written before the MSX was reset
+            ring_valid = false; // Maybe another card
+            cache_clear();
+            if (ds & STA_NOINIT)
+                ds = disk_initialize(pdrv); // Initialize the SD card if it hasn't been initialized yet
+            ok = !(ds & STA_NOINIT);
+            break;
+
+        case 0x05:
+        {
+            DWORD capacity = 0;
+            ok = (disk_ioctl(pdrv, GET_SECTOR_COUNT, &capacity) == RES_OK); // Get the capacity of the SD card
+            memcpy(data_buffer, &capacity, 4);
+            reply = 4;
+            break;
+        }
+
+        case 0x0A:
+            io_flush();
+            ok = (disk_ioctl(pdrv, CTRL_SYNC, NULL) == RES_OK); // Wait for the card to finish programming
+            ok = !write_errors_pending() && ok;
+            break;
+    }
+
+    io_job = 0;
+    io_finish(ok, reply); // Last: from here the port interrupt accepts the next command
+}
+
+// io_report - Print the throughput of the last read and write burst over USB, once no read came for IO_REPORT_GAP_US
+// The time runs from the first read to the last sector ready, so it includes the transfers of the driver in between.
+// The hit rate is the part of the requested sectors that were in the ring when their command came.
+static void io_report()
+{
+    if ((io_stats.commands == 0 && io_stats.write_cmds == 0) || (time_us_32() - io_stats.last) < IO_REPORT_GAP_US)
+        return;
+
+    if (io_stats.write_cmds)
+        printf("SD: %lu sectors written by %lu card writes, %lu us in the card, %lu failed in total\n",
+               (unsigned long)io_stats.written, (unsigned long)io_stats.write_cmds, (unsigned long)io_stats.write_us,
+               (unsigned long)write_errors);
+    if (io_stats.commands == 0)
+    {
+        memset(&io_stats, 0, sizeof(io_stats));
+        return;
+    }
+
+    uint32_t elapsed = io_stats.last - io_stats.start;
+    printf("SD: %lu sectors read in %lu us by %lu commands, %lu KB/s, %lu us in the card\n",
+           (unsigned long)io_stats.sectors, (unsigned long)elapsed, (unsigned long)io_stats.commands,
+           (unsigned long)(elapsed ? (uint64_t)io_stats.sectors * 500000 / elapsed : 0), (unsigned long)io_stats.sd_us);
+    printf("SD: cache %lu hits %lu misses since power on\n",
+           (unsigned long)io_totals.hits, (unsigned long)io_totals.misses);
+    printf("SD: read-ahead %lu sectors, %lu of %lu requested hit (%lu%%), %lu dropped, latency %lu us avg %lu us max\n",
+           (unsigned long)io_stats.ahead, (unsigned long)io_stats.hits, (unsigned long)io_stats.requested,
+           (unsigned long)(io_stats.requested ? (uint64_t)io_stats.hits * 100 / io_stats.requested : 0),
+           (unsigned long)io_stats.dropped, (unsigned long)(io_stats.latency_us / io_stats.commands),
+           (unsigned long)io_stats.latency_max);
+    memset(&io_stats, 0, sizeof(io_stats));
+}
+
+#if LOW_POWER_MAPPER
+// io_idle - Tell whether the loop of io_main has nothing to do until something wakes it up
+// A command, buffered sectors, a read-ahead in progress or a track wanted by the disk controller keep it running.
+// Everything else is either started by the /IORQ interrupt or by core 0, which sends an event when it hands work
+// over (fdc.c, save.c), or only needs a check now and then, done on each period of the swap timer.
+static bool io_idle()
+{
+    if (io_job || write_head != write_tail)
+        return false;
+    int16_t ahead = (int16_t)(ring_head - read_count);
+    if (ring_valid && sequential && ahead >= 0 && ahead < IO_AHEAD_SECTORS)
+        return false;
+    fdc_t *fdc = fdc_active;
+    return !fdc || fdc->load < 0;
+}
+#endif
+
+void __not_in_flash_func(io_main)(){
+
+    // The ports are served from the /IORQ interrupt of this core, above the loop below
+    gpio_set_irq_enabled(PIN_IORQ, GPIO_IRQ_EDGE_FALL, true);
+    irq_set_exclusive_handler(IO_IRQ_BANK0, io_port_irq_handler);
+    irq_set_priority(IO_IRQ_BANK0, PICO_HIGHEST_IRQ_PRIORITY);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+
+#if LOW_POWER_MAPPER
+    // The loop sleeps whenever io_idle. The timer of swap_timer_start runs on this core, so the reset check and the
+    // reports below still run once per SWAP_IDLE_US.
+    swap_timer_start();
+    scb_hw->scr |= M33_SCR_SEVONPEND_BITS; // An interrupt raised between io_idle and WFE still ends the sleep
+#endif
+
+    while (true) {
+
+        segcache_report(); // Segment cache counters over USB, at most once per second and only when they changed
+        swap_poll(); // Leave the running ROM when the MSX is reset
+        expander_report(); // Slot expander read loop timing, only when the benchmark is built in
+        save_poll(); // Write-behind of the save RAM to the flash journal
+        fdc_t *fdc = fdc_active;
+        if (fdc)
+            fdc_service(fdc); // Track copies of the floppy disk controller emulation (see fdc.h)
+        cas_report(); // Load time of the last CAS tape read
+        io_worker(); // SD card command of the Nextor driver
+        io_report(); // Read and write throughput of the Nextor driver
+
+#if LOW_POWER_MAPPER
+        lowpower_report(); // Sleep ratio and late reads of the low power loops
+        if (io_idle())
+            lowpower_sleep(1);
+#else
+        tight_loop_contents();
+#endif
+    }
+}
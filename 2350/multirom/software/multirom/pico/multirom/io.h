@@ -1,7 +1,66 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// io.h - Nextor SD card interface of the MSX PICOVERSE multirom firmware
+//
+// Port protocol of the Nextor driver (nextor_c/src/hal.c):
+// A command is written to PORT_CONTROL. Commands that access the card run on the worker loop of core 1 while the
+// ports are served from the /IORQ interrupt, so the driver polls the status on PORT_CONTROL until BUSY clears
+// instead of waiting a fixed time. Replies and sector data are read from PORT_DATAREG once the status is READY
+// (for a multi-sector read, once per sector: the card fills a ring of sector buffers while the MSX drains it),
+// the data of the sectors of a write is sent to PORT_DATAREG, each one once the status is READY. Commands
+// written while BUSY are ignored, except during a read: a driver that gives up a read writes its next command,
+// which ends the read with ERROR and is then run. After a read that follows the previous one, the worker reads the next
+// IO_AHEAD_SECTORS sectors into the ring while idle, and a read starting on them is READY at once. The sectors of
+// reads of up to IO_CACHE_MAX_READ sectors (the FAT and directory sectors MSX-DOS reads again and again) are also
+// kept in an LRU cache of IO_CACHE_SECTORS sectors, updated by the writes. Command 0x09 returns its counters,
+// which the driver prints when it starts.
+//
+// Writes are buffered: the status is READY as soon as a sector is in the IO_WRITE_SECTORS sector write buffer, and
+// BUSY only while the buffer is full. Durability: a write acknowledged with READY is in the SRAM of the pico, not
+// yet on the card. The buffered sectors are written, in multi-block transfers of consecutive sectors,
+//   - once IO_WRITE_CHUNK of them are waiting, or when no sector came for IO_FLUSH_IDLE_US
+//   - before any read that goes to the card, so the card never returns older data than the one written
+//   - before a card initialization (0x01), so the sectors written before an MSX reset are kept
+//   - on the flush command (0x0A), READY only once the card has all of them
+// The driver sends the flush at the end of every write request, so the sectors of a request are written with as
+// few multi-block transfers as the buffer allows while the MSX is still sending them, and DOS is told the write
+// is done, or gets the error of a sector the card failed to write, only once the card has them. A failure is
+// reported as ERROR by the next write or flush command. Without the flush (the first driver), sectors still in
+// the buffer are lost if the power goes off.
+//
+// The driver selects this protocol with command 0x0B when it starts. Until then the interface speaks the one of the
+// first driver, still in nextor_c/dist/nextor.rom, so a firmware update keeps working with it: replies of
+// 0x03-0x05 are read from PORT_CONTROL, which otherwise reads 00h (done) or FFh (failed or still running), and 0x06
+// and 0x08 take a 4 byte block address without a count, for one sector.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef IO_H
+#define IO_H
+
+#include <stdint.h>
 
 #define PORT_CONTROL   0x9E //PORTCFG 
 #define PORT_DATAREG   0x9F //PORTSPI
 
+// Status bits read from PORT_CONTROL
+#define IO_ST_BUSY     0x80 // The last command runs on the worker, the other bits are not valid yet
+#define IO_ST_READY    0x40 // The last command is done, its reply if any can be read from PORT_DATAREG
+#define IO_ST_ERROR    0x01 // The last command failed
+
+#define IO_RING_SECTORS  32     // Sector buffers of the reads, a power of two
+#define IO_AHEAD_SECTORS 16     // Sectors read ahead after a sequential read, while the MSX is busy with the last one
+#define IO_READ_CHUNK    8      // Most sectors fetched by one multi-block transfer
+#define IO_CACHE_SECTORS 64     // Sectors of the LRU cache, 32KB of SRAM
+#define IO_CACHE_MAX_READ 2     // Reads of more sectors are file data, they would push the FAT out of the cache
+#define IO_WRITE_SECTORS 32     // Sectors of the write buffer, 16KB of SRAM
+#define IO_WRITE_CHUNK   16     // Most sectors written by one multi-block transfer, and the buffer pressure level
+#define IO_FLUSH_IDLE_US 20000  // The buffered sectors are written after this time without a new one
+#define IO_REPORT_GAP_US 500000 // A read burst ends after this time without a sector read, its throughput is printed
+
 #define SPI_CS     33
 #define SPI_SCK    34
 #define SPI_MOSI   35
@@ -11,3 +70,5 @@
 void spi_initialize();
 uint8_t spi_handle_control_register();
 void io_main();
+
+#endif
@@ -17,8 +17,29 @@
 #include "pico/stdlib.h"
 #include "pico/multicore.h"
 #include "hardware/clocks.h"
+#include "hardware/pio.h"
+#include "hardware/dma.h"
+#include "hardware/irq.h"
+#include "hardware/sync.h"
 #include "hardware/structs/qmi.h"
+#include "hardware/structs/scb.h"
+#include "hardware/structs/systick.h"
 #include "multirom.h"
+#include "mapper.h"
+#include "segcache.h"
+#include "flashcal.h"
+#include "busclock.h"
+#include "swap.h"
+#include "plainwin.h"
+#include "expander.h"
+#include "save.h"
+#include "fdc.h"
+#include "cas.h"
+#include "lowpower.h"
+
+#include "msx_capture_addr.pio.h"
+#include "msx_output_data.pio.h"
+#include "msx_capture_write.pio.h"
 #include "io.h"
 
 // config area and buffer for the ROM data
@@ -27,6 +48,13 @@
 #define MAX_ROM_RECORDS 256     // Maximum ROM files supported 2^8=256
 #define ROM_NAME_MAX    20         // Maximum size of the ROM name
 
+// mapper loop build options
+#define SLOT_EXPANDER    0      // 1: serve the selected ROM as a subslot next to the Nextor ROM of the catalog (see expander.h), off until measured (see loadrom_expander)
+#define EXPANDER_WITH_RAM 1     // 1: add a 64KB RAM subslot in slot expander mode
+#define EXPANDER_BENCHMARK SLOT_EXPANDER // 1: measure the slot expander read loop against the /RD timing and report it over USB, on with the expander until it is measured
+#define DISK_ROM_NAME    "disk"  // Catalog entry of the WD2793 disk ROM that boots the DSK images (disk.rom for the multirom tool)
+#define CAS_LOADER_NAME  "casload" // Catalog entry of the CAS loader ROM (msx/src/casload.asm, casload.rom for the multirom tool)
+
 // This symbol marks the end of the main program in flash.
 // Custom data starts right after it
 extern unsigned char __flash_binary_end;
@@ -48,6 +76,35 @@ typedef struct {
 } ROMRecord;
 
 ROMRecord records[MAX_ROM_RECORDS]; // Array to store the ROM records
+static int record_count = 0; // Number of ROM records, the catalog is parsed once and kept for hot swaps
+
+// 64KB aligned copy of the MSX address space used by the PIO/DMA read path of plain ROMs
+static uint8_t rom_window[0x10000] __attribute__((aligned(0x10000)));
+
+PIO pio = pio0;
+uint sm0 = 0;  // State machine 0: address capture (using GPIO 0–15)
+uint sm1 = 1;  // State machine 1: data output (driving GPIO 16–23)
+uint sm2 = 2;  // State machine 2: write capture (bank register writes)
+int dma_addr_chan; // DMA channel moving captured addresses into the data channel
+int dma_data_chan; // DMA channel moving ROM bytes into the data output state machine
+
+static mapper_t mapper; // Mapper state, read by the bus loop and updated by the write capture interrupt
+
+#if SLOT_EXPANDER
+static mapper_t nextor_mapper; // Nextor subslot of the slot expander, the game subslot uses mapper
+static expander_t expander;    // Slot expander state, read by the bus loop and updated by the write capture interrupt
+#endif
+
+static cas_t cas; // CAS image, its BIOS page 0 copy is written by the write capture interrupt
+static fdc_t fdc; // Floppy disk controller of the DSK images, read by the bus loop and written by the write capture interrupt
+
+#if EXPANDER_BENCHMARK
+#define BENCH_STAMP()           (systick_hw->cvr)
+#define BENCH_MAX(max, start)   do { uint32_t t = ((start) - systick_hw->cvr) & 0x00FFFFFF; if (t > (max)) (max) = t; } while (0)
+#else
+#define BENCH_STAMP()           0
+#define BENCH_MAX(max, start)
+#endif
 
 // Initialize GPIO pins
 static inline void setup_gpio()
@@ -98,6 +155,84 @@ int __no_inline_not_in_flash_func(isEndOfData)(const unsigned char *memory) {
     return 1;
 }
 
+// serve_read - Put a byte on the data bus for the current read cycle
+// The output state machine drives the queued byte while /RD is low and releases the data bus when /RD goes high,
+// so the loop only waits for the end of the cycle to avoid serving it twice.
+static inline void __not_in_flash_func(serve_read)(uint8_t data)
+{
+    pio_sm_put(pio, sm1, data); // Queue the byte for the output state machine
+    while (!(bus_sample() & BUS_RD_MASK)) // Wait until the read cycle completes (RD goes high)
+    {
+        tight_loop_contents();
+    }
+}
+
+// wait_rx_fifo - Sleep until a state machine pushes a word to its RX FIFO
+// The PIO interrupt line is not enabled in the NVIC. With SEVONPEND set its pending flag only wakes WFE, so the
+// core sleeps between bus cycles without taking an interrupt. The flag is cleared before sleeping and set again
+// right away by the hardware if a word arrived in between, so no wake up is lost. A swap request (see swap.h)
+// sends an event too and ends the wait with the FIFO still empty.
+static inline void __not_in_flash_func(wait_rx_fifo)(uint sm, uint irq_num)
+{
+    while (pio_sm_is_rx_fifo_empty(pio, sm) && !swap_pending)
+    {
+        irq_clear(irq_num);
+        if (pio_sm_is_rx_fifo_empty(pio, sm))
+            lowpower_sleep(0);
+    }
+}
+
+#if LOW_POWER_MAPPER
+static volatile int menu_selected; // Catalog index written by the menu, -1 until then
+
+// menu_write_irq_handler - Catch the catalog index the menu writes to MONITOR_ADDR
+static void __not_in_flash_func(menu_write_irq_handler)()
+{
+    while (!pio_sm_is_rx_fifo_empty(pio, sm2))
+    {
+        uint32_t bus = pio_sm_get(pio, sm2); // (data << 16) | addr
+        if ((bus & 0xFFFF) == MONITOR_ADDR)
+            menu_selected = (bus >> 16) & 0xFF;
+    }
+}
+
+// menu_sleep - Serve the menu until a ROM is selected, sleeping in WFE between the bus cycles
+// The address capture state machine pushes the read cycles of this slot and wakes the core, as in the low power
+// loop of loadrom_mapper; the selection comes from the write capture interrupt. Returns the catalog index. The menu
+// runs on until it jumps to the selected ROM through address 0, which is not in this slot, so the caller polls the
+// bus from there.
+static uint8_t __not_in_flash_func(menu_sleep)(const uint8_t *menu)
+{
+    menu_selected = -1;
+    setup_pio_capture_write(menu_write_irq_handler);
+    setup_pio_capture_addr(NULL); // No window, the pushed word is the bare address
+    pio_set_irq0_source_enabled(pio, pis_sm0_rx_fifo_not_empty, true); // Wake up event only
+    scb_hw->scr |= M33_SCR_SEVONPEND_BITS; // Pending interrupts wake WFE
+
+    while (menu_selected < 0)
+    {
+        irq_clear(PIO0_IRQ_0); // See wait_rx_fifo
+        if (pio_sm_is_rx_fifo_empty(pio, sm0) && menu_selected < 0)
+            lowpower_sleep(0);
+
+        while (!pio_sm_is_rx_fifo_empty(pio, sm0))
+        {
+            uint16_t addr = (uint16_t)pio_sm_get(pio, sm0);
+            if (addr >= 0x4000 && addr <= 0xBFFF) // Check if the address is within the ROM range
+            {
+                pio_sm_put(pio, sm1, menu[addr - 0x4000]); // Driven until /RD goes high
+                lowpower_served();
+            }
+        }
+    }
+
+    pio_set_irq0_source_enabled(pio, pis_sm0_rx_fifo_not_empty, false);
+    pio_sm_set_enabled(pio, sm0, false);
+    stop_pio_capture_write();
+    return menu_selected;
+}
+#endif
+
 //load the MSX Menu ROM into the MSX
 int __no_inline_not_in_flash_func(loadrom_msx_menu)(uint32_t offset)
 {
@@ -111,45 +246,52 @@ int __no_inline_not_in_flash_func(loadrom_msx_menu)(uint32_t offset)
     memcpy(rom_sram, rom + offset, 32768); //for 32KB ROMs we start at 0x4000
     gpio_put(PIN_WAIT, 1); // Lets go!
 
-    int record_count = 0; // Record count
-    const uint8_t *record_ptr = rom + offset + 0x4000; // Pointer to the ROM records
-    for (int i = 0; i < MAX_ROM_RECORDS; i++)      // Read the ROMs from the configuration area
+    if (record_count == 0) // Parsed once, the catalog is kept when coming back from a ROM
     {
-        if (isEndOfData(record_ptr)) {
-            break; // Stop if end of data is reached
+        const uint8_t *record_ptr = rom + offset + 0x4000; // Pointer to the ROM records
+        for (int i = 0; i < MAX_ROM_RECORDS; i++)      // Read the ROMs from the configuration area
+        {
+            if (isEndOfData(record_ptr)) {
+                break; // Stop if end of data is reached
+            }
+            memcpy(records[record_count].Name, record_ptr, ROM_NAME_MAX); // Copy the ROM name
+            record_ptr += ROM_NAME_MAX; // Move the pointer to the next field
+            records[record_count].Mapper = *record_ptr++; // Read the mapper code
+            records[record_count].Size = read_ulong(record_ptr); // Read the ROM size
+            record_ptr += sizeof(unsigned long); // Move the pointer to the next field
+            records[record_count].Offset = read_ulong(record_ptr); // Read the ROM offset
+            record_ptr += sizeof(unsigned long); // Move the pointer to the next record
+            record_count++; // Increment the record count
         }
-        memcpy(records[record_count].Name, record_ptr, ROM_NAME_MAX); // Copy the ROM name
-        record_ptr += ROM_NAME_MAX; // Move the pointer to the next field
-        records[record_count].Mapper = *record_ptr++; // Read the mapper code
-        records[record_count].Size = read_ulong(record_ptr); // Read the ROM size
-        record_ptr += sizeof(unsigned long); // Move the pointer to the next field
-        records[record_count].Offset = read_ulong(record_ptr); // Read the ROM offset
-        record_ptr += sizeof(unsigned long); // Move the pointer to the next record
-        record_count++; // Increment the record count
     }
 
     uint8_t rom_index = 0;
-    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
     bool rom_selected = false; // ROM selected flag
+#if LOW_POWER_MAPPER
+    if (busclock.speed != BUS_TURBO) // Standard bus only, as loadrom_mapper
+    {
+        rom_index = menu_sleep(rom_sram + offset); // Asleep while the user browses the catalog
+        rom_selected = true;
+    }
+#endif
     while (true)  // Loop until a ROM is selected
     {
         // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
+        uint32_t bus = bus_sample(); // Sample control signals and address bus at once
+        bool sltsl = bus_active(bus, BUS_SLTSL_MASK); // Slot selected (active low)
+        bool rd = bus_active(bus, BUS_RD_MASK);       // Read cycle (active low)
 
-        uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-        //uint16_t addr = sio_hw->gpio_in & 0x00FFFF;
+        uint16_t addr = bus_addr(bus); // Read the address bus
         if (sltsl) 
         {
-            bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low, not used)
+            bool wr = bus_active(bus, BUS_WR_MASK);       // Write cycle (active low, not used)
 
             if (wr && addr == 0x9D01) // Monitor ROM address 0x9D01
             {   
-                    rom_index = (gpio_get_all() >> 16) & 0xFF;
-                    while (!(gpio_get(PIN_WR))) { // Wait until the write cycle completes (WR goes high){
+                    rom_index = bus_data(bus_sample());
+                    while (!(bus_sample() & BUS_WR_MASK)) { // Wait until the write cycle completes (WR goes high){
                         tight_loop_contents();
                     }
-                    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
                     rom_selected = true;    // ROM selected
             }
 
@@ -157,13 +299,8 @@ int __no_inline_not_in_flash_func(loadrom_msx_menu)(uint32_t offset)
             {   
                 if (rd)
                 {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
                     uint32_t rom_addr = offset + (addr - 0x4000); // Calculate flash address
-                    gpio_put_masked(0xFF0000, rom_sram[rom_addr] << 16); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD))) { // Wait until the read cycle completes (RD goes high)
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
+                    serve_read(rom_sram[rom_addr]); // Drive the data bus until the read cycle completes
                 }
             } 
         }
@@ -175,525 +312,498 @@ int __no_inline_not_in_flash_func(loadrom_msx_menu)(uint32_t offset)
     }
 }
 
-// loadrom_plain32 - Load a simple 32KB (or less) ROM into the MSX directly from the pico flash
-// 32KB ROMS have two pages of 16Kb each in the following areas:
-// 0x4000-0x7FFF and 0x8000-0xBFFF
-// AB is on 0x0000, 0x0001
-// 16KB ROMS have only one page in the 0x4000-0x7FFF area
-// AB is on 0x0000, 0x0001
-void __no_inline_not_in_flash_func(loadrom_plain32)(uint32_t offset)
-{
-    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
-    while (true) 
-    {
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
+// setup the capture address PIO state machine
+// window is the 64KB aligned SRAM area that mirrors the MSX address space; the state machine pushes
+// window | address for every read cycle of this slot
+void setup_pio_capture_addr(const uint8_t *window) {
+    
+    static int offset0 = -1; // The program is loaded once and reused when a ROM is started again after a swap
+    if (offset0 < 0)
+        offset0 = msx_capture_addr_add_program(pio, PIN_RD); // Load the PIO program
+    pio_sm_config c0 = msx_capture_addr_program_get_default_config(offset0); // Get the default configuration
+
+    // Initialize the control signals and address pins as PIO GPIOs:
+    pio_gpio_init(pio, PIN_SLTSL);  // /SLTSL
+    for (int i = 0; i < 16; i++) pio_gpio_init(pio, ADDR_PINS + i); // A0-A15
+    sm_config_set_in_pins(&c0, PIN_A0);  // Configure input pins
+    sm_config_set_jmp_pin(&c0, PIN_SLTSL);  // Reads with /SLTSL high are skipped
+    sm_config_set_in_shift(&c0, false, false, 32);  // Shift left, window base ends up in the upper 16 bits
+
+    sm_config_set_fifo_join(&c0, PIO_FIFO_JOIN_NONE);  // Separate RX and TX FIFOs
+    sm_config_set_clkdiv(&c0, 1.0f);  // MSX bus timing adjust
+
+    pio_sm_init(pio, sm0, offset0, &c0);
+    pio_sm_put(pio, sm0, (uint32_t)window >> 16); // Upper 16 bits of the SRAM window address
+    pio_sm_set_enabled(pio, sm0, true);
 
-        if (sltsl) 
-        {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF) // Check if the address is within the ROM range
-            {
-                if (rd) // Handle read requests within the ROM address range
-                {
-                    uint32_t rom_addr = offset + (addr - 0x4000); // Calculate flash address
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    gpio_put_masked(0xFF0000, rom[rom_addr] << 16); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD)))  // Wait until the read cycle completes (RD goes high)
-                    {
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after cycle completes
-                }
-            } 
-        } 
-    }
 }
 
-// loadrom_linear48 - Load a simple 48KB Linear0 ROM into the MSX directly from the pico flash
-// Those ROMs have three pages of 16Kb each in the following areas:
-// 0x0000-0x3FFF, 0x4000-0x7FFF and 0x8000-0xBFFF
-// AB is on 0x4000, 0x4001
-void __no_inline_not_in_flash_func(loadrom_linear48)(uint32_t offset)
-{
-    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
-    while (true) 
-    {
-        // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
+// setup the data output PIO state machine
+// The state machine owns the data bus direction, it only drives GPIO 16–23 while /RD is low
+void setup_pio_output_data() {
+
+    for (int i = 0; i < 8; i++) pio_gpio_init(pio, DATA_PINS + i);
+    pio_gpio_init(pio, PIN_RD);  // /RD
+
+    // ----- Set up SM1 for data output -----
+    uint offset1 = msx_output_data_add_program(pio, PIN_RD);
+    pio_sm_config c1 = msx_output_data_program_get_default_config(offset1);
+    sm_config_set_out_pins(&c1, DATA_PINS, 8);  // Configure the 'out' pins: data bus on GPIO 16–23.
+    sm_config_set_out_shift(&c1, true, false, 32);  // Shift right, the program pulls explicitly
+    pio_sm_set_consecutive_pindirs(pio, sm1, DATA_PINS, 8, false);  // Data bus released until a read is served
+    pio_sm_init(pio, sm1, offset1, &c1);
+    pio_sm_set_enabled(pio, sm1, true);
 
-        if (sltsl)
-        {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x0000 && addr <= 0xBFFF) // Check if the address is within the ROM range
-            {
-                if (rd)
-                {
-                    uint32_t rom_addr = offset + addr; // Calculate flash address
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    gpio_put_masked(0xFF0000, rom[rom_addr] << 16); // Write the data to the data bus
-                    while (gpio_get(PIN_RD) == 0) // Wait until the read cycle completes (RD goes high)
-                    {
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
-                }
-            }
-        }
-    }
 }
 
-// loadrom_konamiscc - Load a any Konami SCC ROM into the MSX directly from the pico flash
-// The KonamiSCC ROMs are divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments 
-// into the MSX's address space. Since the size of the mapper is 8Kb, the memory banks are:
-// Bank 1: 4000h - 5FFFh , Bank 2: 6000h - 7FFFh, Bank 3: 8000h - 9FFFh, Bank 4: A000h - BFFFh
-// And the address to change banks are:
-// Bank 1: 5000h - 57FFh (5000h used), Bank 2: 7000h - 77FFh (7000h used), Bank 3: 9000h - 97FFh (9000h used), Bank 4: B000h - B7FFh (B000h used)
-// AB is on 0x0000, 0x0001
-void __no_inline_not_in_flash_func(loadrom_konamiscc)(uint32_t offset)
-{
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
+// mapper_write_irq_handler - Apply the captured write cycles to the mapper bank registers
+// Runs on core 0 when the write capture RX FIFO is not empty. Core 1 is busy with the I/O ports, and a write cycle
+// never overlaps a read, so taking the interrupt here does not delay the read loop.
+void __no_inline_not_in_flash_func(mapper_write_irq_handler)() {
 
-    gpio_set_dir_in_masked(0xFF << 16); // Set data bus to input mode
-    while (true) 
+    while (!pio_sm_is_rx_fifo_empty(pio, sm2))
     {
-        // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
+        uint32_t bus = pio_sm_get(pio, sm2); // (data << 16) | addr
+        mapper_write(&mapper, bus & 0xFFFF, (bus >> 16) & 0xFF);
+        swap_write(bus & 0xFFFF, (bus >> 16) & 0xFF);
+    }
 
-        if (sltsl)
-        {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF)  // Check if the address is within the ROM range
-            {
-                if (rd) 
-                {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    uint32_t rom_offset = offset + (bank_registers[(addr - 0x4000) >> 13] * 0x2000) + (addr & 0x1FFF); // Calculate the ROM offset
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD)))  // Wait until the read cycle completes (RD goes high)
-                    {
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after cycle completes
-                } else if (wr) 
-                {
-                    // Handle writes to bank switching addresses
-                    if ((addr >= 0x5000)  && (addr <= 0x57FF)) { 
-                        bank_registers[0] = (gpio_get_all() >> 16) & 0xFF; // Read the data bus and store in bank register
-                    } else if ((addr >= 0x7000) && (addr <= 0x77FF)) {
-                        bank_registers[1] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if ((addr >= 0x9000) && (addr <= 0x97FF)) {
-                        bank_registers[2] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if ((addr >= 0xB000) && (addr <= 0xB7FF)) {
-                        bank_registers[3] = (gpio_get_all() >> 16) & 0xFF;
-                    }
+}
 
-                    while (!(gpio_get(PIN_WR)))
-                    {
-                        tight_loop_contents();
-                    }
-                }
-            }
-        }
+// setup the write capture PIO state machine
+// Every write cycle of this slot is latched as (data << 16) | addr in the RX FIFO, so bank register writes are
+// never missed while the read loop is busy and the read loop does not need to decode them.
+// handler drains the FIFO on core 0 (mapper_write_irq_handler, or expander_write_irq_handler in slot expander mode).
+void setup_pio_capture_write(void (*handler)(void)) {
+
+    static int offset2 = -1; // The program is loaded once and reused when a ROM is started again after a swap
+    if (offset2 < 0)
+        offset2 = msx_capture_write_add_program(pio, PIN_WR);
+    pio_sm_config c2 = msx_capture_write_program_get_default_config(offset2);
+    sm_config_set_in_pins(&c2, PIN_A0);  // Address and data bus
+    sm_config_set_jmp_pin(&c2, PIN_SLTSL);  // Writes with /SLTSL high are skipped
+    sm_config_set_in_shift(&c2, false, false, 32);  // Shift left, the program pushes explicitly
+    sm_config_set_fifo_join(&c2, PIO_FIFO_JOIN_RX);  // 8 deep RX FIFO, the TX FIFO is not used
+    pio_sm_init(pio, sm2, offset2, &c2);
+    pio_sm_clear_fifos(pio, sm2); // Nothing left over from a previous ROM
+
+    pio_set_irq1_source_enabled(pio, pis_sm2_rx_fifo_not_empty, true);
+    irq_set_exclusive_handler(PIO0_IRQ_1, handler);
+    irq_set_enabled(PIO0_IRQ_1, true);
+    pio_sm_set_enabled(pio, sm2, true);
+
+}
+
+#if SLOT_EXPANDER
+// expander_write_irq_handler - Apply the captured write cycles to the secondary slot register and the subslots
+// Same as mapper_write_irq_handler, in slot expander mode.
+void __no_inline_not_in_flash_func(expander_write_irq_handler)() {
+
+    while (!pio_sm_is_rx_fifo_empty(pio, sm2))
+    {
+        uint32_t bus = pio_sm_get(pio, sm2); // (data << 16) | addr
+        expander_write(&expander, bus & 0xFFFF, (bus >> 16) & 0xFF);
+        swap_write(bus & 0xFFFF, (bus >> 16) & 0xFF);
     }
+
 }
+#endif
 
-// loadrom_konami - Load a Konami (without SCC) ROM into the MSX directly from the pico flash
-// The Konami (without SCC) ROM is divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Since the size of the mapper is 8Kb, the memory banks are:
-//  Bank 1: 4000h - 5FFFh, Bank 2: 6000h - 7FFFh, Bank 3: 8000h - 9FFFh, Bank 4: A000h - BFFFh
-// And the addresses to change banks are:
-//	Bank 1: <none>, Bank 2: 6000h - 67FFh (6000h used), Bank 3: 8000h - 87FFh (8000h used), Bank 4: A000h - A7FFh (A000h used)
-// AB is on 0x0000, 0x0001
-void __no_inline_not_in_flash_func(loadrom_konami)(uint32_t offset)
-{
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
+// fdc_write_irq_handler - Apply the captured write cycles to the floppy disk controller registers
+// Same as mapper_write_irq_handler, for DSK images.
+void __no_inline_not_in_flash_func(fdc_write_irq_handler)() {
 
-    gpio_set_dir_in_masked(0xFF << 16);
-    while (true) 
+    while (!pio_sm_is_rx_fifo_empty(pio, sm2))
     {
-        // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
+        uint32_t bus = pio_sm_get(pio, sm2); // (data << 16) | addr
+        if (fdc_register(bus & 0xFFFF))
+            fdc_write(&fdc, bus & 0xFFFF, (bus >> 16) & 0xFF);
+        swap_write(bus & 0xFFFF, (bus >> 16) & 0xFF);
+    }
 
-        if (sltsl)
-        {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF) 
-            {
-                if (rd) 
-                {
-                    gpio_set_dir_out_masked(0xFF << 16);
-                    uint32_t rom_offset = offset + (bank_registers[(addr - 0x4000) >> 13] * 0x2000) + (addr & 0x1FFF); // Calculate the ROM offset
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16);
-                    while (!(gpio_get(PIN_RD))) 
-                    {
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16);
-
-                }else if (wr) {
-                    // Handle writes to bank switching addresses
-                    if ((addr >= 0x6000) && (addr <= 0x67FF)) {
-                        bank_registers[1] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if ((addr >= 0x8000) && (addr <= 0x87FF)) {
-                        bank_registers[2] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if ((addr >= 0xA000) && (addr <= 0xA7FF)) {
-                        bank_registers[3] = (gpio_get_all() >> 16) & 0xFF;
-                    }
+}
 
-                    while (!(gpio_get(PIN_WR))) 
-                    {
-                        tight_loop_contents();
-                    }
-                }
-            }
-        }
+// cas_write_irq_handler - Store the BIOS page 0 copy written by the CAS loader
+// The loader copies 0000h-3FFFh to its own page 1 (LDIR to 4000h), the bytes land in the page 0 part of the ROM
+// window until the copy is patched (see cas.h).
+void __no_inline_not_in_flash_func(cas_write_irq_handler)() {
+
+    while (!pio_sm_is_rx_fifo_empty(pio, sm2))
+    {
+        uint32_t bus = pio_sm_get(pio, sm2); // (data << 16) | addr
+        if (!cas.patched && (bus & 0xC000) == 0x4000)
+            rom_window[bus & 0x3FFF] = (bus >> 16) & 0xFF;
+        swap_write(bus & 0xFFFF, (bus >> 16) & 0xFF);
     }
+
 }
 
-// loadrom_ascii8 - Load an ASCII8 ROM into the MSX directly from the pico flash
-// The ASCII8 ROM is divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Since the size of the mapper is 8Kb, the memory banks are:
-// Bank 1: 4000h - 5FFFh , Bank 2: 6000h - 7FFFh, Bank 3: 8000h - 9FFFh, Bank 4: A000h - BFFFh
-// And the address to change banks are:
-// Bank 1: 6000h - 67FFh (6000h used), Bank 2: 6800h - 6FFFh (6800h used), Bank 3: 7000h - 77FFh (7000h used), Bank 4: 7800h - 7FFFh (7800h used)
-// AB is on 0x0000, 0x0001
-void __no_inline_not_in_flash_func(loadrom_ascii8)(uint32_t offset)
-{
+// stop_pio_capture_write - Stop the write capture state machine and its interrupt when a ROM is left
+void stop_pio_capture_write() {
 
-    uint8_t bank_registers[4] = {0, 1, 2, 3}; // Initial banks 0-3 mapped
+    irq_set_enabled(PIO0_IRQ_1, false);
+    pio_set_irq1_source_enabled(pio, pis_sm2_rx_fifo_not_empty, false);
+    pio_sm_set_enabled(pio, sm2, false);
+    irq_remove_handler(PIO0_IRQ_1, irq_get_exclusive_handler(PIO0_IRQ_1)); // The next ROM may drain it with another handler
 
-    gpio_set_dir_in_masked(0xFF << 16);
-    while (true) 
-    {
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
+}
 
-        if (sltsl) {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF) 
-            {
-                if (rd) 
-                {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    uint32_t rom_offset = offset + (bank_registers[(addr - 0x4000) >> 13] * 0x2000) + (addr & 0x1FFF); // Calculate the ROM offset
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD)))  { // Wait for the read cycle to complete
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after the read cycle
-                } else if (wr)  // Handle writes to bank switching addresses
-                { 
-                    if ((addr >= 0x6000) && (addr <= 0x67FF)) { 
-                        bank_registers[0] = (gpio_get_all() >> 16) & 0xFF; // Read the data bus and store in bank register
-                    } else if ((addr >= 0x6800) && (addr <= 0x6FFF)) {
-                        bank_registers[1] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if ((addr >= 0x7000) && (addr <= 0x77FF)) {
-                        bank_registers[2] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if ((addr >= 0x7800) && (addr <= 0x7FFF)) {
-                        bank_registers[3] = (gpio_get_all() >> 16) & 0xFF;
-                    }
+// setup the chained DMA pair that turns captured addresses into data bus bytes
+// The address channel waits for the capture state machine and writes the SRAM address into the read address
+// trigger register of the data channel. The data channel copies that byte to the output state machine and
+// chains back to the address channel, so the pair keeps running without CPU intervention.
+void setup_dma_read_path() {
+
+    dma_addr_chan = dma_claim_unused_channel(true);
+    dma_data_chan = dma_claim_unused_channel(true);
+
+    dma_channel_config cd = dma_channel_get_default_config(dma_data_chan);
+    channel_config_set_high_priority(&cd, true);
+    channel_config_set_transfer_data_size(&cd, DMA_SIZE_8); // Byte transfer
+    channel_config_set_read_increment(&cd, false); // Read address is set by the address channel
+    channel_config_set_write_increment(&cd, false); // No increment for PIO TX FIFO
+    channel_config_set_dreq(&cd, pio_get_dreq(pio, sm1, true)); // Pace transfer with PIO TX FIFO
+    channel_config_set_chain_to(&cd, dma_addr_chan); // Re-arm the address channel
+
+    dma_channel_configure(
+        dma_data_chan,
+        &cd,
+        &pio->txf[sm1], // Write data to PIO SM1 TX FIFO
+        NULL, // Read address written by the address channel
+        1, // Transfer one byte
+        false // Started by the address channel
+    );
+
+    dma_channel_config ca = dma_channel_get_default_config(dma_addr_chan);
+    channel_config_set_high_priority(&ca, true);
+    channel_config_set_transfer_data_size(&ca, DMA_SIZE_32); // SRAM address
+    channel_config_set_read_increment(&ca, false); // No increment for PIO RX FIFO
+    channel_config_set_write_increment(&ca, false); // Always the same register
+    channel_config_set_dreq(&ca, pio_get_dreq(pio, sm0, false)); // Pace transfer with PIO RX FIFO
+
+    dma_channel_configure(
+        dma_addr_chan,
+        &ca,
+        &dma_hw->ch[dma_data_chan].al3_read_addr_trig, // Set read address and trigger the data channel
+        &pio->rxf[sm0], // Read the captured address from PIO SM0 RX FIFO
+        1, // Transfer one address
+        true // Start waiting for the first read cycle
+    );
 
-                    while (!(gpio_get(PIN_WR))) 
-                    {
-                        tight_loop_contents();
-                    }
-                }
-            }
-        }
-    }
 }
 
-// loadrom_ascii16 - Load an ASCII16 ROM into the MSX directly from the pico flash
-// The ASCII16 ROM is divided into 16KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Since the size of the mapper is 16Kb, the memory banks are:
-// Bank 1: 4000h - 7FFFh , Bank 2: 8000h - BFFFh
-// And the address to change banks are:
-// Bank 1: 6000h - 67FFh (6000h used), Bank 2: 7000h - 77FFh (7000h and 77FFh used)
-void __no_inline_not_in_flash_func(loadrom_ascii16)(uint32_t offset)
+// loadrom_plain_pio - Load a plain 16/32KB or a 48KB Linear0 ROM into the MSX using PIO and DMA only
+// Returns when the ROM has to be left (see swap.h).
+// The ROM is copied into the 64KB aligned SRAM window while the MSX is held with WAIT. From then on the capture
+// state machine, the chained DMA pair and the output state machine (set up at boot) serve every read, leaving both
+// cores free.
+// base_addr is 0x4000 for 16/32KB ROMs (AB is on 0x4000, 0x4001) and 0x0000 for 48KB Linear0 ROMs.
+void __no_inline_not_in_flash_func(loadrom_plain_pio)(uint32_t offset, uint32_t size, uint16_t base_addr)
 {
-    uint8_t bank_registers[2] = {0, 1}; // Initial banks 0 and 1 mapped
+    gpio_init(PIN_WAIT); // Init wait signal pin
+    gpio_set_dir(PIN_WAIT, GPIO_OUT); // Set the WAIT signal as output
+    gpio_put(PIN_WAIT, 0); // Wait until we are ready to read the ROM
+    plain_window_build(rom_window, rom + offset, size, base_addr);
 
-    gpio_set_dir_in_masked(0xFF << 16);
-    while (true) {
-        // Check control signals
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
+    setup_dma_read_path(); // Setup the DMA channels linking both state machines
+    setup_pio_capture_addr(rom_window); // Setup the address capture PIO state machine
+    mapper_init(&mapper, MAPPER_PLAIN32, rom_window); // No bank register, the write capture only looks for the magic write
+    setup_pio_capture_write(mapper_write_irq_handler);
+    swap_arm(); // Leave on a reset or on the magic write (see swap.h)
+    gpio_put(PIN_WAIT, 1); // Lets go!
 
-        if (sltsl) {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read the address bus
-            if (addr >= 0x4000 && addr <= 0xBFFF)  
-            {
-                if (rd) {
-                    gpio_set_dir_out_masked(0xFF << 16); // Set data bus to output mode
-                    uint32_t rom_offset = offset + (bank_registers[(addr >> 15) & 1] << 14) + (addr & 0x3FFF);
-                    gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Write the data to the data bus
-                    while (!(gpio_get(PIN_RD)))  // Wait for the read cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode after the read cycle
-                }
-                else if (wr) 
-                {
-                    // Update bank registers based on the specific switching addresses
-                    if ((addr >= 0x6000) && (addr <= 0x67FF)) {
-                        bank_registers[0] = (gpio_get_all() >> 16) & 0xFF;
-                    } else if (addr >= 0x7000 && addr <= 0x77FF) {
-                        bank_registers[1] = (gpio_get_all() >> 16) & 0xFF;
-                    }
-                    while (!(gpio_get(PIN_WR))) {
-                        tight_loop_contents();
-                    }
-                }
-            }
-        }
+    while (!swap_pending) 
+    {
+        __wfe(); // Nothing left to do for the CPU
     }
+
+    stop_pio_capture_write();
+    pio_sm_set_enabled(pio, sm0, false);
+    dma_channel_abort(dma_addr_chan);
+    dma_channel_abort(dma_data_chan);
+    dma_channel_unclaim(dma_addr_chan);
+    dma_channel_unclaim(dma_data_chan);
 }
 
-// loadrom_neo8 - Load an NEO8 ROM into the MSX directly from the pico flash
-// The NEO8 ROM is divided into 8KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Size of a segment: 8 KB
-// Segment switching addresses:
-// Bank 0: 0000h~1FFFh, Bank 1: 2000h~3FFFh, Bank 2: 4000h~5FFFh, Bank 3: 6000h~7FFFh, Bank 4: 8000h~9FFFh, Bank 5: A000h~BFFFh
-// Switching address: 
-// 5000h (mirror at 1000h, 9000h and D000h), 
-// 5800h (mirror at 1800h, 9800h and D800h), 
-// 6000h (mirror at 2000h, A000h and E000h), 
-// 6800h (mirror at 2800h, A800h and E800h), 
-// 7000h (mirror at 3000h, B000h and F000h), 
-// 7800h (mirror at 3800h, B800h and F800h)
-void __no_inline_not_in_flash_func(loadrom_neo8)(uint32_t offset)
+// loadrom_mapper - Load a ROM into the MSX using the table driven mapper engine
+// Returns when the ROM has to be left (see swap.h), or right away if the mapper is not supported.
+// A ROM that fits in the segment cache storage is copied whole to SRAM first, larger ones are served from the
+// flash through the segment cache.
+// The page and write action tables are built once by mapper_init for the selected mapper (see mapper.c for the
+// layout of each supported mapper). A read is served with a single table lookup. Bank register writes are
+// captured by PIO and applied from the FIFO interrupt, so the loop only serves reads and is the same for every mapper.
+void __no_inline_not_in_flash_func(loadrom_mapper)(uint32_t offset, uint32_t size, uint8_t mapper_type)
 {
-    uint16_t bank_registers[6] = {0}; // 16-bit bank registers initialized to zero (12-bit segment, 4 MSB reserved)
+    uint32_t start = time_us_32();
+    const uint8_t *image = segcache_preload(rom + offset, size); // Whole ROM in SRAM when it fits
 
-    gpio_set_dir_in_masked(0xFF << 16);    // Configure GPIO pins for input mode
-    while (true)
+    if (!mapper_init(&mapper, mapper_type, image ? image : rom + offset))
     {
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
-
-        if (sltsl)
-        {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read address bus
+        printf("Debug: Unsupported ROM mapper: %d\n", mapper_type);
+        return;
+    }
+    if (image)
+    {
+        mapper_attach_sram(&mapper, size);
+        printf("ROM mode: SRAM preload, %lu bytes loaded in %lu us\n", (unsigned long)size,
+               (unsigned long)(time_us_32() - start));
+    }
+    else
+    {
+        mapper_attach_cache(&mapper, size, busclock.speed == BUS_TURBO); // Serve the banked pages (all pages on a turbo bus) from SRAM
+        printf("ROM mode: flash with segment cache, %lu bytes do not fit in %lu bytes of SRAM\n", (unsigned long)size,
+               (unsigned long)SEGCACHE_POOL_SIZE);
+    }
 
-            if (addr <= 0xBFFF)
-            {
-                if (rd)
-                {
-                    // Handle read access
-                    gpio_set_dir_out_masked(0xFF << 16); // Data bus output mode
-                    uint8_t bank_index = addr >> 13;     // Determine bank index (0-5)
-
-                    if (bank_index < 6)
-                    {
-                        uint32_t segment = bank_registers[bank_index] & 0x0FFF; // 12-bit segment number
-                        uint32_t rom_offset = offset + (segment << 13) + (addr & 0x1FFF); // Calculate ROM offset
-                        gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Place data on data bus
-                    }
-                    else
-                    {
-                        gpio_put_masked(0xFF0000, 0xFF << 16); // Invalid page handling (Page 3)
-                    }
+    if (mapper.sram_size) // Battery backed save RAM, restored from the flash journal (see save.h)
+        mapper_attach_save(&mapper, save_attach(rom + offset, size, mapper.sram_size, 1 << mapper.seg_shift, image != NULL), size);
 
-                    while (!(gpio_get(PIN_RD))) // Wait for read cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
+    setup_pio_capture_write(mapper_write_irq_handler); // Latch the write cycles and apply them from the FIFO interrupt
+    swap_arm(); // Leave on a reset or on the magic write (see swap.h)
 
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode
-                }
-                else if (wr)
-                {
-                    // Handle write access
-                    uint16_t base_addr = addr & 0xF800; // Mask to identify base address
-                    uint8_t bank_index = 6;             // Initialize to invalid bank
-
-                    // Determine bank index based on base address
-                    switch (base_addr)
-                    {
-                        case 0x5000:
-                        case 0x1000:
-                        case 0x9000:
-                        case 0xD000:
-                            bank_index = 0;
-                            break;
-                        case 0x5800:
-                        case 0x1800:
-                        case 0x9800:
-                        case 0xD800:
-                            bank_index = 1;
-                            break;
-                        case 0x6000:
-                        case 0x2000:
-                        case 0xA000:
-                        case 0xE000:
-                            bank_index = 2;
-                            break;
-                        case 0x6800:
-                        case 0x2800:
-                        case 0xA800:
-                        case 0xE800:
-                            bank_index = 3;
-                            break;
-                        case 0x7000:
-                        case 0x3000:
-                        case 0xB000:
-                        case 0xF000:
-                            bank_index = 4;
-                            break;
-                        case 0x7800:
-                        case 0x3800:
-                        case 0xB800:
-                        case 0xF800:
-                            bank_index = 5;
-                            break;
-                    }
+#if LOW_POWER_MAPPER
+    // Event driven loop: the capture state machine pushes the address of every read cycle of this slot and the
+    // core sleeps in between. The write capture interrupt wakes it up too and is served from the same WFE.
+    // Experimental: whether the wake up (WFE, FIFO read, table lookup) queues the byte before /RD goes high on a
+    // given machine is counted by lowpower_served, and reported with the time asleep by io_main (see lowpower.h).
+    // Until those reports come back without late reads from real machines the option stays off, and it is only
+    // used on a standard bus, whose /RD pulse leaves the most margin; a turbo bus keeps the polling loop.
+    if (busclock.speed != BUS_TURBO)
+    {
+        setup_pio_capture_addr(NULL); // No window, the pushed word is the bare address
+        pio_set_irq0_source_enabled(pio, pis_sm0_rx_fifo_not_empty, true); // Wake up event only
+        scb_hw->scr |= M33_SCR_SEVONPEND_BITS; // Pending interrupts wake WFE
 
-                    if (bank_index < 6)
-                    {
-                        uint8_t data = (gpio_get_all() >> 16) & 0xFF;
-                        if (addr & 0x01)
-                        {
-                            // Write to MSB
-                            bank_registers[bank_index] = (bank_registers[bank_index] & 0x00FF) | (data << 8);
-                        }
-                        else
-                        {
-                            // Write to LSB
-                            bank_registers[bank_index] = (bank_registers[bank_index] & 0xFF00) | data;
-                        }
-
-                        // Ensure reserved MSB bits are zero
-                        bank_registers[bank_index] &= 0x0FFF;
-                    }
+        while (!swap_pending)
+        {
+            wait_rx_fifo(sm0, PIO0_IRQ_0);
+            if (swap_pending)
+                break;
+            const uint8_t *data = mapper_read_ptr(&mapper, (uint16_t)pio_sm_get(pio, sm0));
+            if (data)
+            {
+                pio_sm_put(pio, sm1, *data); // Driven until /RD goes high, one push per read cycle
+                lowpower_served();
+                if (save_flash_wanted)
+                    save_lend_flash(); // Save RAM block to persist, see save.h
+            }
+        }
+        pio_set_irq0_source_enabled(pio, pis_sm0_rx_fifo_not_empty, false);
+        pio_sm_set_enabled(pio, sm0, false);
+    }
+    else
+#endif
+    while (!swap_pending) 
+    {
+        uint32_t gpio_state = bus_sample(); // Sample control signals and address bus at once
 
-                    while (!(gpio_get(PIN_WR))) // Wait for write cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
-                }
+        if (bus_active(gpio_state, BUS_SLOT_READ_MASK)) // Read cycle on this slot (both active low)
+        {
+            const uint8_t *data = mapper_read_ptr(&mapper, bus_addr(gpio_state));
+            if (data)
+            {
+                serve_read(*data);
+                if (save_flash_wanted)
+                    save_lend_flash(); // Save RAM block to persist, see save.h
             }
         }
     }
+    stop_pio_capture_write();
+    save_detach(); // Persist the last save RAM writes before the flash is read again
+}
+
+// catalog_end - Flash offset of the end of the ROM images, the save RAM journal must start after it
+static uint32_t catalog_end()
+{
+    uint32_t end = (uintptr_t)rom - XIP_BASE + 0x8000; // The menu and its configuration
+    for (int i = 0; i < record_count; i++)
+    {
+        uint32_t rom_end = (uintptr_t)rom - XIP_BASE + records[i].Offset + records[i].Size;
+        if (rom_end > end)
+            end = rom_end;
+    }
+    return end;
 }
 
-// loadrom_neo16 - Load an NEO16 ROM into the MSX directly from the pico flash
-// The NEO16 ROM is divided into 16KB segments, managed by a memory mapper that allows dynamic switching of these segments into the MSX's address space
-// Size of a segment: 16 KB
-// Segment switching addresses:
-// Bank 0: 0000h~3FFFh, Bank 1: 4000h~7FFFh, Bank 2: 8000h~BFFFh
-// Switching address:
-// 5000h (mirror at 1000h, 9000h and D000h),
-// 6000h (mirror at 2000h, A000h and E000h),
-// 7000h (mirror at 3000h, B000h and F000h)
-void __no_inline_not_in_flash_func(loadrom_neo16)(uint32_t offset)
+// find_record - Return the catalog entry of a ROM by name (file name without .rom for the multirom tool), or -1
+static int find_record(const char *name)
 {
-    // 16-bit bank registers initialized to zero (12-bit segment, 4 MSB reserved)
-    uint16_t bank_registers[3] = {0};
+    for (int i = 0; i < record_count; i++)
+    {
+        if (strncmp(records[i].Name, name, ROM_NAME_MAX) == 0)
+            return i;
+    }
+    return -1;
+}
 
-    // Configure GPIO pins for input mode
-    gpio_set_dir_in_masked(0xFF << 16);
-    while (true)
+// loadrom_disk - Boot a DSK image through the WD2793 disk ROM of the catalog
+// Returns when the ROM has to be left (see swap.h).
+// The disk ROM is copied to the plain ROM window at 4000h-7FFFh, and the window above it holds the track cache, so
+// nothing is read from the flash on the bus core. The controller registers at 7FF8h-7FFFh hide the last bytes of
+// the ROM. Core 1 copies the tracks from the image in flash (see fdc_service), the loop resumes the waiting
+// command between bus cycles.
+// Parameters:
+//   disk     - Catalog entry of the DSK image
+//   disk_rom - Catalog entry of the disk ROM
+void __no_inline_not_in_flash_func(loadrom_disk)(int disk, int disk_rom)
+{
+    gpio_put(PIN_WAIT, 0); // Hold the MSX while the disk ROM is copied
+    memset(rom_window, 0xFF, 0x8000);
+    memcpy(rom_window + 0x4000, rom + records[disk_rom].Offset, (records[disk_rom].Size < 0x4000) ? records[disk_rom].Size : 0x4000);
+    fdc_init(&fdc, rom + records[disk].Offset, records[disk].Size, rom_window + 0x8000);
+    fdc_active = &fdc; // Track copies from core 1
+    gpio_put(PIN_WAIT, 1);
+    printf("ROM mode: disk, %lu byte DSK image in drive A, %d tracks cached in SRAM\n", (unsigned long)records[disk].Size,
+           FDC_CACHE_TRACKS);
+
+    setup_pio_capture_write(fdc_write_irq_handler); // Controller register writes
+    swap_arm(); // Leave on a reset or on the magic write (see swap.h)
+
+    while (!swap_pending)
     {
-        bool sltsl = !(gpio_get(PIN_SLTSL)); // Slot selected (active low)
-        bool rd = !(gpio_get(PIN_RD));       // Read cycle (active low)
-        bool wr = !(gpio_get(PIN_WR));       // Write cycle (active low)
+        uint32_t gpio_state = bus_sample(); // Sample control signals and address bus at once
 
-        if (sltsl)
+        if (bus_active(gpio_state, BUS_SLOT_READ_MASK)) // Read cycle on this slot (both active low)
         {
-            uint16_t addr = gpio_get_all() & 0x00FFFF; // Read address bus
-            if (addr <= 0xBFFF)
-            {
-                if (rd)
-                {
-                    // Handle read access
-                    gpio_set_dir_out_masked(0xFF << 16); // Data bus output mode
-                    uint8_t bank_index = addr >> 14;     // Determine bank index (0-2)
-
-                    if (bank_index < 3)
-                    {
-                        uint32_t segment = bank_registers[bank_index] & 0x0FFF; // 12-bit segment number
-                        uint32_t rom_offset = offset + (segment << 14) + (addr & 0x3FFF); // Calculate ROM offset
-                        gpio_put_masked(0xFF0000, rom[rom_offset] << 16); // Place data on data bus
-                    }
-                    else
-                    {
-                        gpio_put_masked(0xFF0000, 0xFF << 16); // Invalid page handling
-                    }
+            uint16_t addr = bus_addr(gpio_state);
+            if (fdc_register(addr))
+                serve_read(fdc_read(&fdc, addr));
+            else if ((addr & 0xC000) == 0x4000)
+                serve_read(rom_window[addr]);
+            continue;
+        }
+        if (fdc.pending) // A command waits for its track, resumed with the write interrupt masked
+        {
+            uint32_t irq = save_and_disable_interrupts();
+            fdc_idle(&fdc);
+            restore_interrupts(irq);
+        }
+    }
+    stop_pio_capture_write();
+    while (fdc.load >= 0) // Let core 1 finish a requested track copy, the window is reused by the next ROM
+        tight_loop_contents();
+    fdc_active = NULL;
+    printf("Disk: %lu sectors from the track cache, %lu track copies\n", (unsigned long)fdc.hits, (unsigned long)fdc.misses);
+}
 
-                    while (!(gpio_get(PIN_RD))) // Wait for read cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
+// loadrom_cas - Load a CAS image through the BIOS tape routines
+// Returns when the ROM has to be left (see swap.h).
+// The CAS loader ROM is served at 4000h-7FFFh and the patched BIOS copy at 0000h-3FFFh, both from the ROM window
+// by the plain PIO and DMA read path. Core 1 streams the tape on the CAS ports (see cas.h), so the CPU has nothing
+// to do here but the write capture interrupt.
+// Parameters:
+//   tape   - Catalog entry of the CAS image
+//   loader - Catalog entry of the CAS loader ROM
+void __no_inline_not_in_flash_func(loadrom_cas)(int tape, int loader)
+{
+    gpio_put(PIN_WAIT, 0); // Hold the MSX while the loader is copied
+    plain_window_build(rom_window, rom + records[loader].Offset, records[loader].Size, 0x4000);
+    cas_init(&cas, rom + records[tape].Offset, records[tape].Size, rom_window); // Page 0 copy at the start of the window
+    cas_active = &cas;
+    printf("ROM mode: CAS, %lu byte tape, first file type %d\n", (unsigned long)records[tape].Size, cas.type);
+
+    setup_dma_read_path(); // Setup the DMA channels linking both state machines
+    setup_pio_capture_addr(rom_window); // Setup the address capture PIO state machine
+    setup_pio_capture_write(cas_write_irq_handler); // BIOS copy
+    swap_arm(); // Leave on a reset or on the magic write (see swap.h)
+    gpio_put(PIN_WAIT, 1); // Lets go!
 
-                    gpio_set_dir_in_masked(0xFF << 16); // Return data bus to input mode
-                }
-                else if (wr)
-                {
-                    // Handle write access
-                    uint16_t base_addr = addr & 0xF800; // Mask to identify base address
-                    uint8_t bank_index = 3;             // Initialize to invalid bank
-
-                    // Determine bank index based on base address
-                    switch (base_addr)
-                    {
-                        case 0x5000:
-                        case 0x1000:
-                        case 0x9000:
-                        case 0xD000:
-                            bank_index = 0;
-                            break;
-                        case 0x6000:
-                        case 0x2000:
-                        case 0xA000:
-                        case 0xE000:
-                            bank_index = 1;
-                            break;
-                        case 0x7000:
-                        case 0x3000:
-                        case 0xB000:
-                        case 0xF000:
-                            bank_index = 2;
-                            break;
-                    }
+    while (!swap_pending)
+    {
+        __wfe(); // Nothing left to do for the CPU
+    }
 
-                    if (bank_index < 3)
-                    {
-                        uint8_t data = (gpio_get_all() >> 16) & 0xFF; // Read 8-bit data from bus
-                        if (addr & 0x01)
-                        {
-                            // Write to MSB
-                            bank_registers[bank_index] = (bank_registers[bank_index] & 0x00FF) | (data << 8);
-                        }
-                        else
-                        {
-                            // Write to LSB
-                            bank_registers[bank_index] = (bank_registers[bank_index] & 0xFF00) | data;
-                        }
-
-                        // Ensure reserved MSB bits are zero
-                        bank_registers[bank_index] &= 0x0FFF;
-                    }
+    stop_pio_capture_write();
+    pio_sm_set_enabled(pio, sm0, false);
+    dma_channel_abort(dma_addr_chan);
+    dma_channel_abort(dma_data_chan);
+    dma_channel_unclaim(dma_addr_chan);
+    dma_channel_unclaim(dma_data_chan);
+    cas_active = NULL;
+}
 
-                    while (!(gpio_get(PIN_WR))) // Wait for write cycle to complete
-                    {
-                        tight_loop_contents();
-                    }
+#if SLOT_EXPANDER
+// loadrom_expander - Serve the Nextor ROM, a game ROM and RAM as the subslots of an expanded slot
+// Returns when the ROM has to be left (see swap.h), or right away if a mapper is not supported.
+// Both ROMs are preloaded side by side in the segment cache storage when they fit, otherwise the game is served
+// from flash (the segment cache holds one image only). The RAM subslot uses the plain ROM window, which is free in
+// this mode. One fused page table serves every subslot (see expander.h), so the read loop is the loadrom_mapper
+// loop plus the secondary slot register readback.
+// The mode is off by default. The CPU loop serves every read, so a plain ROM loses the PIO and DMA read path it
+// gets in loadrom_plain_pio. Whether the fused loop meets the /RD timing has not been measured on a machine yet, and
+// a standard bus only leaves about 360 ns (54 cycles at 150 MHz) from /RD low to the byte queued. EXPANDER_BENCHMARK
+// is on in every expander build, so the first runs report the margin over USB (see expander_report).
+// Parameters:
+//   game   - Catalog entry of the game ROM
+//   nextor - Catalog entry of the Nextor ROM
+void __no_inline_not_in_flash_func(loadrom_expander)(int game, int nextor)
+{
+    uint32_t start = time_us_32();
+    uint32_t nextor_size = records[nextor].Size;
+    uint32_t game_at = (nextor_size + SEGCACHE_SEG_SIZE - 1) & ~(SEGCACHE_SEG_SIZE - 1); // Game after the Nextor ROM
+    const uint8_t *nextor_image = segcache_preload_at(rom + records[nextor].Offset, nextor_size, 0);
+    const uint8_t *game_image = nextor_image ? segcache_preload_at(rom + records[game].Offset, records[game].Size, game_at) : NULL;
+
+    if (!mapper_init(&nextor_mapper, records[nextor].Mapper, nextor_image ? nextor_image : rom + records[nextor].Offset) ||
+        !mapper_init(&mapper, records[game].Mapper, game_image ? game_image : rom + records[game].Offset))
+    {
+        printf("Debug: Unsupported ROM mapper in slot expander mode: %d/%d\n", records[nextor].Mapper, records[game].Mapper);
+        return;
+    }
+    if (nextor_image)
+        mapper_attach_sram(&nextor_mapper, nextor_size);
+    if (game_image)
+        mapper_attach_sram(&mapper, records[game].Size);
+
+    if (mapper.sram_size)
+        mapper_attach_save(&mapper, save_attach(rom + records[game].Offset, records[game].Size, mapper.sram_size,
+                                                1 << mapper.seg_shift, nextor_image && game_image), records[game].Size);
+
+    expander_init(&expander, &nextor_mapper, &mapper, EXPANDER_WITH_RAM ? rom_window : NULL);
+    if (EXPANDER_WITH_RAM)
+        memset(rom_window, 0xFF, EXPANDER_RAM_SIZE);
+    printf("ROM mode: slot expander, Nextor in subslot %d, ROM %d in subslot %d (%s)%s, ready in %lu us\n",
+           EXPANDER_NEXTOR, game, EXPANDER_GAME, game_image ? "SRAM preload" : "flash",
+           EXPANDER_WITH_RAM ? ", 64KB RAM in subslot 2" : "", (unsigned long)(time_us_32() - start));
+    if (!game_image && busclock.speed == BUS_TURBO)
+        printf("Warning: the game ROM is served from flash on a turbo bus\n");
+
+    setup_pio_capture_write(expander_write_irq_handler); // Register, bank register and RAM writes
+    swap_arm(); // Leave on a reset or on the magic write (see swap.h)
+#if EXPANDER_BENCHMARK
+    expander_bench_start(); // Reported by core 1, see expander_report
+#endif
+
+    while (!swap_pending)
+    {
+        uint32_t stamp = BENCH_STAMP();
+        uint32_t gpio_state = bus_sample(); // Sample control signals and address bus at once
+
+        if (bus_active(gpio_state, BUS_SLOT_READ_MASK)) // Read cycle on this slot (both active low)
+        {
+            const uint8_t *data = expander_read_ptr(&expander, bus_addr(gpio_state));
+            if (data)
+            {
+                pio_sm_put(pio, sm1, *data); // Driven by the output state machine until /RD goes high
+                BENCH_MAX(expander_stats.serve_max, stamp);
+#if EXPANDER_BENCHMARK
+                expander_stats.reads++;
+#endif
+                while (!(bus_sample() & BUS_RD_MASK)) // Wait until the read cycle completes (RD goes high)
+                {
+                    tight_loop_contents();
                 }
+                if (save_flash_wanted)
+                    save_lend_flash(); // Save RAM block to persist, see save.h
+                continue;
             }
         }
+        BENCH_MAX(expander_stats.idle_max, stamp);
     }
+    stop_pio_capture_write();
+    save_detach();
 }
-
+#endif
 
 // Main function running on core 0
 int __no_inline_not_in_flash_func(main)()
@@ -701,41 +811,71 @@ int __no_inline_not_in_flash_func(main)()
     
     stdio_init_all();     // Initialize stdio
     setup_gpio();     // Initialize GPIO
+    setup_pio_output_data(); // The output state machine drives the data bus for every read handler
+
+    gpio_init(PIN_WAIT); // Init wait signal pin
+    gpio_set_dir(PIN_WAIT, GPIO_OUT); // Set the WAIT signal as output
+    gpio_put(PIN_WAIT, 0); // Hold the MSX while the flash timing is calibrated
+    flashcal_run(rom, FLASHCAL_BYTES); // Keep the fastest flash timing that reads the ROMs back correctly
+    gpio_put(PIN_WAIT, 1); // Lets go!
+    busclock_measure(); // Pick the service strategy from the MSX bus clock
 
     multicore_launch_core1(io_main);    // Launch core 1
 
-    int rom_index = loadrom_msx_menu(0x0000); //load the first 32KB ROM into the MSX (The MSX PICOVERSE MENU)
-
-    // Load the selected ROM into the MSX according to the mapper
-    switch (records[rom_index].Mapper) {
-        case 1:
-        case 2:
-            loadrom_plain32(records[rom_index].Offset);
-            break;
-        case 3:
-            loadrom_konamiscc(records[rom_index].Offset);
-            break;
-        case 4:
-            loadrom_linear48(records[rom_index].Offset);
-            break;
-        case 5:
-            loadrom_ascii8(records[rom_index].Offset); 
-            break;
-        case 6:
-            loadrom_ascii16(records[rom_index].Offset); 
-            break;
-        case 7:
-            loadrom_konami(records[rom_index].Offset); 
-            break;
-        case 8:
-            loadrom_neo8(records[rom_index].Offset); 
-            break;
-        case 9:
-            loadrom_neo16(records[rom_index].Offset); 
-            break;
-        default:
-            printf("Debug: Unsupported ROM mapper: %d\n", records[rom_index].Mapper);
-            break;
+    while (true)
+    {
+        int rom_index = loadrom_msx_menu(0x0000); //load the first 32KB ROM into the MSX (The MSX PICOVERSE MENU)
+        save_init(catalog_end()); // Find the latest save RAM copies in the journal
+
+        // Load the selected ROM into the MSX according to the mapper, until a reset or a magic write asks for the
+        // menu. The magic write may also start another ROM of the catalog right away.
+        while (rom_index >= 0 && rom_index < record_count)
+        {
+            busclock_measure(); // The CPU speed may have been changed since the last measurement
+#if SLOT_EXPANDER
+            int nextor = find_record("nextor"); // Any other ROM runs next to Nextor, Nextor alone runs as before
+            bool image = (records[rom_index].Mapper == MAPPER_DSK || records[rom_index].Mapper == MAPPER_CAS);
+            if (nextor >= 0 && nextor != rom_index && !image) // Disk and tape images have their own loaders
+                loadrom_expander(rom_index, nextor);
+            else
+#endif
+            switch (records[rom_index].Mapper) {
+                case MAPPER_PLAIN16:
+                case MAPPER_PLAIN32:
+                    loadrom_plain_pio(records[rom_index].Offset, records[rom_index].Size, 0x4000); // pio version
+                    break;
+                case MAPPER_LINEAR48:
+                    loadrom_plain_pio(records[rom_index].Offset, records[rom_index].Size, 0x0000); // pio version
+                    break;
+                case MAPPER_DSK:
+                {
+                    int disk_rom = find_record(DISK_ROM_NAME);
+                    if (disk_rom >= 0)
+                        loadrom_disk(rom_index, disk_rom);
+                    else
+                        printf("Debug: no %s ROM in the catalog to boot the DSK image\n", DISK_ROM_NAME);
+                    break;
+                }
+                case MAPPER_CAS:
+                {
+                    int loader = find_record(CAS_LOADER_NAME);
+                    if (loader >= 0)
+                        loadrom_cas(rom_index, loader);
+                    else
+                        printf("Debug: no %s ROM in the catalog to load the CAS image\n", CAS_LOADER_NAME);
+                    break;
+                }
+                default:
+                    loadrom_mapper(records[rom_index].Offset, records[rom_index].Size, records[rom_index].Mapper);
+                    break;
+            }
+            rom_index = swap_pending ? swap_target : -1;
+            swap_pending = false; // Taken: a target that returns without arming the swap falls back to the menu
+            swap_target = -1;
+            if (rom_index >= 0 && rom_index < record_count)
+                printf("Hot swap: ROM %d\n", rom_index);
+            else
+                printf("Hot swap: back to the menu\n");
+        }
     }
-    
 }
@@ -12,53 +12,25 @@
 // This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
 // License". https://creativecommons.org/licenses/by-nc-sa/4.0/
 
-#define PIN_A0     0 
-#define PIN_A1     1
-#define PIN_A2     2
-#define PIN_A3     3
-#define PIN_A4     4
-#define PIN_A5     5
-#define PIN_A6     6
-#define PIN_A7     7
-#define PIN_A8     8
-#define PIN_A9     9
-#define PIN_A10    10
-#define PIN_A11    11
-#define PIN_A12    12
-#define PIN_A13    13
-#define PIN_A14    14
-#define PIN_A15    15
-#define ADDR_PINS   0    // Address bus (A0-A15)
+#include "board.h"   // Pin numbers and bus masks of the board
 
-// Data lines (D0-D7)
-#define PIN_D0     16
-#define PIN_D1     17
-#define PIN_D2     18
-#define PIN_D3     19
-#define PIN_D4     20
-#define PIN_D5     21
-#define PIN_D6     22
-#define PIN_D7     23
-#define DATA_PINS   16   // Data bus (D0-D7)
+// mapper loop build option, io.c sleeps with the mapper loop
+#define LOW_POWER_MAPPER 0      // 1: the menu, the mapper loop and the io loop of core 1 sleep in WFE until a cycle or a job comes, standard bus only (experimental, see lowpower.h), 0: poll the bus
 
-// Control signals
-#define PIN_RD     24   // Read strobe from MSX
-#define PIN_WR     26   // Write strobe from MSX
-#define PIN_SLTSL  27   // Slot Select for this cartridge slot
-#define PIN_IORQ   28   // IO Request line from MSX
-#define PIN_WAIT    46  // WAIT line to MSX 
-#define PIN_BUSSDIR 47  // Bus direction line 
+extern PIO pio;    // PIO block running the bus state machines
+extern uint sm1;   // Data output state machine, shared by every read handler
 
 static inline void setup_gpio();
 unsigned long __no_inline_not_in_flash_func(read_ulong)(const unsigned char *ptr);
 int isEndOfData(const unsigned char *memory);
 
 int __no_inline_not_in_flash_func(loadrom_msx_menu)(uint32_t offset);
-void __no_inline_not_in_flash_func(loadrom_plain32)(uint32_t offset);
-void __no_inline_not_in_flash_func(loadrom_linear48)(uint32_t offset);
-void __no_inline_not_in_flash_func(loadrom_konamiscc)(uint32_t offset);
-void __no_inline_not_in_flash_func(loadrom_konami)(uint32_t offset);
-void __no_inline_not_in_flash_func(loadrom_ascii8)(uint32_t offset);
-void __no_inline_not_in_flash_func(loadrom_ascii16)(uint32_t offset);
-void __no_inline_not_in_flash_func(loadrom_neo8)(uint32_t offset);
-void __no_inline_not_in_flash_func(loadrom_neo16)(uint32_t offset);
\ No newline at end of file
+void setup_pio_capture_addr(const uint8_t *window);
+void setup_pio_output_data();
+void setup_pio_capture_write(void (*handler)(void));
+void stop_pio_capture_write();
+void __no_inline_not_in_flash_func(mapper_write_irq_handler)();
+void setup_dma_read_path();
+void __no_inline_not_in_flash_func(loadrom_plain_pio)(uint32_t offset, uint32_t size, uint16_t base_addr);
+void __no_inline_not_in_flash_func(loadrom_mapper)(uint32_t offset, uint32_t size, uint8_t mapper_type);
+void __no_inline_not_in_flash_func(loadrom_expander)(int game, int nextor);
\ No newline at end of file
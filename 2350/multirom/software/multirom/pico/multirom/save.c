@@ -0,0 +1,371 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// save.c - Battery backed save RAM emulation for the MSX PICOVERSE multirom firmware
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include <stddef.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+#include "hardware/sync.h"
+#include "hardware/regs/addressmap.h"
+#include "hardware/structs/qmi.h"
+#include "board.h"
+#include "save.h"
+
+#define SAVE_KEY_BYTES  0x4000      // ROM bytes hashed to tell the games apart
+
+// Journal slot header, first page of a slot
+// magic      - SAVE_MAGIC
+// seq        - Write sequence number, the highest one holds the latest copy of a block
+// key        - Game the block belongs to (hash of the ROM image)
+// block      - Block number in the save RAM
+// length     - Bytes of the block in use (the 2KB ASCII16 save RAM uses part of a block)
+// data_crc   - CRC-32 of the block data
+// header_crc - CRC-32 of the fields above
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;
+    uint32_t key;
+    uint16_t block;
+    uint16_t length;
+    uint32_t data_crc;
+    uint32_t header_crc;
+} save_header_t;
+
+uint8_t save_ram[SAVE_MAX_SPAN];
+volatile uint8_t save_dirty[SAVE_BLOCKS];
+volatile uint32_t save_written;
+volatile bool save_flash_wanted;
+
+static uint32_t slot_seq[SAVE_SLOTS];           // Sequence number of each slot, 0 if empty or not valid
+static uint32_t slot_key[SAVE_SLOTS];           // Game of each slot
+static uint16_t slot_block[SAVE_SLOTS];         // Block of each slot
+static uint32_t next_seq;                       // Sequence number of the next copy
+static uint8_t head;                            // Slot after the last one written
+static bool enabled;                            // The journal area does not overlap the ROM images
+
+static volatile bool attached;                  // A game with save RAM is running
+static volatile bool flash_free;                // Nothing is read from the flash, core 1 may write it
+static volatile bool detach_request;            // Core 0 waits for the last dirty blocks to be persisted
+static volatile bool flash_lent;                // Core 0 holds the MSX with WAIT and keeps off the flash
+static uint32_t game_key;                       // Key of the running game
+static uint16_t game_size;                      // Save RAM size of the running game
+static uint8_t block_buffer[SAVE_BLOCK_SIZE];   // Snapshot of the block being persisted
+static uint8_t header_page[FLASH_PAGE_SIZE];
+
+// crc32 - Standard CRC-32 (IEEE 802.3) of a buffer
+static uint32_t __not_in_flash_func(crc32)(const uint8_t *data, uint32_t size)
+{
+    uint32_t crc = 0xFFFFFFFF;
+    for (uint32_t i = 0; i < size; i++)
+    {
+        crc ^= data[i];
+        for (int b = 0; b < 8; b++)
+            crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+    }
+    return ~crc;
+}
+
+// slot_flash - Flash offset of a journal slot
+static inline uint32_t slot_flash(uint8_t s)
+{
+    return SAVE_AREA_OFFSET + (uint32_t)s * SAVE_SLOT_SIZE;
+}
+
+// slot_header - Header of a journal slot, read through XIP
+static inline const save_header_t *slot_header(uint8_t s)
+{
+    return (const save_header_t *)(XIP_BASE + slot_flash(s));
+}
+
+// latest - Return the slot holding the latest copy of a block, or -1
+static int latest(uint32_t key, uint16_t block)
+{
+    int found = -1;
+    for (int s = 0; s < SAVE_SLOTS; s++)
+    {
+        if (slot_seq[s] && slot_key[s] == key && slot_block[s] == block && (found < 0 || slot_seq[s] > slot_seq[found]))
+            found = s;
+    }
+    return found;
+}
+
+// free_slot - Return the next slot, in ring order from head, that does not hold the latest copy of a block, or -1
+static int free_slot()
+{
+    for (int i = 0; i < SAVE_SLOTS; i++)
+    {
+        uint8_t s = (head + i) % SAVE_SLOTS;
+        if (!slot_seq[s] || latest(slot_key[s], slot_block[s]) != s)
+            return s;
+    }
+    return -1;
+}
+
+// evict - Free the slots of the game whose save was written least recently, when the journal is full
+// All the blocks of that game go at once, so that an older copy of one of them can not come back at the next boot
+// without the others. Runs on core 1 with the flash free, from persist.
+// Returns:
+//   A freed slot, or -1 if the running game holds every slot
+static int __not_in_flash_func(evict)()
+{
+    uint32_t victim = 0, victim_seq = 0;
+    for (int s = 0; s < SAVE_SLOTS; s++)
+    {
+        if (!slot_seq[s] || slot_key[s] == game_key)
+            continue;
+        uint32_t newest = 0; // Last write of the game of this slot
+        for (int t = 0; t < SAVE_SLOTS; t++)
+        {
+            if (slot_seq[t] && slot_key[t] == slot_key[s] && slot_seq[t] > newest)
+                newest = slot_seq[t];
+        }
+        if (!victim_seq || newest < victim_seq)
+        {
+            victim = slot_key[s];
+            victim_seq = newest;
+        }
+    }
+    if (!victim_seq)
+        return -1;
+
+    int freed = -1;
+    for (int s = 0; s < SAVE_SLOTS; s++)
+    {
+        if (!slot_seq[s] || slot_key[s] != victim)
+            continue;
+        slot_seq[s] = 0;
+        if (freed < 0)
+        {
+            freed = s; // Erased by persist when the new copy is written
+            continue;
+        }
+        uint32_t timing = qmi_hw->m[0].timing; // Kept across the flash operation, as in persist
+        uint32_t irq = save_and_disable_interrupts();
+        flash_range_erase(slot_flash(s), FLASH_SECTOR_SIZE); // The header sector, the copy is no longer valid
+        qmi_hw->m[0].timing = timing;
+        restore_interrupts(irq);
+    }
+    printf("Save RAM: journal full, save of game %08lx dropped\n", (unsigned long)victim);
+    return freed;
+}
+
+// save_init - Scan the journal
+// Parameters:
+//   data_end - Flash offset of the end of the ROM images, the journal is disabled if they reach into its area
+void save_init(uint32_t data_end)
+{
+    enabled = data_end <= SAVE_AREA_OFFSET;
+    next_seq = 1;
+    head = 0;
+
+    for (int s = 0; s < SAVE_SLOTS; s++)
+    {
+        const save_header_t *h = slot_header(s);
+        slot_seq[s] = 0;
+        if (!enabled || h->magic != SAVE_MAGIC || h->header_crc != crc32((const uint8_t *)h, offsetof(save_header_t, header_crc)))
+            continue;
+        slot_seq[s] = h->seq;
+        slot_key[s] = h->key;
+        slot_block[s] = h->block;
+        if (h->seq >= next_seq)
+        {
+            next_seq = h->seq + 1;
+            head = (s + 1) % SAVE_SLOTS;
+        }
+    }
+
+    if (!enabled)
+        printf("Save RAM: the ROM images reach the journal area at 0x%08lx, saves are kept in SRAM only\n",
+               (unsigned long)SAVE_AREA_OFFSET);
+}
+
+// save_attach - Load the save RAM of a game from the journal, called on core 0 before the game is started
+// Parameters:
+//   image      - ROM image in flash, identifies the game
+//   rom_size   - Size of the ROM image in bytes
+//   size       - Size of the save RAM, a power of two up to SAVE_MAX_SIZE
+//   span       - Size of the bank the save RAM is mirrored over, a multiple of size up to SAVE_MAX_SPAN
+//   from_sram  - The ROM is served from SRAM, so dirty blocks may be persisted while it runs
+// Returns:
+//   save_ram, filled with the saved data or with 0xFF for blocks never saved
+uint8_t *save_attach(const uint8_t *image, uint32_t rom_size, uint16_t size, uint16_t span, bool from_sram)
+{
+    uint32_t loaded = 0;
+
+    game_key = crc32(image, (rom_size < SAVE_KEY_BYTES) ? rom_size : SAVE_KEY_BYTES) ^ rom_size;
+    game_size = size;
+    memset(save_ram, 0xFF, sizeof(save_ram));
+
+    for (uint16_t b = 0; b * SAVE_BLOCK_SIZE < size; b++)
+    {
+        int s = latest(game_key, b);
+        if (s < 0)
+            continue;
+        const save_header_t *h = slot_header(s);
+        const uint8_t *data = (const uint8_t *)h + FLASH_PAGE_SIZE;
+        if (h->length > SAVE_BLOCK_SIZE || crc32(data, h->length) != h->data_crc)
+            continue;
+        memcpy(save_ram + b * SAVE_BLOCK_SIZE, data, h->length);
+        loaded += h->length;
+    }
+    for (uint32_t o = size; o < span; o += size)
+        memcpy(save_ram + o, save_ram, size); // Mirrors of a save RAM smaller than its bank
+
+    if (!from_sram)
+    {
+        gpio_init(PIN_WAIT); // Asserted by save_lend_flash while a block is persisted
+        gpio_set_dir(PIN_WAIT, GPIO_OUT);
+        gpio_put(PIN_WAIT, 1);
+    }
+
+    memset((void *)save_dirty, 0, sizeof(save_dirty));
+    detach_request = false;
+    save_flash_wanted = false;
+    flash_lent = false;
+    flash_free = from_sram;
+    attached = true;
+
+    printf("Save RAM: %u bytes, %lu restored from flash, %s\n", size, (unsigned long)loaded,
+           !enabled ? "not persisted" : from_sram ? "persisted in the background" : "persisted with the MSX held by WAIT");
+    return save_ram;
+}
+
+// save_detach - Persist the last dirty blocks, called on core 0 when the game is left
+// Core 0 waits here, running from SRAM, while core 1 writes the flash.
+void save_detach()
+{
+    if (!attached)
+        return;
+    flash_free = true;
+    detach_request = true;
+    __sev(); // Core 1 may sleep in io_main
+    while (attached)
+        tight_loop_contents();
+    save_flash_wanted = false;
+}
+
+// save_lend_flash - Hold the MSX with WAIT while core 1 persists a block, called by the bus loop on core 0
+// For ROMs served from flash: called right after a read cycle of the slot, so WAIT is asserted before the next
+// cycle samples it and that cycle is held until the flash can be read again. Interrupts are disabled meanwhile, so
+// the write capture interrupt can not load a segment from the flash (it is served once WAIT is released).
+void __not_in_flash_func(save_lend_flash)()
+{
+    gpio_put(PIN_WAIT, 0);
+    uint32_t irq = save_and_disable_interrupts();
+    flash_lent = true;
+    __sev(); // Core 1 may sleep in io_main
+    while (flash_lent)
+        tight_loop_contents();
+    restore_interrupts(irq);
+    gpio_put(PIN_WAIT, 1); // Lets go!
+}
+
+// persist - Write one block of the running game to the next free journal slot
+// Runs on core 1 with its interrupts disabled while the flash is busy. Core 0 keeps serving the bus from SRAM.
+static void __not_in_flash_func(persist)(uint16_t block)
+{
+    uint16_t length = game_size - block * SAVE_BLOCK_SIZE;
+    if (length > SAVE_BLOCK_SIZE)
+        length = SAVE_BLOCK_SIZE;
+
+    save_dirty[block] = 0; // Cleared before the snapshot, a write in between marks it dirty again
+    memset(block_buffer, 0xFF, sizeof(block_buffer));
+    memcpy(block_buffer, save_ram + block * SAVE_BLOCK_SIZE, length);
+
+    int s = free_slot();
+    if (s < 0)
+        s = evict();
+    if (s < 0)
+    {
+        printf("Save RAM: journal full, block %u not persisted\n", block);
+        return;
+    }
+
+    save_header_t *h = (save_header_t *)header_page;
+    memset(header_page, 0xFF, sizeof(header_page));
+    h->magic = SAVE_MAGIC;
+    h->seq = next_seq;
+    h->key = game_key;
+    h->block = block;
+    h->length = length;
+    h->data_crc = crc32(block_buffer, length);
+    h->header_crc = crc32(header_page, offsetof(save_header_t, header_crc));
+
+    uint32_t start = time_us_32();
+    uint32_t timing = qmi_hw->m[0].timing; // The SDK restores the boot XIP setup, keep the calibrated timing (flashcal.h)
+    uint32_t irq = save_and_disable_interrupts();
+    flash_range_erase(slot_flash(s), SAVE_SLOT_SIZE);
+    flash_range_program(slot_flash(s) + FLASH_PAGE_SIZE, block_buffer, SAVE_BLOCK_SIZE); // Data first
+    flash_range_program(slot_flash(s), header_page, FLASH_PAGE_SIZE); // Header last, commits the copy
+    qmi_hw->m[0].timing = timing;
+    restore_interrupts(irq);
+
+    slot_seq[s] = next_seq++;
+    slot_key[s] = game_key;
+    slot_block[s] = block;
+    head = (s + 1) % SAVE_SLOTS;
+    printf("Save RAM: block %u persisted to journal slot %d in %lu us\n", block, s, (unsigned long)(time_us_32() - start));
+}
+
+// save_poll - Persist the dirty blocks of the running game, called from the core 1 loop
+// Write-behind: a block is persisted once the MSX stopped writing for SAVE_QUIET_US, or SAVE_MAX_DELAY_US after
+// it was first written if the MSX keeps writing. If the ROM is served from flash, core 0 is first asked to lend
+// the flash (see save_lend_flash) and the block is persisted at a later call, once it did. One block per call, so
+// the I/O port loop and the MSX are not held longer than a single flash operation.
+void __not_in_flash_func(save_poll)()
+{
+    static bool pending = false;    // Dirty blocks seen
+    static uint32_t since;          // Time the dirty blocks were first seen
+
+    if (!attached)
+        return;
+
+    int block = -1;
+    for (int b = 0; b < SAVE_BLOCKS && block < 0; b++)
+    {
+        if (save_dirty[b])
+            block = b;
+    }
+
+    if (block < 0)
+    {
+        pending = false;
+        if (detach_request)
+            attached = false; // Everything persisted, core 0 may use the flash again
+        return;
+    }
+
+    uint32_t now = time_us_32();
+    if (!pending)
+    {
+        pending = true;
+        since = now;
+    }
+    if (!enabled)
+    {
+        save_dirty[block] = 0; // Kept in SRAM only
+        return;
+    }
+    if (!detach_request && (now - save_written) < SAVE_QUIET_US && (now - since) < SAVE_MAX_DELAY_US)
+        return;
+    if (!flash_free && !flash_lent)
+    {
+        save_flash_wanted = true; // Served after the next read cycle of the slot
+        return;
+    }
+
+    persist(block);
+    since = now;
+    if (flash_lent)
+    {
+        save_flash_wanted = false;
+        flash_lent = false; // Core 0 releases WAIT
+    }
+}
@@ -0,0 +1,69 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// save.h - Battery backed save RAM emulation for the MSX PICOVERSE multirom firmware
+//
+// ASCII8 and ASCII16 cartridges with save RAM (MAPPER_ASCII8_SRAM, MAPPER_ASCII16_SRAM) get their RAM from the
+// save_ram buffer. Writes from the MSX only touch SRAM and mark the 4KB block they fall in as dirty. Core 1 later
+// persists the dirty blocks to a journal at the end of the flash, in the background, so the bus loop never waits
+// for a flash operation.
+//
+// Journal: SAVE_SLOTS slots of two flash sectors, each holding a header page followed by one block. A new copy
+// of a block always goes to the next slot, in ring order, that does not hold the latest copy of any block, so the
+// erases are spread over the whole area and the previous copy stays valid until the new one is committed. The data
+// is programmed first and the header, which carries the CRC of both, last: a copy interrupted by a power off is
+// ignored at the next boot and the previous one is used.
+//
+// The flash may only be written while no code and no data is read from it. Everything runs from SRAM in this
+// firmware (PICO_COPY_TO_RAM), so it is enough that the ROM itself is not read from the flash: preloaded images
+// are persisted while they run. For images served from flash, the bus loop lends the flash to core 1 right after a
+// read cycle and holds the MSX with WAIT meanwhile (save_lend_flash): one erase and program of a slot, around
+// 100 ms, once the game stopped writing for SAVE_QUIET_US.
+//
+// When no slot is free, the slots of the game whose save was written least recently are reclaimed, all of them at
+// once. A save is therefore only lost once the journal is full of saves of other games written after it.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef SAVE_H
+#define SAVE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pico/stdlib.h"
+#include "hardware/flash.h"
+
+#define SAVE_BLOCK_SHIFT    12                          // 4KB blocks
+#define SAVE_BLOCK_SIZE     (1 << SAVE_BLOCK_SHIFT)
+#define SAVE_MAX_SIZE       0x2000                      // Largest save RAM (ASCII8 8KB)
+#define SAVE_MAX_SPAN       0x4000                      // Largest area mirroring the save RAM (an ASCII16 bank)
+#define SAVE_SLOTS          32                          // Journal slots
+#define SAVE_SLOT_SIZE      (2 * FLASH_SECTOR_SIZE)     // Header page and one block, erased together
+#define SAVE_AREA_SIZE      (SAVE_SLOTS * SAVE_SLOT_SIZE)
+#define SAVE_AREA_OFFSET    (PICO_FLASH_SIZE_BYTES - SAVE_AREA_SIZE) // Flash offset of the journal, at the end
+#define SAVE_MAGIC          0x56535650                  // "PVSV"
+#define SAVE_QUIET_US       500000                      // Persist once the MSX stopped writing for this long
+#define SAVE_MAX_DELAY_US   5000000                     // or at the latest this long after the first write
+#define SAVE_BLOCKS         (SAVE_MAX_SIZE >> SAVE_BLOCK_SHIFT)
+
+extern uint8_t save_ram[SAVE_MAX_SPAN];
+extern volatile uint8_t save_dirty[SAVE_BLOCKS]; // Per block: written by the MSX since it was last persisted
+extern volatile uint32_t save_written;  // Time of the last write from the MSX
+extern volatile bool save_flash_wanted; // Core 1 waits for save_lend_flash to persist a block
+
+void save_init(uint32_t data_end);
+uint8_t *save_attach(const uint8_t *image, uint32_t rom_size, uint16_t size, uint16_t span, bool from_sram);
+void save_detach();
+void save_poll();
+void save_lend_flash();
+
+// save_touch - Mark the block holding a save RAM byte as dirty, called for every save RAM write
+static inline void save_touch(uint16_t offset)
+{
+    save_dirty[offset >> SAVE_BLOCK_SHIFT] = 1; // One byte per block: set by core 0, cleared by core 1, no read-modify-write
+    save_written = time_us_32();
+}
+
+#endif
@@ -0,0 +1,162 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// fdcreplay.c - Console application to replay WD2793 register sequences against the multirom FDC emulation
+//
+// The floppy controller of the multirom firmware (pico/multirom/fdc.c) has no Pico dependency and is built here
+// with a DSK image loaded from disk. The register accesses of a disk ROM, captured with an emulator debugger or
+// written by hand, are replayed one per line and every value read can be checked, so the emulation can be compared
+// with a real controller without flashing a pico. After every access the tool runs the core 1 track service and the
+// bus loop idle step, as the firmware does between two bus cycles.
+//
+// Script lines (numbers in hexadecimal, '#' starts a comment):
+//   w <addr> <value>        write a controller register (7FF8-7FFF)
+//   r <addr> [expected]     read a controller register, and check it
+//   d <count> [offset]      read count bytes from the data register, and check them against the image at offset
+//
+// Usage: fdcreplay <image.dsk> [script]   (the script is read from the standard input when not given)
+//        fdcreplay --generate <image.dsk>   (writes the 720KB test image)
+//
+// The scripts in fdc/ (restore, seek, read sector, read address, record not found) are replayed against the
+// generated 720KB image by "make fdctest", part of "make test". Its bytes are a fixed hash of their offset, so a
+// failure can be reproduced and a sector served from the wrong place differs from the expected one.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "fdc.h"
+
+#define MAX_IMAGE_SIZE  (2 * FDC_TRACKS * FDC_TRACK_SIZE)   // 720KB
+#define MAX_LINE        256
+
+static uint8_t image[MAX_IMAGE_SIZE];
+static uint8_t cache[FDC_CACHE_SIZE];
+static fdc_t fdc;
+
+// generate - Write the 720KB test image, each byte the top of a multiplicative hash of its offset
+// Returns:
+// 0 on success, 1 if the file could not be written
+static int generate(const char *name)
+{
+    FILE *file = fopen(name, "wb");
+    if (!file)
+    {
+        printf("Failed to create %s\n", name);
+        return 1;
+    }
+    for (uint32_t offset = 0; offset < MAX_IMAGE_SIZE; offset++)
+        image[offset] = (uint8_t)(((offset + 1) * 2654435761u) >> 24);
+    size_t written = fwrite(image, 1, MAX_IMAGE_SIZE, file);
+    fclose(file);
+    if (written != MAX_IMAGE_SIZE)
+    {
+        printf("Failed to write %s\n", name);
+        return 1;
+    }
+    printf("Image: %s, %u bytes generated\n", name, (unsigned)MAX_IMAGE_SIZE);
+    return 0;
+}
+
+// step - What the firmware does between two bus cycles: core 1 copies a requested track, the bus loop resumes
+static void step()
+{
+    fdc_service(&fdc);
+    fdc_idle(&fdc);
+}
+
+int main(int argc, char *argv[])
+{
+    if (argc == 3 && !strcmp(argv[1], "--generate"))
+        return generate(argv[2]);
+    if (argc < 2 || argc > 3)
+    {
+        printf("Usage: fdcreplay <image.dsk> [script]\n");
+        printf("       fdcreplay --generate <image.dsk>\n");
+        return 1;
+    }
+
+    FILE *file = fopen(argv[1], "rb");
+    if (!file)
+    {
+        printf("Failed to open %s\n", argv[1]);
+        return 1;
+    }
+    uint32_t size = (uint32_t)fread(image, 1, sizeof(image), file);
+    fclose(file);
+
+    FILE *script = (argc == 3) ? fopen(argv[2], "r") : stdin;
+    if (!script)
+    {
+        printf("Failed to open %s\n", argv[2]);
+        return 1;
+    }
+
+    fdc_init(&fdc, image, size, cache);
+    printf("Image: %s, %u bytes, %u side(s)\n", argv[1], size, fdc.sides);
+
+    char line[MAX_LINE];
+    int line_number = 0;
+    int accesses = 0;
+    int mismatches = 0;
+    while (fgets(line, sizeof(line), script))
+    {
+        line_number++;
+        char *comment = strchr(line, '#');
+        if (comment)
+            *comment = 0;
+
+        char op;
+        unsigned a = 0, b = 0;
+        int fields = sscanf(line, " %c %x %x", &op, &a, &b);
+        if (fields <= 0)
+            continue;
+
+        if (op == 'w' && fields == 3)
+        {
+            fdc_write(&fdc, (uint16_t)a, (uint8_t)b);
+            accesses++;
+            step();
+        }
+        else if (op == 'r' && fields >= 2)
+        {
+            uint8_t value = fdc_read(&fdc, (uint16_t)a);
+            accesses++;
+            step();
+            bool bad = (fields == 3) && (value != (uint8_t)b);
+            printf("%4d: r %04X = %02X%s\n", line_number, a, value, bad ? "  MISMATCH" : "");
+            mismatches += bad;
+        }
+        else if (op == 'd' && fields >= 2)
+        {
+            int bad = 0;
+            for (unsigned i = 0; i < a; i++)
+            {
+                uint8_t value = fdc_read(&fdc, FDC_REG_BASE + 3);
+                accesses++;
+                step();
+                if (fields == 3 && (b + i >= size || value != image[b + i]))
+                    bad++;
+            }
+            printf("%4d: d %u bytes%s", line_number, a, (fields == 3) ? "" : "\n");
+            if (fields == 3)
+                printf(", %d differ from the image at %X%s\n", bad, b, bad ? "  MISMATCH" : "");
+            mismatches += (bad != 0);
+        }
+        else
+        {
+            printf("%4d: syntax error\n", line_number);
+            mismatches++;
+        }
+    }
+    if (script != stdin)
+        fclose(script);
+
+    printf("%d accesses, %u track copies, %u sectors from the track cache, %d mismatch(es)\n",
+           accesses, (unsigned)fdc.misses, (unsigned)fdc.hits, mismatches);
+    return mismatches ? 1 : 0;
+}
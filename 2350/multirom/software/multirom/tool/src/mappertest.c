@@ -0,0 +1,218 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// mappertest.c - Console application checking the bank layouts of the multirom mapper engine
+//
+// The mapper engine of the multirom firmwares (common/multirom/mapper.c) is built here without the Pico SDK. Every
+// mapper is initialized on a fake ROM image, bank register writes are applied with mapper_write as the bus loop
+// does, and the page pointers are checked against the bank layout of the real cartridges. The segment cache is not
+// attached, so its functions are only stubs.
+//
+// Usage: mappertest   (exit code 0 when every check passed)
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include "mapper.h"
+#include "segcache.h"
+
+#define IMAGE_SIZE  (1 << 25)   // 32MB, room for the 12-bit NEO8 segment numbers
+
+static const uint8_t *image;
+static int failures;
+
+// Segment cache stubs: mapper_attach_cache is not used here
+void segcache_init(const uint8_t *rom, uint32_t size)
+{
+    (void)rom;
+    (void)size;
+}
+
+const uint8_t *segcache_map(uint8_t *slot, uint32_t segment)
+{
+    (void)slot;
+    return image + (segment << SEGCACHE_SEG_SHIFT);
+}
+
+// check - Compare the byte served at addr with the image offset it should come from (-1: not mapped)
+static void check(const char *name, const mapper_t *m, uint16_t addr, long offset)
+{
+    const uint8_t *p = mapper_read_ptr(m, addr);
+    long got = p ? (long)(p - image) : -1;
+    if (got != offset)
+    {
+        printf("%s: %04Xh served from %lXh, expected %lXh\n", name, addr, (unsigned long)got, (unsigned long)offset);
+        failures++;
+    }
+}
+
+// init - Build a mapper on the image, counting a failure if the code is not supported
+static bool init(const char *name, mapper_t *m, uint8_t mapper)
+{
+    if (mapper_init(m, mapper, image))
+        return true;
+    printf("%s: mapper %d not supported\n", name, mapper);
+    failures++;
+    return false;
+}
+
+// Plain 16/32KB: the image at 4000h-BFFFh, nothing elsewhere, writes ignored
+static void test_plain()
+{
+    mapper_t m;
+    if (!init("Plain32", &m, MAPPER_PLAIN32))
+        return;
+    check("Plain32", &m, 0x0000, -1);
+    check("Plain32", &m, 0x3FFF, -1);
+    check("Plain32", &m, 0x4000, 0x0000);
+    check("Plain32", &m, 0xBFFF, 0x7FFF);
+    check("Plain32", &m, 0xC000, -1);
+    mapper_write(&m, 0x6000, 0x05);
+    check("Plain32", &m, 0x6000, 0x2000);
+}
+
+// Linear0 48KB: the image at 0000h-BFFFh
+static void test_linear()
+{
+    mapper_t m;
+    if (!init("Linear0", &m, MAPPER_LINEAR48))
+        return;
+    check("Linear0", &m, 0x0000, 0x0000);
+    check("Linear0", &m, 0xBFFF, 0xBFFF);
+    check("Linear0", &m, 0xC000, -1);
+}
+
+// Konami SCC: 8KB banks at 4000h, 6000h, 8000h, A000h switched at 5000h, 7000h, 9000h, B000h
+static void test_konamiscc()
+{
+    mapper_t m;
+    if (!init("KonamiSCC", &m, MAPPER_KONAMISCC))
+        return;
+    for (uint16_t i = 0; i < 4; i++)
+        check("KonamiSCC", &m, 0x4000 + (i << 13), (long)i << 13);
+    mapper_write(&m, 0x5000, 0x05);
+    mapper_write(&m, 0x77FF, 0x06);
+    mapper_write(&m, 0x9000, 0x07);
+    mapper_write(&m, 0xB7FF, 0x08);
+    mapper_write(&m, 0x6000, 0x09); // No register at 6000h
+    check("KonamiSCC", &m, 0x4000, 5L << 13);
+    check("KonamiSCC", &m, 0x7FFF, (6L << 13) + 0x1FFF);
+    check("KonamiSCC", &m, 0x8123, (7L << 13) + 0x0123);
+    check("KonamiSCC", &m, 0xA000, 8L << 13);
+}
+
+// Konami without SCC: 4000h-5FFFh fixed on segment 0, banks switched at 6000h, 8000h, A000h
+static void test_konami()
+{
+    mapper_t m;
+    if (!init("Konami", &m, MAPPER_KONAMI))
+        return;
+    mapper_write(&m, 0x4000, 0x05); // Fixed bank
+    mapper_write(&m, 0x6000, 0x09);
+    mapper_write(&m, 0x8000, 0x0A);
+    mapper_write(&m, 0xA7FF, 0x0B);
+    check("Konami", &m, 0x4000, 0x0000);
+    check("Konami", &m, 0x6000, 9L << 13);
+    check("Konami", &m, 0x8000, 10L << 13);
+    check("Konami", &m, 0xBFFF, (11L << 13) + 0x1FFF);
+}
+
+// ASCII8: 8KB banks at 4000h, 6000h, 8000h, A000h switched at 6000h, 6800h, 7000h, 7800h
+static void test_ascii8()
+{
+    mapper_t m;
+    if (!init("ASCII8", &m, MAPPER_ASCII8))
+        return;
+    mapper_write(&m, 0x6000, 0x10);
+    mapper_write(&m, 0x6800, 0x11);
+    mapper_write(&m, 0x7000, 0x12);
+    mapper_write(&m, 0x7FFF, 0xFF);
+    mapper_write(&m, 0x5000, 0x13); // No register at 5000h
+    check("ASCII8", &m, 0x4000, 0x10L << 13);
+    check("ASCII8", &m, 0x6000, 0x11L << 13);
+    check("ASCII8", &m, 0x8000, 0x12L << 13);
+    check("ASCII8", &m, 0xA001, (0xFFL << 13) + 1);
+}
+
+// ASCII16: 16KB banks at 4000h and 8000h switched at 6000h and 7000h
+static void test_ascii16()
+{
+    mapper_t m;
+    if (!init("ASCII16", &m, MAPPER_ASCII16))
+        return;
+    check("ASCII16", &m, 0x8000, 1L << 14);
+    mapper_write(&m, 0x6000, 0x03);
+    mapper_write(&m, 0x77FF, 0x05);
+    check("ASCII16", &m, 0x4000, 3L << 14);
+    check("ASCII16", &m, 0x7FFF, (3L << 14) + 0x3FFF);
+    check("ASCII16", &m, 0x8000, 5L << 14);
+    check("ASCII16", &m, 0xBFFF, (5L << 14) + 0x3FFF);
+}
+
+// NEO8: six 8KB banks on 0000h-BFFFh, 12-bit registers at 5000h-7FFFh (mirrors at 1000h and 9000h), A0 selects MSB
+static void test_neo8()
+{
+    mapper_t m;
+    if (!init("NEO8", &m, MAPPER_NEO8))
+        return;
+    mapper_write(&m, 0x5000, 0x23);
+    mapper_write(&m, 0x5001, 0x01);
+    mapper_write(&m, 0x1800, 0x07); // Mirror of the bank 1 register
+    mapper_write(&m, 0x9801, 0xF0); // Reserved MSB bits are dropped
+    mapper_write(&m, 0x7800, 0x42);
+    check("NEO8", &m, 0x0000, 0x123L << 13);
+    check("NEO8", &m, 0x2000, 0x007L << 13);
+    check("NEO8", &m, 0x4000, 0);
+    check("NEO8", &m, 0xBFFF, (0x42L << 13) + 0x1FFF);
+    check("NEO8", &m, 0xC000, -1);
+}
+
+// NEO16: three 16KB banks on 0000h-BFFFh, 12-bit registers at 5000h, 6000h, 7000h (mirrors at 1000h and 9000h)
+static void test_neo16()
+{
+    mapper_t m;
+    if (!init("NEO16", &m, MAPPER_NEO16))
+        return;
+    mapper_write(&m, 0x6000, 0x02);
+    mapper_write(&m, 0x6001, 0x01);
+    mapper_write(&m, 0x9000, 0x05); // Mirror of the bank 0 register
+    mapper_write(&m, 0x7000, 0x07);
+    check("NEO16", &m, 0x0000, 5L << 14);
+    check("NEO16", &m, 0x4000, 0x102L << 14);
+    check("NEO16", &m, 0x7FFF, (0x102L << 14) + 0x3FFF);
+    check("NEO16", &m, 0x8000, 7L << 14);
+    check("NEO16", &m, 0xC000, -1);
+}
+
+int main()
+{
+    mapper_t m;
+
+    image = calloc(1, IMAGE_SIZE);
+    if (!image)
+    {
+        printf("Out of memory\n");
+        return 1;
+    }
+
+    test_plain();
+    test_linear();
+    test_konamiscc();
+    test_konami();
+    test_ascii8();
+    test_ascii16();
+    test_neo8();
+    test_neo16();
+    if (mapper_init(&m, 0, image) || mapper_init(&m, MAPPER_LAST + 1, image))
+    {
+        printf("Unknown mapper codes accepted\n");
+        failures++;
+    }
+
+    printf("Mapper test: %s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
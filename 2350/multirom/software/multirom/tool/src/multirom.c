@@ -11,7 +11,10 @@
 // 
 // Each record has the following structure:
 //  game - Game name                            - 20 bytes (padded by 0x00)
-//  mapp - Mapper code                          - 01 byte  (0x01: 16KB, 0x02: 32KB, 0x03: Konami, 0x04: Linear0)
+//  mapp - Mapper code                          - 01 byte  (0x01: 16KB, 0x02: 32KB, 0x03: Konami, 0x04: Linear0, ...
+//                                                         0x0A: ASCII8 + save RAM, 0x0B: ASCII16 + save RAM,
+//                                                         0x0C: DSK disk image, served with disk.rom,
+//                                                         0x0D: CAS tape image, loaded with casload.rom)
 //  size - Size of the game in bits             - 4 bytes 
 //  offset - Offset of the game in the flash    - 4 bytes 
 //
@@ -23,8 +26,10 @@
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <dirent.h>
 #include "uf2format.h"
+#include "mapper_codes.h"
 
 #define CONFIG_FILE     "multirom.cfg"          // this is the 7424 (256 * 29) bytes file with the list of ROMs and their information
 #define COMBINED_FILE   "multirom.cmb"          // this is the final binary file with the firmware, menu and ROMs
@@ -39,6 +44,8 @@
 #define MAX_ROM_SIZE            10*1024*1024    // Maximum size of a ROM file
 #define MIN_ROM_SIZE            8192            // Minimum size of a ROM file
 #define MAX_ANALYSIS_SIZE       131072          // 128KB for the mapper analysis
+#define DSK_SIZE_1DD            368640          // 360KB single sided disk image
+#define DSK_SIZE_2DD            737280          // 720KB double sided disk image
 
 // Structure to store file information
 // This struct will be used to store the information of each ROM file processed by the tool
@@ -338,16 +345,19 @@ int main()
     // Process all rom files on the folder
     while ((entry = readdir(dir)) != NULL) 
     {
-        if ((strstr(entry->d_name, ".ROM") != NULL) || (strstr(entry->d_name, ".rom") != NULL)) // Check for .ROM files
+        bool is_disk = (strstr(entry->d_name, ".DSK") != NULL) || (strstr(entry->d_name, ".dsk") != NULL);
+        bool is_tape = (strstr(entry->d_name, ".CAS") != NULL) || (strstr(entry->d_name, ".cas") != NULL);
+        if ((strstr(entry->d_name, ".ROM") != NULL) || (strstr(entry->d_name, ".rom") != NULL) || is_disk || is_tape) // Check for .ROM, .DSK and .CAS files
         { 
             char rom_name[MAX_FILE_NAME_LENGTH] = {0};
             uint32_t rom_size = 0;
             uint32_t fl_offset = base_offset;
 
-            // Extract the first part of the file name (up to the first '.ROM' or '.rom')
-            char *dot_position = strstr(entry->d_name, ".ROM");
+            // Extract the first part of the file name (up to the first '.ROM', '.DSK' or '.CAS', in upper or lower case)
+            const char *extension = is_disk ? ".DSK" : is_tape ? ".CAS" : ".ROM";
+            char *dot_position = strstr(entry->d_name, extension);
             if (dot_position == NULL) {
-                dot_position = strstr(entry->d_name, ".rom");
+                dot_position = strstr(entry->d_name, is_disk ? ".dsk" : is_tape ? ".cas" : ".rom");
             }
             if (dot_position != NULL) {
                 size_t name_length = dot_position - entry->d_name;
@@ -361,7 +371,29 @@ int main()
 
             // Only process the ROM file if it is a valid ROM/supported mapper
             rom_size = file_size(entry->d_name);
-            uint8_t mapper_byte = detect_rom_type(entry->d_name, rom_size);
+            uint8_t mapper_byte = 0;
+            if (is_disk) {
+                // Disk images are booted through the WD2793 disk ROM of the catalog (disk.rom), only the standard
+                // 9 sectors per track formats are supported
+                if (rom_size == DSK_SIZE_1DD || rom_size == DSK_SIZE_2DD) mapper_byte = MAPPER_DSK;
+                else printf("Unsupported disk image size: %s\n", entry->d_name);
+            } else if (is_tape) {
+                // Tape images are loaded through the CAS loader ROM of the catalog (casload.rom), they start with a block header
+                static const uint8_t cas_header[8] = { 0x1F, 0xA6, 0xDE, 0xBA, 0xCC, 0x13, 0x7D, 0x74 };
+                uint8_t header[8] = {0};
+                FILE *tape = fopen(entry->d_name, "rb");
+                if (tape) {
+                    if (fread(header, 1, sizeof(header), tape) == sizeof(header) && memcmp(header, cas_header, sizeof(header)) == 0) mapper_byte = MAPPER_CAS;
+                    fclose(tape);
+                }
+                if (mapper_byte == 0) printf("Not a CAS image: %s\n", entry->d_name);
+            } else {
+                mapper_byte = detect_rom_type(entry->d_name, rom_size);
+            }
+            // Save RAM can not be detected from the ROM contents, the file name has to tell (e.g. "Xanadu [SRAM].rom")
+            if ((strstr(entry->d_name, "SRAM") != NULL || strstr(entry->d_name, "sram") != NULL) && (mapper_byte == MAPPER_ASCII8 || mapper_byte == MAPPER_ASCII16)) {
+                mapper_byte = (mapper_byte == MAPPER_ASCII8) ? MAPPER_ASCII8_SRAM : MAPPER_ASCII16_SRAM;
+            }
             if (mapper_byte != 0)
             {
                 // Write the file name (20 bytes)
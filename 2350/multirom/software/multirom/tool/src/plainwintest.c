@@ -0,0 +1,62 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// plainwintest.c - Console application checking the 64KB window layout of the plain ROMs
+//
+// plain_window_build (common/multirom/plainwin.c) is built here without the Pico SDK. 16KB, 32KB and 48KB images,
+// and an oversized one, are laid out in the window and every byte of the 64KB MSX address space is compared with
+// what the cartridge answers: the image from base_addr, 0xFF elsewhere.
+//
+// Usage: plainwintest   (exit code 0 when every check passed)
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International License.
+// https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+#include "plainwin.h"
+
+static uint8_t image[0x10000];
+static uint8_t window[PLAINWIN_SIZE + 1]; // One guard byte past the window
+static int failures;
+
+// check - Lay out size bytes of the image at base_addr and compare the whole window with the expected bus
+static void check(const char *name, uint32_t size, uint16_t base_addr)
+{
+    uint32_t errors = 0;
+
+    window[PLAINWIN_SIZE] = 0x5A;
+    plain_window_build(window, image, size, base_addr);
+
+    for (uint32_t addr = 0; addr < PLAINWIN_SIZE; addr++)
+    {
+        bool mapped = addr >= base_addr && addr < base_addr + size && addr < PLAINWIN_END;
+        uint8_t expected = mapped ? image[addr - base_addr] : 0xFF;
+        if (window[addr] != expected && errors++ < 4)
+            printf("%s: %04lXh reads %02Xh, expected %02Xh\n", name, (unsigned long)addr, window[addr], expected);
+    }
+    if (window[PLAINWIN_SIZE] != 0x5A)
+    {
+        printf("%s: written past the window\n", name);
+        errors++;
+    }
+    if (errors)
+        failures++;
+}
+
+int main()
+{
+    for (uint32_t i = 0; i < sizeof(image); i++)
+        image[i] = (uint8_t)((i * 7) ^ (i >> 8)); // No 0xFF run that could hide a misplaced copy
+
+    check("Plain16", 0x4000, 0x4000);
+    check("Plain32", 0x8000, 0x4000);
+    check("Linear0", 0xC000, 0x0000);
+    check("Oversized", 0x10000, 0x4000); // Cut at BFFFh
+
+    printf("Plain window test: %s\n", failures ? "FAIL" : "PASS");
+    return failures ? 1 : 0;
+}
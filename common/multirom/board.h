@@ -0,0 +1,94 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// board.h - Board description of the MSX PICOVERSE cartridges
+//
+// Single description of the MSX bus wiring of the RP2040 and RP2350 boards, selected at compile time by the SDK
+// platform macro. The loops sample the bus once per iteration with bus_sample() and test the strobes with the
+// BUS_*_MASK constants below, so every pin lookup is folded into an immediate at compile time. This file and the
+// other modules of common/multirom are built by both multirom firmwares, board differences are behind PICO_RP2350.
+//
+// The PIO programs cannot include C headers: their WAIT gpio numbers are placeholders, moved to PIN_RD or PIN_WR
+// when each program is loaded through its *_add_program() helper (pio_wait.h).
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef BOARD_H
+#define BOARD_H
+
+#include <stdint.h>
+#include "hardware/structs/sio.h"
+
+// Address lines (A0-A15)
+#define PIN_A0     0 
+#define PIN_A1     1
+#define PIN_A2     2
+#define PIN_A3     3
+#define PIN_A4     4
+#define PIN_A5     5
+#define PIN_A6     6
+#define PIN_A7     7
+#define PIN_A8     8
+#define PIN_A9     9
+#define PIN_A10    10
+#define PIN_A11    11
+#define PIN_A12    12
+#define PIN_A13    13
+#define PIN_A14    14
+#define PIN_A15    15
+#define ADDR_PINS   0    // Address bus (A0-A15)
+
+// Data lines (D0-D7)
+#define PIN_D0     16
+#define PIN_D1     17
+#define PIN_D2     18
+#define PIN_D3     19
+#define PIN_D4     20
+#define PIN_D5     21
+#define PIN_D6     22
+#define PIN_D7     23
+#define DATA_PINS   16   // Data bus (D0-D7)
+
+// Control signals
+#if PICO_RP2350
+#define PIN_RD     24   // Read strobe from MSX
+#define PIN_WR     26   // Write strobe from MSX
+#define PIN_SLTSL  27   // Slot Select for this cartridge slot
+#define PIN_IORQ   28   // IO Request line from MSX
+#define PIN_WAIT    46  // WAIT line to MSX 
+#define PIN_BUSSDIR 47  // Bus direction line 
+#else
+#define PIN_RD     24   // Read strobe from MSX
+#define PIN_WR     25   // Write strobe from MSX
+#define PIN_IORQ   26   // IO Request line from MSX
+#define PIN_SLTSL  27   // Slot Select for this cartridge slot
+#define PIN_WAIT    28  // WAIT line to MSX 
+#define PIN_BUSSDIR 29  // Bus direction line to MSX
+#endif
+
+// Compile time masks of the bus sample (GPIO 0-31)
+#define BUS_ADDR_MASK       (0xFFFFu << ADDR_PINS)
+#define BUS_DATA_MASK       (0xFFu << DATA_PINS)
+#define BUS_RD_MASK         (1u << PIN_RD)
+#define BUS_WR_MASK         (1u << PIN_WR)
+#define BUS_SLTSL_MASK      (1u << PIN_SLTSL)
+#define BUS_IORQ_MASK       (1u << PIN_IORQ)
+#define BUS_SLOT_READ_MASK  (BUS_SLTSL_MASK | BUS_RD_MASK)     // Memory read cycle of this slot
+#define BUS_SLOT_WRITE_MASK (BUS_SLTSL_MASK | BUS_WR_MASK)     // Memory write cycle of this slot
+
+// bus_sample - Read the address bus, the data bus and the strobes at once
+static inline uint32_t bus_sample(void)
+{
+    return sio_hw->gpio_in;
+}
+
+// bus_active - True when every active low strobe of mask is low in the sample
+#define bus_active(sample, mask)    (((sample) & (mask)) == 0)
+
+// bus_addr / bus_data - Address and data bus of a sample
+#define bus_addr(sample)            ((uint16_t)(((sample) & BUS_ADDR_MASK) >> ADDR_PINS))
+#define bus_data(sample)            ((uint8_t)(((sample) & BUS_DATA_MASK) >> DATA_PINS))
+
+#endif
@@ -0,0 +1,75 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// busclock.c - MSX bus clock detection for the MSX PICOVERSE multirom firmware
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/pio.h"
+#include "hardware/clocks.h"
+#include "multirom.h"
+#include "busclock.h"
+
+#include "msx_rd_width.pio.h"
+
+busclock_t busclock;
+
+// busclock_measure - Measure the MSX bus clock and pick the service strategy
+// The program is loaded and the state machine claimed on the first call, and kept for the next ones (a measurement
+// is taken before every ROM start), the state machine is only stopped when done. The result is stored in busclock
+// and reported over USB. When no read cycle is seen (MSX held in reset) the previous result is kept.
+void busclock_measure()
+{
+    static int offset = -1;
+    if (offset < 0)
+    {
+        pio_sm_claim(pio, BUSCLOCK_SM); // Never handed out by pio_claim_unused_sm
+        offset = msx_rd_width_add_program(pio, PIN_RD);
+    }
+    pio_sm_config c = msx_rd_width_program_get_default_config(offset);
+    sm_config_set_jmp_pin(&c, PIN_RD);  // Count while /RD is low
+    sm_config_set_fifo_join(&c, PIO_FIFO_JOIN_RX);  // 8 deep RX FIFO, the TX FIFO is not used
+    pio_sm_init(pio, BUSCLOCK_SM, offset, &c);
+    pio_sm_set_enabled(pio, BUSCLOCK_SM, true);
+
+    uint32_t shortest = UINT32_MAX;
+    uint32_t samples = 0;
+    uint64_t deadline = time_us_64() + BUSCLOCK_TIMEOUT_US;
+    while (samples < BUSCLOCK_SAMPLES && time_us_64() < deadline)
+    {
+        if (pio_sm_is_rx_fifo_empty(pio, BUSCLOCK_SM))
+            continue;
+        uint32_t count = pio_sm_get(pio, BUSCLOCK_SM);
+        if (count < shortest)
+            shortest = count;
+        samples++;
+    }
+
+    pio_sm_set_enabled(pio, BUSCLOCK_SM, false);
+    pio_sm_clear_fifos(pio, BUSCLOCK_SM);
+
+    if (!samples && busclock.speed != BUS_UNKNOWN)
+    {
+        printf("Bus clock: no read cycle seen, keeping about %lu kHz\n", (unsigned long)busclock.clock_khz);
+        return;
+    }
+
+    busclock.samples = samples;
+    if (samples)
+    {
+        uint32_t sys_mhz = clock_get_hz(clk_sys) / 1000000;
+        busclock.rd_ns = (2 * shortest * 1000) / sys_mhz; // Two PIO cycles per count
+        busclock.clock_khz = busclock.rd_ns ? 2000000 / busclock.rd_ns : 0; // /RD is low for two clock periods
+        busclock.speed = (busclock.rd_ns < BUSCLOCK_TURBO_NS) ? BUS_TURBO : BUS_STANDARD;
+    }
+
+    printf("Bus clock: shortest /RD %lu ns over %lu cycles, about %lu kHz, %s\n",
+           (unsigned long)busclock.rd_ns, (unsigned long)busclock.samples, (unsigned long)busclock.clock_khz,
+           (busclock.speed == BUS_TURBO) ? "turbo bus, serving from SRAM only" :
+           (busclock.speed == BUS_STANDARD) ? "standard bus, serving from flash and SRAM" :
+                                              "no read cycle seen, serving from flash and SRAM");
+}
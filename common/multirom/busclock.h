@@ -0,0 +1,51 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// busclock.h - MSX bus clock detection for the MSX PICOVERSE multirom firmware
+//
+// The read loops are tuned for a 3.58MHz Z80. Turbo machines shorten the read strobes, so the width of the /RD
+// pulses is measured with a PIO counter. A Z80 memory read holds /RD low for two clock periods, which gives the bus
+// clock, and the service strategy is chosen from it. The MSX can change its CPU speed at any time (turbo switch,
+// R800 mode set by a ROM), so the measurement is taken at boot and again each time a ROM is started, after the
+// menu or a hot swap. It takes well under a millisecond on a running bus, while the MSX is resetting or running its
+// BIOS and does not read the cartridge slot yet.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef BUSCLOCK_H
+#define BUSCLOCK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define BUSCLOCK_SM         3           // State machine claimed for the measurement, the bus handlers use 0-2
+#define BUSCLOCK_SAMPLES    256         // /RD pulses measured
+#define BUSCLOCK_TIMEOUT_US 50000       // Give up if the MSX does not read that often
+#define BUSCLOCK_TURBO_NS   400         // Shortest /RD pulse of a standard 3.58MHz bus is about 560ns
+
+// Bus speed classes
+typedef enum {
+    BUS_UNKNOWN,        // No read cycle seen since boot, handled as a standard bus
+    BUS_STANDARD,       // 3.58MHz Z80: the flash served loops are fast enough
+    BUS_TURBO           // 7MHz Z80 or R800: only SRAM is fast enough, flash is kept off the read path
+} bus_speed_t;
+
+// Measurement result
+// rd_ns     - Shortest /RD pulse seen, in nanoseconds
+// clock_khz - Estimated bus clock
+// samples   - Number of /RD pulses measured
+// speed     - Bus speed class, selects the service strategy
+typedef struct {
+    uint32_t rd_ns;
+    uint32_t clock_khz;
+    uint32_t samples;
+    bus_speed_t speed;
+} busclock_t;
+
+extern busclock_t busclock;
+
+void busclock_measure();
+
+#endif
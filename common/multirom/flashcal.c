@@ -0,0 +1,160 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// flashcal.c - Boot time flash timing calibration for the MSX PICOVERSE multirom firmware
+//
+// Everything here runs from SRAM with interrupts disabled: while a setting is being tried the flash may return
+// wrong data, so no code may be fetched from it.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/clocks.h"
+#include "hardware/regs/addressmap.h"
+#if PICO_RP2350
+#include "hardware/structs/qmi.h"
+#else
+#include "hardware/structs/ssi.h"
+#endif
+#include "flashcal.h"
+
+// checksum - Fletcher style checksum of a flash region
+// The region is read through the uncached XIP alias so every word really comes from the flash.
+static uint32_t __no_inline_not_in_flash_func(checksum)(const uint32_t *p, uint32_t words)
+{
+    uint32_t a = 1, b = 0;
+
+    for (uint32_t i = 0; i < words; i++)
+    {
+        a += p[i];
+        b += a;
+    }
+    return (b << 16) ^ a;
+}
+
+#if PICO_RP2350
+#define TIMING_NAMES "QMI CLKDIV %lu RXDELAY %lu -> CLKDIV %lu RXDELAY %lu"
+
+// set_timing - Program the QMI clock divider and RX delay of the flash window (M0)
+static void __no_inline_not_in_flash_func(set_timing)(uint32_t div, uint32_t dly)
+{
+    uint32_t timing = qmi_hw->m[0].timing & ~(QMI_M0_TIMING_CLKDIV_BITS | QMI_M0_TIMING_RXDELAY_BITS);
+    qmi_hw->m[0].timing = timing | (div << QMI_M0_TIMING_CLKDIV_LSB) | (dly << QMI_M0_TIMING_RXDELAY_LSB);
+}
+
+// get_timing - Read back the QMI clock divider and RX delay of the flash window (M0)
+static void get_timing(uint32_t *div, uint32_t *dly)
+{
+    *div = (qmi_hw->m[0].timing & QMI_M0_TIMING_CLKDIV_BITS) >> QMI_M0_TIMING_CLKDIV_LSB;
+    *dly = (qmi_hw->m[0].timing & QMI_M0_TIMING_RXDELAY_BITS) >> QMI_M0_TIMING_RXDELAY_LSB;
+}
+#else
+#define TIMING_NAMES "SSI BAUDR %lu RX_SAMPLE_DLY %lu -> BAUDR %lu RX_SAMPLE_DLY %lu"
+
+// set_timing - Program the SSI baud divider and RX sample delay
+// The SSI has to be disabled while BAUDR is written, XIP resumes as soon as it is enabled again.
+static void __no_inline_not_in_flash_func(set_timing)(uint32_t div, uint32_t dly)
+{
+    ssi_hw->ssienr = 0;
+    ssi_hw->baudr = div;
+    ssi_hw->rx_sample_dly = dly;
+    ssi_hw->ssienr = 1;
+}
+
+// get_timing - Read back the SSI baud divider and RX sample delay
+static void get_timing(uint32_t *div, uint32_t *dly)
+{
+    *div = ssi_hw->baudr;
+    *dly = ssi_hw->rx_sample_dly;
+}
+#endif
+
+// stable - Check that the current setting reads the region back FLASHCAL_PASSES times without error
+static bool __no_inline_not_in_flash_func(stable)(const uint32_t *p, uint32_t words, uint32_t reference)
+{
+    for (int pass = 0; pass < FLASHCAL_PASSES; pass++)
+    {
+        if (checksum(p, words) != reference)
+            return false;
+    }
+    return true;
+}
+
+// div_floor - Fastest divider that keeps the flash clock within FLASHCAL_SCK_MAX_KHZ at the current system clock
+static uint32_t div_floor()
+{
+    uint32_t sys_khz = clock_get_hz(clk_sys) / 1000;
+    uint32_t div = (sys_khz + FLASHCAL_SCK_MAX_KHZ - 1) / FLASHCAL_SCK_MAX_KHZ;
+
+    div = ((div + FLASHCAL_DIV_STEP - 1) / FLASHCAL_DIV_STEP) * FLASHCAL_DIV_STEP; // Only multiples of the step
+    if (div < FLASHCAL_DIV_MIN)
+        div = FLASHCAL_DIV_MIN;
+    return (div > FLASHCAL_DIV_MAX) ? FLASHCAL_DIV_MAX : div;
+}
+
+// flashcal_run - Find the fastest stable flash timing and keep the one just below it
+// Parameters:
+//   region - Pointer to the flash region used for the check (usually the ROM images)
+//   size   - Size of the region in bytes, only the first FLASHCAL_BYTES are checked
+// The reference checksum is taken at the boot setting, the one the firmware itself was fetched with. The dividers
+// are then tried from the slowest to the fastest the flash is rated for, and the sweep stops at the first divider
+// for which no RX delay is stable. A setting that passes FLASHCAL_PASSES reads at room temperature may still fail
+// when the board warms up, so the divider one step slower than the fastest stable one is kept. The boot setting is
+// kept if the region is empty or if nothing is stable.
+void __no_inline_not_in_flash_func(flashcal_run)(const uint8_t *region, uint32_t size)
+{
+    uint32_t words = ((size < FLASHCAL_BYTES) ? size : FLASHCAL_BYTES) / 4;
+    const uint32_t *p = (const uint32_t *)(((uintptr_t)region & ~0x03) - XIP_BASE + XIP_NOCACHE_NOALLOC_BASE);
+    uint32_t boot_div, boot_dly;
+    get_timing(&boot_div, &boot_dly);
+    uint32_t best_div = boot_div, best_dly = boot_dly;  // Kept setting
+    uint32_t fast_div = 0, fast_dly = 0;                // Fastest stable setting, 0: none yet
+    uint32_t min_div = div_floor();
+
+    if (!words)
+        return;
+
+    uint32_t irq = save_and_disable_interrupts();
+    uint64_t start = time_us_64();
+
+    uint32_t reference = checksum(p, words); // Boot setting: the code running now was read with it
+
+    for (uint32_t div = FLASHCAL_DIV_MAX; div >= min_div; div -= FLASHCAL_DIV_STEP)
+    {
+        bool found = false;
+        for (uint32_t dly = 0; dly <= FLASHCAL_DLY_MAX && !found; dly++)
+        {
+            set_timing(div, dly);
+            found = stable(p, words, reference);
+            if (found)
+            {
+                if (fast_div)
+                {
+                    best_div = fast_div; // One step slower than the new fastest one
+                    best_dly = fast_dly;
+                }
+                else
+                {
+                    best_div = div; // Only the slowest divider passed so far: no slower one to fall back to
+                    best_dly = dly;
+                }
+                fast_div = div;
+                fast_dly = dly;
+            }
+        }
+        if (!found)
+            break; // Faster dividers will not do better
+    }
+
+    set_timing(best_div, best_dly);
+    uint32_t elapsed = (uint32_t)(time_us_64() - start);
+    restore_interrupts(irq);
+
+    printf("Flash timing: " TIMING_NAMES " (fastest stable %lu, rated limit %lu, %lu us)\n",
+           (unsigned long)boot_div, (unsigned long)boot_dly, (unsigned long)best_div, (unsigned long)best_dly,
+           (unsigned long)fast_div, (unsigned long)min_div, (unsigned long)elapsed);
+}
@@ -0,0 +1,38 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// flashcal.h - Boot time flash timing calibration for the MSX PICOVERSE multirom firmware
+//
+// The ROMs are served from XIP flash, so the flash clock directly sets the timing margin of every flash served
+// mapper loop. At boot, while the MSX is held with WAIT, the flash interface is swept from a slow setting to faster
+// ones, never past the FLASHCAL_SCK_MAX_KHZ rating of the flash at the current system clock. Each setting must read
+// the ROM region back with the checksum taken at the boot setting, FLASHCAL_PASSES times in a row. The setting one
+// divider step slower than the fastest stable one is kept, as margin for temperature and supply drift.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef FLASHCAL_H
+#define FLASHCAL_H
+
+#include <stdint.h>
+
+#define FLASHCAL_BYTES      (64 * 1024) // Size of the ROM region checked at each setting
+#define FLASHCAL_PASSES     4           // Consecutive good reads required to accept a setting
+#define FLASHCAL_SCK_MAX_KHZ 133000     // Highest SCK of the W25Q flash of the Pico boards (quad I/O fast read)
+#if PICO_RP2350
+#define FLASHCAL_DIV_MAX    6           // Slowest QMI clock divider tried
+#define FLASHCAL_DIV_MIN    1           // Fastest QMI clock divider, see FLASHCAL_SCK_MAX_KHZ
+#define FLASHCAL_DIV_STEP   1
+#define FLASHCAL_DLY_MAX    7           // Largest RX delay tried, in half system clock cycles
+#else
+#define FLASHCAL_DIV_MAX    8           // Slowest SSI baud divider tried
+#define FLASHCAL_DIV_MIN    2           // Fastest SSI baud divider (BAUDR must be even), see FLASHCAL_SCK_MAX_KHZ
+#define FLASHCAL_DIV_STEP   2
+#define FLASHCAL_DLY_MAX    3           // Largest RX sample delay tried, in system clock cycles
+#endif
+
+void flashcal_run(const uint8_t *region, uint32_t size);
+
+#endif
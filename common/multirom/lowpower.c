@@ -0,0 +1,39 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// lowpower.c - Sleep and read timing counters of the LOW_POWER_MAPPER loops
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "lowpower.h"
+
+volatile lowpower_stats_t lowpower_stats;
+
+// lowpower_report - Print the counters of the last LOWPOWER_REPORT_US over USB, when a read was served meanwhile
+// The counters are written by the sleeping loops and only read here, so the deltas are taken against the values
+// of the previous report instead of clearing them.
+void lowpower_report()
+{
+    static uint32_t last_time = 0;
+    static lowpower_stats_t last;
+
+    uint32_t now = time_us_32();
+    uint32_t elapsed = now - last_time;
+    if (elapsed < LOWPOWER_REPORT_US)
+        return;
+
+    lowpower_stats_t stats = lowpower_stats;
+    if (last_time && stats.reads != last.reads)
+    {
+        printf("Low power: %lu reads, %lu late, asleep core 0 %lu%% core 1 %lu%%\n",
+               (unsigned long)(stats.reads - last.reads), (unsigned long)(stats.late - last.late),
+               (unsigned long)((uint64_t)(stats.slept[0] - last.slept[0]) * 100 / elapsed),
+               (unsigned long)((uint64_t)(stats.slept[1] - last.slept[1]) * 100 / elapsed));
+    }
+    last_time = now;
+    last = stats;
+}
@@ -0,0 +1,65 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// lowpower.h - Sleep and read timing counters of the LOW_POWER_MAPPER loops
+//
+// With LOW_POWER_MAPPER set the bus loops sleep in WFE until a state machine, a GPIO edge or the other core wakes
+// them, instead of polling the bus. What that costs is counted on the device, so a build with the option set reports
+// over USB, once per second, how it behaves on the machine it runs in:
+//
+// - reads: read cycles served from a wake up.
+// - late:  reads whose byte was queued after /RD had already gone high. The MSX read an undriven bus, and the output
+//          state machine keeps the byte for the next read cycle it sees. Any late read means the wake up path is too
+//          slow for that bus, and the option must stay off there.
+// - asleep: the part of the time each core spent in WFE, the share of the polling loop current that is saved.
+//
+// The current draw itself still takes a bench supply: these counters give the sleep ratio and the margin, not mA.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef LOWPOWER_H
+#define LOWPOWER_H
+
+#include <stdint.h>
+#include "pico/stdlib.h"
+#include "hardware/sync.h"
+#include "hardware/structs/timer.h"
+#include "board.h"
+
+#define LOWPOWER_REPORT_US      1000000                 // Interval between two USB reports
+
+// Counters since power on, free running
+// reads - Read cycles served by the sleeping loops
+// late  - Of those, the ones queued after /RD went high
+// slept - Time spent in WFE by each core, in microseconds
+typedef struct {
+    uint32_t reads;
+    uint32_t late;
+    uint32_t slept[2];
+} lowpower_stats_t;
+
+extern volatile lowpower_stats_t lowpower_stats;
+
+void lowpower_report();
+
+// lowpower_sleep - Sleep in WFE and count the time asleep for the calling core
+// The timer is read once on each side of WFE, a single peripheral load on the wake up path.
+static inline void __not_in_flash_func(lowpower_sleep)(uint core)
+{
+    uint32_t start = timer_hw->timerawl;
+    __wfe();
+    lowpower_stats.slept[core] += timer_hw->timerawl - start;
+}
+
+// lowpower_served - Count a read cycle whose byte was just queued for the output state machine
+// Called right after the push: /RD already high means the cycle ended before the byte could be driven.
+static inline void __not_in_flash_func(lowpower_served)()
+{
+    lowpower_stats.reads++;
+    if (bus_sample() & BUS_RD_MASK)
+        lowpower_stats.late++;
+}
+
+#endif
@@ -0,0 +1,285 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// mapper.c - Table driven mapper engine for the MSX PICOVERSE multirom firmware
+//
+// The tables built here reproduce the bank layouts documented on each mapper below. The bus loop only indexes
+// them, so adding a mapper means adding a layout to mapper_init and nothing else.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <string.h>
+#if PICO_ON_DEVICE
+#include "pico/stdlib.h"
+#else
+#include <stdint.h>
+#define __not_in_flash_func(f) f   // Host build (tool/src/mappertest.c of the RP2350 multirom)
+#endif
+#include "mapper.h"
+#if MAPPER_SEGCACHE
+#include "segcache.h"
+#endif
+#if MAPPER_SAVE
+#include "save.h"
+#endif
+
+// map_fixed - Map the ROM linearly on pages first..last
+// The first ROM byte is served at MSX address first * 0x2000.
+static void map_fixed(mapper_t *m, uint8_t first, uint8_t last)
+{
+    for (uint8_t p = first; p <= last; p++)
+        m->page[p] = (const uint8_t *)((uintptr_t)m->base - (first << 13));
+}
+
+// add_bank - Declare bank register index driving the given number of pages from page, with its initial segment
+static void add_bank(mapper_t *m, uint8_t index, uint8_t page, uint8_t pages, uint16_t value)
+{
+    m->bank[index].page = page;
+    m->bank[index].pages = pages;
+    mapper_set_bank(m, index, value);
+}
+
+// add_write - Make writes to the 2KB region starting at addr update bank register index
+static void add_write(mapper_t *m, uint8_t index, uint16_t addr)
+{
+    m->write_action[addr >> 11] = index;
+}
+
+// mapper_set_bank - Store a bank register value and rebuild the page pointers it drives
+// The pointers are pre-biased by the page base so the read path does not need to mask the address.
+// When the segment cache is attached, each page first points to the flash copy so it is right at once, and is
+// then moved to the SRAM copy of its 8KB segment (the MSX is held with WAIT if the segment has to be loaded).
+void __not_in_flash_func(mapper_set_bank)(mapper_t *m, uint8_t index, uint16_t value)
+{
+    mapper_bank_t *bank = &m->bank[index];
+    uint8_t pages = ((1 << bank->pages) - 1) << bank->page;
+    bank->value = value;
+    if (m->sram && (value & m->sram_bit))
+    {
+        // Save RAM selected: the pages point to its copy mirrored over the bank
+        for (uint8_t i = 0; i < bank->pages; i++)
+            m->page[bank->page + i] = (const uint8_t *)((uintptr_t)m->sram - ((uint32_t)bank->page << 13));
+        m->sram_pages |= pages;
+        return;
+    }
+    m->sram_pages &= ~pages;
+
+    if (m->segments && value >= m->segments)
+        value %= m->segments; // Preloaded image: never point outside of the SRAM copy
+    uintptr_t segment = (uintptr_t)m->base + ((uint32_t)value << m->seg_shift) - ((uint32_t)bank->page << 13);
+
+    m->page[bank->page] = (const uint8_t *)segment;
+    if (bank->pages > 1)
+        m->page[bank->page + 1] = (const uint8_t *)segment;
+
+#if MAPPER_SEGCACHE
+    if (m->cached)
+    {
+        uint32_t first = (uint32_t)value << (m->seg_shift - SEGCACHE_SEG_SHIFT); // First 8KB segment of the bank
+        for (uint8_t i = 0; i < bank->pages; i++)
+        {
+            uint8_t p = bank->page + i;
+            m->page[p] = (const uint8_t *)((uintptr_t)segcache_map(&m->slot[p], first + i) - ((uint32_t)p << 13));
+        }
+    }
+#endif
+}
+
+#if MAPPER_SEGCACHE
+// mapper_attach_cache - Serve the banked pages of a mapper from the SRAM segment cache
+// Parameters:
+//   m     - Mapper state built by mapper_init
+//   size  - Size of the ROM image in bytes
+//   fixed - Also copy the fixed pages (plain and linear ROMs) to SRAM, otherwise they are served from flash
+void mapper_attach_cache(mapper_t *m, uint32_t size, bool fixed)
+{
+    uint8_t banked = 0; // Pages driven by a bank register
+
+    segcache_init(m->base, size);
+    memset(m->slot, SEGCACHE_NONE, sizeof(m->slot));
+    m->cached = true;
+
+    for (uint8_t i = 0; i < MAPPER_MAX_BANKS; i++)
+    {
+        if (m->bank[i].pages)
+        {
+            mapper_set_bank(m, i, m->bank[i].value); // Load the initial segments
+            banked |= ((1 << m->bank[i].pages) - 1) << m->bank[i].page;
+        }
+    }
+
+    for (uint8_t p = 0; fixed && p < MAPPER_PAGES; p++)
+    {
+        if (!m->page[p] || (banked & (1 << p)))
+            continue;
+        uint32_t segment = ((uintptr_t)m->page[p] + ((uint32_t)p << 13) - (uintptr_t)m->base) >> SEGCACHE_SEG_SHIFT;
+        m->page[p] = (const uint8_t *)((uintptr_t)segcache_map(&m->slot[p], segment) - ((uint32_t)p << 13));
+    }
+}
+#endif
+
+// mapper_attach_sram - Serve a mapper whose base is a whole ROM image preloaded in SRAM
+// Bank values beyond the image wrap around it, as the incomplete decoding of a real cartridge mirrors them, so
+// that a bank register write can not move a page outside of the copy.
+// Parameters:
+//   m    - Mapper state built by mapper_init on the SRAM copy
+//   size - Size of the ROM image in bytes
+void mapper_attach_sram(mapper_t *m, uint32_t size)
+{
+    uint32_t segments = (size + (1 << m->seg_shift) - 1) >> m->seg_shift;
+    m->segments = segments ? segments : 1;
+
+    for (uint8_t i = 0; i < MAPPER_MAX_BANKS; i++)
+    {
+        if (m->bank[i].pages)
+            mapper_set_bank(m, i, m->bank[i].value);
+    }
+}
+
+#if MAPPER_SAVE
+// mapper_attach_save - Give the save RAM buffer to a mapper with save RAM
+// The save RAM is selected by the first bank value beyond the ROM (ASCII8) or by bit 4 (ASCII16), as the address
+// decoding of those cartridges does.
+// Parameters:
+//   m    - Mapper state built by mapper_init
+//   sram - Save RAM filled by save_attach, mirrored over a whole bank
+//   size - Size of the ROM image in bytes
+void mapper_attach_save(mapper_t *m, uint8_t *sram, uint32_t size)
+{
+    uint16_t bit = 1;
+    while (m->seg_shift == 13 && bit < (size >> 13))
+        bit <<= 1;
+    m->sram = sram;
+    m->sram_bit = (m->seg_shift == 13) ? bit : 0x10;
+
+    for (uint8_t i = 0; i < MAPPER_MAX_BANKS; i++)
+    {
+        if (m->bank[i].pages)
+            mapper_set_bank(m, i, m->bank[i].value);
+    }
+}
+
+// mapper_sram_write - Store a byte in the save RAM and in all of its mirrors, and mark it for persistence
+void __not_in_flash_func(mapper_sram_write)(mapper_t *m, uint16_t addr, uint8_t data)
+{
+    uint16_t offset = addr & (m->sram_size - 1);
+    for (uint32_t o = offset; o < (1u << m->seg_shift); o += m->sram_size)
+        m->sram[o] = data;
+    save_touch(offset);
+}
+#endif
+
+// mapper_init - Build the page and write action tables for a mapper
+// Parameters:
+//   m      - Mapper state to initialize
+//   mapper - Mapper code from the ROM record
+//   base   - Pointer to the first byte of the ROM image
+// Returns:
+//   true if the mapper is supported, false otherwise
+bool mapper_init(mapper_t *m, uint8_t mapper, const uint8_t *base)
+{
+    memset(m, 0, sizeof(mapper_t));
+    memset(m->write_action, MAPPER_WR_NONE, sizeof(m->write_action));
+    m->base = base;
+    m->seg_shift = 13;
+
+    switch (mapper)
+    {
+        // Plain 16/32KB ROM: 0x4000-0xBFFF, no bank registers
+        case MAPPER_PLAIN16:
+        case MAPPER_PLAIN32:
+            map_fixed(m, 2, 5);
+            break;
+
+        // Linear0 48KB ROM: 0x0000-0xBFFF, no bank registers
+        case MAPPER_LINEAR48:
+            map_fixed(m, 0, 5);
+            break;
+
+        // Konami SCC: 8KB banks at 4000h, 6000h, 8000h, A000h switched at 5000h, 7000h, 9000h, B000h
+        case MAPPER_KONAMISCC:
+            for (uint8_t i = 0; i < 4; i++)
+            {
+                add_bank(m, i, 2 + i, 1, i);
+                add_write(m, i, 0x5000 + (i << 13));
+            }
+            break;
+
+        // Konami without SCC: bank 1 fixed, banks 2-4 switched at 6000h, 8000h, A000h
+        case MAPPER_KONAMI:
+            for (uint8_t i = 0; i < 4; i++)
+                add_bank(m, i, 2 + i, 1, i);
+            add_write(m, 1, 0x6000);
+            add_write(m, 2, 0x8000);
+            add_write(m, 3, 0xA000);
+            break;
+
+#if MAPPER_SAVE
+        // ASCII8 with 8KB of save RAM: the RAM is selected like a segment and can be written at 8000h-BFFFh
+        case MAPPER_ASCII8_SRAM:
+            m->sram_size = 0x2000;
+            m->sram_write = 0x30;
+            // fall through
+#endif
+
+        // ASCII8: 8KB banks at 4000h, 6000h, 8000h, A000h switched at 6000h, 6800h, 7000h, 7800h
+        case MAPPER_ASCII8:
+            for (uint8_t i = 0; i < 4; i++)
+            {
+                add_bank(m, i, 2 + i, 1, i);
+                add_write(m, i, 0x6000 + (i << 11));
+            }
+            break;
+
+#if MAPPER_SAVE
+        // ASCII16 with 2KB of save RAM: the RAM is mirrored over the bank and can be written at 8000h-BFFFh
+        case MAPPER_ASCII16_SRAM:
+            m->sram_size = 0x0800;
+            m->sram_write = 0x30;
+            // fall through
+#endif
+
+        // ASCII16: 16KB banks at 4000h and 8000h switched at 6000h and 7000h
+        case MAPPER_ASCII16:
+            m->seg_shift = 14;
+            add_bank(m, 0, 2, 2, 0);
+            add_bank(m, 1, 4, 2, 1);
+            add_write(m, 0, 0x6000);
+            add_write(m, 1, 0x7000);
+            break;
+
+        // NEO8: six 8KB banks on 0000h-BFFFh switched at 5000h, 5800h, 6000h, 6800h, 7000h, 7800h
+        // (mirrors at 1000h and 9000h based addresses). C000h-FFFFh is not mapped: the data bus is left to the
+        // pull-ups instead of being driven with FFh as the former per mapper loops did, which reads the same.
+        case MAPPER_NEO8:
+            m->wide = true;
+            for (uint8_t i = 0; i < 6; i++)
+            {
+                add_bank(m, i, i, 1, 0);
+                add_write(m, i, 0x1000 + (i << 11));
+                add_write(m, i, 0x5000 + (i << 11));
+                add_write(m, i, 0x9000 + (i << 11));
+            }
+            break;
+
+        // NEO16: three 16KB banks on 0000h-BFFFh switched at 5000h, 6000h, 7000h
+        // (mirrors at 1000h and 9000h based addresses), C000h-FFFFh is not mapped as for NEO8
+        case MAPPER_NEO16:
+            m->wide = true;
+            m->seg_shift = 14;
+            for (uint8_t i = 0; i < 3; i++)
+            {
+                add_bank(m, i, i << 1, 2, 0);
+                add_write(m, i, 0x1000 + (i << 12));
+                add_write(m, i, 0x5000 + (i << 12));
+                add_write(m, i, 0x9000 + (i << 12));
+            }
+            break;
+
+        default:
+            return false;
+    }
+    return true;
+}
@@ -0,0 +1,120 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// mapper.h - Table driven mapper engine for the MSX PICOVERSE multirom firmware
+//
+// Every supported mapper is described by two tables. The page table holds one read pointer per 8KB page of the
+// MSX address space (addr >> 13) and the write action table holds one entry per 2KB region (addr >> 11) telling
+// which bank register, if any, a write to that region updates. Bank register writes rebuild the affected page
+// pointers, so serving a read is reduced to page[addr >> 13][addr].
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef MAPPER_H
+#define MAPPER_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "mapper_codes.h"
+
+#define MAPPER_PAGES        8       // 8KB pages in the 64KB MSX address space
+#define MAPPER_WR_REGIONS   32      // 2KB write regions in the 64KB MSX address space
+#define MAPPER_MAX_BANKS    6       // Maximum number of bank registers (NEO8)
+#define MAPPER_WR_NONE      0xFF    // Write action: region does not hold a bank register
+
+// Optional parts of the engine, the loadrom firmwares build it without both
+#ifndef MAPPER_SEGCACHE
+#define MAPPER_SEGCACHE     1               // Flash images served through the SRAM segment cache (segcache.c)
+#endif
+#ifndef MAPPER_SAVE
+#define MAPPER_SAVE         PICO_RP2350     // Save RAM of the ASCII8/ASCII16 SRAM mappers (save.c of the RP2350 multirom)
+#endif
+
+// Bank register state
+// value - Current segment number
+// page  - First 8KB page of the MSX address space driven by this register
+// pages - Number of 8KB pages driven by this register (1 for 8KB segments, 2 for 16KB segments)
+typedef struct {
+    uint16_t value;
+    uint8_t  page;
+    uint8_t  pages;
+} mapper_bank_t;
+
+// Mapper state
+// page         - Read pointer per 8KB page, pre-biased by the page base so that page[addr >> 13][addr] is the ROM byte.
+//                NULL means the cartridge does not answer reads on that page. The pointers are volatile because bank
+//                register writes may be applied by another core or an interrupt while the read loop is running.
+// write_action - Bank register index per 2KB region or MAPPER_WR_NONE
+// base         - Start of the ROM image
+// seg_shift    - log2 of the segment size (13 for 8KB segments, 14 for 16KB segments)
+// wide         - Bank registers are 12-bit wide with LSB/MSB selected by A0 (NEO8/NEO16)
+// cached       - Banked pages are served from the SRAM segment cache (see segcache.h)
+// segments     - Number of segments of the image when it is preloaded in SRAM, bank values wrap on it (0: no wrap)
+// slot         - Segment cache slot mapped by each page when cached
+// sram         - Save RAM mirrored over a whole bank (see save.h, RP2350 only), NULL when the cartridge has none
+// sram_size    - Size of the save RAM emulated by the mapper, 0 when the cartridge has none
+// sram_bit     - Bank value bit selecting the save RAM instead of a ROM segment
+// sram_pages   - Pages currently mapping the save RAM
+// sram_write   - Pages where the save RAM can be written when it is mapped
+typedef struct {
+    const uint8_t * volatile page[MAPPER_PAGES];
+    uint8_t write_action[MAPPER_WR_REGIONS];
+    mapper_bank_t bank[MAPPER_MAX_BANKS];
+    const uint8_t *base;
+    uint8_t seg_shift;
+    bool wide;
+    bool cached;
+    uint8_t slot[MAPPER_PAGES];
+    uint16_t segments;
+    uint8_t *sram;
+    uint16_t sram_size;
+    uint16_t sram_bit;
+    uint8_t sram_pages;
+    uint8_t sram_write;
+} mapper_t;
+
+bool mapper_init(mapper_t *m, uint8_t mapper, const uint8_t *base);
+void mapper_set_bank(mapper_t *m, uint8_t index, uint16_t value);
+#if MAPPER_SEGCACHE
+void mapper_attach_cache(mapper_t *m, uint32_t size, bool fixed);
+#endif
+void mapper_attach_sram(mapper_t *m, uint32_t size);
+#if MAPPER_SAVE
+void mapper_attach_save(mapper_t *m, uint8_t *sram, uint32_t size);
+void mapper_sram_write(mapper_t *m, uint16_t addr, uint8_t data);
+#endif
+
+// mapper_read_ptr - Return the pointer that serves a read of addr, or NULL if the address is not mapped
+static inline const uint8_t *mapper_read_ptr(const mapper_t *m, uint16_t addr)
+{
+    const uint8_t *p = m->page[addr >> 13];
+    return p ? p + addr : NULL;
+}
+
+// mapper_write - Apply a write cycle to the mapper registers
+// Writes to regions without a bank register are ignored, unless they fall in a writable page mapping the save RAM.
+static inline void mapper_write(mapper_t *m, uint16_t addr, uint8_t data)
+{
+    uint8_t action = m->write_action[addr >> 11];
+    if (action == MAPPER_WR_NONE)
+    {
+#if MAPPER_SAVE
+        if (m->sram_pages & m->sram_write & (1 << (addr >> 13)))
+            mapper_sram_write(m, addr, data);
+#endif
+        return;
+    }
+
+    uint16_t value = data;
+    if (m->wide)
+    {
+        uint16_t current = m->bank[action].value;
+        value = (addr & 0x01) ? ((current & 0x00FF) | (data << 8)) : ((current & 0xFF00) | data); // A0 selects MSB/LSB
+        value &= 0x0FFF; // Ensure reserved MSB bits are zero
+    }
+    mapper_set_bank(m, action, value);
+}
+
+#endif
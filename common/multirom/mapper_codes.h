@@ -0,0 +1,52 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// mapper_codes.h - Mapper codes of the MSX PICOVERSE ROM records
+//
+// Single table of the mapper codes written by the PC tools (multirom, loadrom, usbload) and read by the multirom
+// and loadrom firmwares. Plain C, so the tools include it too. A code is never reused: a firmware that does not
+// serve a mapper rejects its code.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef MAPPER_CODES_H
+#define MAPPER_CODES_H
+
+#define MAPPER_PLAIN16      1
+#define MAPPER_PLAIN32      2
+#define MAPPER_KONAMISCC    3
+#define MAPPER_LINEAR48     4
+#define MAPPER_ASCII8       5
+#define MAPPER_ASCII16      6
+#define MAPPER_KONAMI       7
+#define MAPPER_NEO8         8
+#define MAPPER_NEO16        9
+#define MAPPER_ASCII8_SRAM  10      // ASCII8 with 8KB of battery backed save RAM (RP2350 multirom only)
+#define MAPPER_ASCII16_SRAM 11      // ASCII16 with 2KB of battery backed save RAM (RP2350 multirom only)
+#define MAPPER_DSK          12      // DSK disk image, booted through the WD2793 disk ROM (RP2350 multirom only)
+#define MAPPER_CAS          13      // CAS cassette image, loaded through the CAS loader ROM (RP2350 multirom only)
+#define MAPPER_MEGARAM      14      // Writable SRAM pages, the image is their initial content (loadrom only)
+#define MAPPER_LAST         14      // Highest mapper code
+
+// Names of the mapper codes, index 0 for an unknown code, e.g. const char *rom_types[] = MAPPER_NAMES;
+#define MAPPER_NAMES { \
+    "Unknown ROM type", \
+    "Plain16", \
+    "Plain32", \
+    "KonamiS", \
+    "Linear0", \
+    "ASCII8", \
+    "ASCII16", \
+    "Konami", \
+    "NEO8", \
+    "NEO16", \
+    "ASCII8SRAM", \
+    "ASCII16SRAM", \
+    "DSK", \
+    "CAS", \
+    "MegaRAM" \
+}
+
+#endif
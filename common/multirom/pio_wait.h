@@ -0,0 +1,40 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// pio_wait.h - Load the bus PIO programs with their GPIO waits on the strobes of the board
+//
+// The PIO programs cannot include board.h: their WAIT GPIO instructions are written with a placeholder index and
+// the *_add_program() helper of each program moves them to the strobe given by board.h (PIN_RD or PIN_WR) when the
+// program is loaded, so the same program runs on both boards.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef PIO_WAIT_H
+#define PIO_WAIT_H
+
+#include "hardware/pio.h"
+
+// pio_add_program_wait_gpio - Load a PIO program with every WAIT GPIO instruction moved to pin
+// Parameters:
+//   pio     - PIO block to load the program into
+//   program - Program whose WAIT GPIO instructions all wait on the same strobe
+//   pin     - GPIO of that strobe on this board
+// Returns the offset of the program in the PIO instruction memory, as pio_add_program.
+static inline uint pio_add_program_wait_gpio(PIO pio, const pio_program_t *program, uint pin)
+{
+    uint16_t code[program->length];
+    pio_program_t patched = *program;
+
+    for (uint i = 0; i < patched.length; i++)
+    {
+        code[i] = program->instructions[i];
+        if ((code[i] & 0xE060) == 0x2000) // WAIT on a GPIO: keep the polarity and delay, replace the index
+            code[i] = (code[i] & ~0x001F) | (pin & 0x1F);
+    }
+    patched.instructions = code;
+    return pio_add_program(pio, &patched);
+}
+
+#endif
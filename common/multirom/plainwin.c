@@ -0,0 +1,26 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// plainwin.c - 64KB window layout of the plain ROMs served by PIO and DMA
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <string.h>
+#include "plainwin.h"
+
+// plain_window_build - Lay out a plain ROM in a 64KB window exactly as the MSX sees it
+// Parameters:
+//   window    - 64KB destination, indexed by the MSX address
+//   image     - Pointer to the ROM image
+//   size      - Size of the ROM image in bytes
+//   base_addr - MSX address of the first ROM byte (0x4000 for 16/32KB ROMs, 0x0000 for 48KB Linear0 ROMs)
+// Addresses not covered by the ROM read as 0xFF, like an empty bus. Nothing is mapped from PLAINWIN_END.
+void plain_window_build(uint8_t *window, const uint8_t *image, uint32_t size, uint16_t base_addr)
+{
+    uint32_t max_size = PLAINWIN_END - base_addr;
+
+    memset(window, 0xFF, PLAINWIN_SIZE);
+    memcpy(window + base_addr, image, (size > max_size) ? max_size : size);
+}
@@ -0,0 +1,24 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// plainwin.h - 64KB window layout of the plain ROMs served by PIO and DMA
+//
+// Plain 16/32KB and 48KB Linear0 ROMs are served from a 64KB SRAM window indexed by the MSX address, so the DMA
+// read path needs no mapper. The layout only uses the C library, so the host check of the multirom tool
+// (tool/src/plainwintest.c) builds the same code as the RP2350 multirom and loadrom firmwares.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef PLAINWIN_H
+#define PLAINWIN_H
+
+#include <stdint.h>
+
+#define PLAINWIN_SIZE       0x10000     // The whole MSX address space
+#define PLAINWIN_END        0xC000      // Nothing is mapped from here
+
+void plain_window_build(uint8_t *window, const uint8_t *image, uint32_t size, uint16_t base_addr);
+
+#endif
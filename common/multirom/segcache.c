@@ -0,0 +1,237 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// segcache.c - SRAM cache of 8KB ROM segments for the MSX PICOVERSE multirom firmware
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include <string.h>
+#include "pico/stdlib.h"
+#include "hardware/dma.h"
+#include "hardware/pio.h"
+#include "segcache.h"
+#if SEGCACHE_XIP_PINNED
+#include "hardware/structs/xip_ctrl.h"
+#include "hardware/regs/addressmap.h"
+#endif
+#include "multirom.h"
+
+static uint8_t cache[SEGCACHE_SLOTS][SEGCACHE_SEG_SIZE] __attribute__((aligned(4))); // Segment copies
+static uint16_t slot_segment[SEGCACHE_ALL_SLOTS];      // Segment held by each slot, 0xFFFF if free
+static uint8_t slot_users[SEGCACHE_ALL_SLOTS];         // Number of MSX pages currently mapped on each slot
+static uint8_t slot_ref[SEGCACHE_ALL_SLOTS];           // Clock reference bit
+static uint8_t segment_slot[SEGCACHE_MAX_SEGMENTS];    // Slot holding each segment or SEGCACHE_NONE
+static uint8_t hand;                                   // Clock hand
+static const uint8_t *rom_image;                       // ROM image in flash
+static uint32_t rom_segments;                          // Number of cacheable segments in the ROM image
+static int dma_chan = -1;                              // DMA channel copying segments from flash
+
+segcache_stats_t segcache_stats;
+
+// slot_data - Storage of a slot: SRAM for the regular slots, the XIP cache memory for the pinned ones
+static inline uint8_t *slot_data(uint8_t s)
+{
+#if SEGCACHE_XIP_PINNED
+    if (s >= SEGCACHE_SLOTS)
+        return (uint8_t *)XIP_SRAM_BASE + ((uint32_t)(s - SEGCACHE_SLOTS) << SEGCACHE_SEG_SHIFT);
+#endif
+    return cache[s];
+}
+
+static void load(uint8_t s, uint32_t segment);
+
+// segcache_init - Empty the cache and attach it to a ROM image
+// Parameters:
+//   image - Pointer to the first byte of the ROM image in flash
+//   size  - Size of the ROM image in bytes
+void segcache_init(const uint8_t *image, uint32_t size)
+{
+    memset(slot_segment, 0xFF, sizeof(slot_segment));
+    memset(slot_users, 0, sizeof(slot_users));
+    memset(slot_ref, 0, sizeof(slot_ref));
+    memset(segment_slot, SEGCACHE_NONE, sizeof(segment_slot));
+    memset(&segcache_stats, 0, sizeof(segcache_stats));
+    hand = 0;
+
+    rom_image = image;
+    rom_segments = (size + SEGCACHE_SEG_SIZE - 1) >> SEGCACHE_SEG_SHIFT;
+    if (rom_segments > SEGCACHE_MAX_SEGMENTS)
+        rom_segments = SEGCACHE_MAX_SEGMENTS;
+
+    if (dma_chan < 0)
+        dma_chan = dma_claim_unused_channel(true);
+
+    gpio_init(PIN_WAIT); // Init wait signal pin
+    gpio_set_dir(PIN_WAIT, GPIO_OUT); // Set the WAIT signal as output
+    gpio_put(PIN_WAIT, 1); // Released, only asserted while a segment is copied
+
+#if SEGCACHE_XIP_PINNED
+    xip_ctrl_hw->ctrl &= ~XIP_CTRL_EN_BITS; // The XIP cache memory becomes plain SRAM at XIP_SRAM_BASE
+    for (uint8_t i = 0; i < SEGCACHE_PINNED_SLOTS && i < rom_segments; i++)
+        load(SEGCACHE_SLOTS + i, i); // Never visited by the clock hand, so never evicted
+#endif
+}
+
+// evict - Pick the slot that will receive a new segment
+// The clock hand skips slots mapped by a bank register and gives a second chance to recently selected ones.
+// There are more slots than MSX pages, so a free slot is always found.
+static uint8_t __not_in_flash_func(evict)()
+{
+    while (true)
+    {
+        uint8_t s = hand;
+        hand = (hand + 1) % SEGCACHE_SLOTS;
+
+        if (slot_users[s])
+            continue;
+        if (slot_ref[s])
+        {
+            slot_ref[s] = 0;
+            continue;
+        }
+        if (slot_segment[s] != 0xFFFF)
+        {
+            segment_slot[slot_segment[s]] = SEGCACHE_NONE;
+            segcache_stats.evictions++;
+        }
+        return s;
+    }
+}
+
+// load - Copy a segment from flash into a slot while the MSX is held with WAIT
+static void __not_in_flash_func(load)(uint8_t s, uint32_t segment)
+{
+    const uint8_t *src = rom_image + (segment << SEGCACHE_SEG_SHIFT);
+    bool aligned = !((uintptr_t)src & 0x03); // ROM offsets in the records are not always word aligned
+
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&c, aligned ? DMA_SIZE_32 : DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, true);
+
+    gpio_put(PIN_WAIT, 0); // Hold the MSX until the segment is in SRAM
+    dma_channel_configure(dma_chan, &c, slot_data(s), src, aligned ? SEGCACHE_SEG_SIZE / 4 : SEGCACHE_SEG_SIZE, true);
+    dma_channel_wait_for_finish_blocking(dma_chan);
+    gpio_put(PIN_WAIT, 1); // Lets go!
+
+    slot_segment[s] = segment;
+    segment_slot[segment] = s;
+}
+
+// segcache_map - Map an 8KB segment for one MSX page
+// Parameters:
+//   slot    - Slot mapped so far by the page, released and replaced by the slot of the new segment
+//   segment - 8KB segment number in the ROM image
+// Returns:
+//   Pointer to the SRAM copy of the segment, or to the flash copy for segments beyond the ROM image
+const uint8_t *__not_in_flash_func(segcache_map)(uint8_t *slot, uint32_t segment)
+{
+    if (*slot != SEGCACHE_NONE)
+        slot_users[*slot]--;
+    *slot = SEGCACHE_NONE;
+
+    if (segment >= rom_segments)
+        return rom_image + (segment << SEGCACHE_SEG_SHIFT); // Not cached, served from flash as before
+
+    uint8_t s = segment_slot[segment];
+    if (s != SEGCACHE_NONE)
+    {
+        segcache_stats.hits++;
+    }
+    else
+    {
+        segcache_stats.misses++;
+        s = evict();
+        load(s, segment);
+    }
+
+    slot_ref[s] = 1;
+    slot_users[s]++;
+    *slot = s;
+    return slot_data(s);
+}
+
+// segcache_preload - Copy a whole ROM image into the slot storage while the MSX is held with WAIT
+// The cache is left unused: the image is served linearly from the copy.
+// Parameters:
+//   image - Pointer to the first byte of the ROM image in flash
+//   size  - Size of the ROM image in bytes
+// Returns:
+//   Pointer to the SRAM copy, or NULL if the image does not fit in SEGCACHE_POOL_SIZE
+const uint8_t *segcache_preload(const uint8_t *image, uint32_t size)
+{
+    return segcache_preload_at(image, size, 0);
+}
+
+// segcache_preload_at - Copy a whole ROM image into the slot storage, starting at byte at of the storage
+// Lets several images share the storage (see expander.h). The cache is left unused.
+// Parameters:
+//   image - Pointer to the first byte of the ROM image in flash
+//   size  - Size of the ROM image in bytes
+//   at    - Offset of the copy in the slot storage, a multiple of 4
+// Returns:
+//   Pointer to the SRAM copy, or NULL if the image does not fit in the storage left after at
+const uint8_t *segcache_preload_at(const uint8_t *image, uint32_t size, uint32_t at)
+{
+    if (at > SEGCACHE_POOL_SIZE || size > SEGCACHE_POOL_SIZE - at)
+        return NULL;
+
+    if (dma_chan < 0)
+        dma_chan = dma_claim_unused_channel(true);
+
+    bool aligned = !((uintptr_t)image & 0x03) && !(size & 0x03); // ROM offsets in the records are not always word aligned
+    dma_channel_config c = dma_channel_get_default_config(dma_chan);
+    channel_config_set_transfer_data_size(&c, aligned ? DMA_SIZE_32 : DMA_SIZE_8);
+    channel_config_set_read_increment(&c, true);
+    channel_config_set_write_increment(&c, true);
+    uint8_t *dest = &cache[0][0] + at;
+
+    gpio_init(PIN_WAIT); // Init wait signal pin
+    gpio_set_dir(PIN_WAIT, GPIO_OUT); // Set the WAIT signal as output
+    gpio_put(PIN_WAIT, 0); // Hold the MSX until the whole ROM is in SRAM
+    dma_channel_configure(dma_chan, &c, dest, image, aligned ? size / 4 : size, true);
+    dma_channel_wait_for_finish_blocking(dma_chan);
+    gpio_put(PIN_WAIT, 1); // Lets go!
+
+    return dest;
+}
+
+// segcache_release - Give the XIP cache memory back to the flash when the ROM is left
+// The pinned slots are dropped, the cache is flushed so no line tagged before it was used as SRAM can hit, and it
+// is enabled again. Does nothing when SEGCACHE_XIP_PINNED is off.
+void segcache_release()
+{
+#if SEGCACHE_XIP_PINNED
+    for (uint8_t s = SEGCACHE_SLOTS; s < SEGCACHE_ALL_SLOTS; s++)
+    {
+        if (slot_segment[s] != 0xFFFF)
+            segment_slot[slot_segment[s]] = SEGCACHE_NONE;
+        slot_segment[s] = 0xFFFF;
+        slot_users[s] = 0;
+    }
+    xip_ctrl_hw->flush = 1;
+    (void)xip_ctrl_hw->flush; // The read stalls until the flush is complete
+    xip_ctrl_hw->ctrl |= XIP_CTRL_EN_BITS;
+#endif
+}
+
+// segcache_report - Print the cache counters over USB when they changed, at most once per SEGCACHE_REPORT_US
+void segcache_report()
+{
+    static uint32_t last_time = 0;
+    static uint32_t last_total = 0;
+
+    uint32_t now = time_us_32();
+    uint32_t total = segcache_stats.hits + segcache_stats.misses;
+    if ((now - last_time) < SEGCACHE_REPORT_US || total == last_total)
+        return;
+
+    last_time = now;
+    last_total = total;
+    printf("Segment cache: %lu hits, %lu misses, %lu evictions\n",
+           (unsigned long)segcache_stats.hits, (unsigned long)segcache_stats.misses,
+           (unsigned long)segcache_stats.evictions);
+}
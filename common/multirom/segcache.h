@@ -0,0 +1,66 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// segcache.h - SRAM cache of 8KB ROM segments for the MSX PICOVERSE multirom firmware
+//
+// Banked ROMs are served from SRAM copies of their 8KB segments instead of the XIP flash. A bank register write
+// that selects a segment which is not resident holds the MSX with WAIT while the segment is copied from flash by
+// DMA. Slots are recycled with the clock algorithm, skipping the ones currently mapped by a bank register.
+//
+// The slots are contiguous, so a ROM that fits in SEGCACHE_POOL_SIZE is instead copied whole with
+// segcache_preload and served straight from SRAM, without bank switch misses.
+//
+// With SEGCACHE_XIP_PINNED (RP2040 only) the XIP cache is disabled and its 16KB are used as two more slots, directly addressed
+// at XIP_SRAM_BASE. They are loaded once with the first two segments of the ROM (the fixed first segment of
+// Konami ROMs, the header and entry point of plain ROMs) and are never evicted. Flash reads are then uncached,
+// so every page, fixed ones included, should be mapped through the cache. The cost is paid by everything else that
+// runs from flash while the ROM is served: each code or data fetch outside of SRAM becomes a full QSPI transfer,
+// several times slower than a cache hit, so the firmware code left in flash (USB reports, the swap handling) runs
+// slowly until segcache_release flushes the cache and enables it again, after which it refills from cold.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef SEGCACHE_H
+#define SEGCACHE_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SEGCACHE_SEG_SHIFT      13                      // 8KB segments
+#define SEGCACHE_SEG_SIZE       (1 << SEGCACHE_SEG_SHIFT)
+#if PICO_RP2350
+#define SEGCACHE_SLOTS          40                      // 320KB of SRAM
+#define SEGCACHE_XIP_PINNED     0                       // The RP2350 XIP cache is not used as SRAM
+#else
+#define SEGCACHE_SLOTS          20                      // 160KB of SRAM
+#define SEGCACHE_XIP_PINNED     0                       // 1: pin the first segments in the 16KB XIP cache used as SRAM
+#endif
+#define SEGCACHE_POOL_SIZE      (SEGCACHE_SLOTS * SEGCACHE_SEG_SIZE) // Largest ROM preloaded whole
+#define SEGCACHE_MAX_SEGMENTS   1280                    // 10MB, the multirom tool MAX_ROM_SIZE
+#define SEGCACHE_PINNED_SLOTS   (SEGCACHE_XIP_PINNED ? 2 : 0)
+#define SEGCACHE_ALL_SLOTS      (SEGCACHE_SLOTS + SEGCACHE_PINNED_SLOTS)
+#define SEGCACHE_NONE           0xFF                    // No slot
+#define SEGCACHE_REPORT_US      1000000                 // Minimum interval between two USB reports
+
+// Cache counters
+// hits      - Bank register writes that selected a resident segment
+// misses    - Bank register writes that had to copy a segment from flash
+// evictions - Misses that recycled a slot holding another segment
+typedef struct {
+    uint32_t hits;
+    uint32_t misses;
+    uint32_t evictions;
+} segcache_stats_t;
+
+extern segcache_stats_t segcache_stats;
+
+void segcache_init(const uint8_t *image, uint32_t size);
+const uint8_t *segcache_map(uint8_t *slot, uint32_t segment);
+const uint8_t *segcache_preload(const uint8_t *image, uint32_t size);
+const uint8_t *segcache_preload_at(const uint8_t *image, uint32_t size, uint32_t at);
+void segcache_release();
+void segcache_report();
+
+#endif
@@ -0,0 +1,109 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// swap.c - Return to the menu and hot swap for the MSX PICOVERSE multirom firmware
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#include <stdio.h>
+#include "pico/stdlib.h"
+#include "hardware/gpio.h"
+#include "hardware/sync.h"
+#include "hardware/pio.h"
+#include "multirom.h"
+#include "swap.h"
+
+volatile bool swap_pending;
+volatile int swap_target;
+
+static volatile bool armed;             // A ROM is running, the menu is not
+static uint8_t matched;                 // Bytes of SWAP_MAGIC matched so far
+static uint32_t last_check;             // Time of the last /RD activity check
+static struct repeating_timer timer;    // Runs swap_poll while the loops sleep, see swap_timer_start
+static alarm_pool_t *timer_pool;        // Alarm pool of the core that started the timer
+
+// leave - Ask the ROM loop to stop and start catalog entry target next, or the menu for -1
+static void __not_in_flash_func(leave)(int target)
+{
+    armed = false;
+    swap_target = target;
+    swap_pending = true;
+    __sev(); // Wake up a loop sleeping in WFE
+}
+
+// swap_arm - Start watching for a reset or the magic write, called when a ROM is started
+void swap_arm()
+{
+    matched = 0;
+    swap_pending = false;
+    swap_target = -1;
+    last_check = time_us_32();
+    gpio_acknowledge_irq(PIN_RD, GPIO_IRQ_EDGE_FALL); // Only count read cycles from now on
+    armed = true;
+}
+
+// swap_feed - Match one byte written to SWAP_ADDR against the magic sequence
+void __not_in_flash_func(swap_feed)(uint8_t data)
+{
+    if (matched == sizeof(SWAP_MAGIC) - 1)
+    {
+        matched = 0;
+        if (armed)
+            leave((data == SWAP_MENU) ? -1 : data);
+        return;
+    }
+    matched = (data == (uint8_t)SWAP_MAGIC[matched]) ? matched + 1 : (data == (uint8_t)SWAP_MAGIC[0]);
+}
+
+// swap_poll - Check every SWAP_IDLE_US that the MSX is still reading memory
+// The falling edges of /RD are latched in the raw interrupt status of the pin, with the interrupt itself left
+// disabled, so the check costs one register read and does not depend on how often it is called.
+void __not_in_flash_func(swap_poll)()
+{
+    uint32_t now = time_us_32();
+    if (!armed || (now - last_check) < SWAP_IDLE_US)
+        return;
+    last_check = now;
+
+    io_rw_32 *intr = &io_bank0_hw->intr[PIN_RD / 8];
+    uint32_t fall = GPIO_IRQ_EDGE_FALL << (4 * (PIN_RD % 8));
+    if (*intr & fall)
+    {
+        *intr = fall; // Read cycles seen during the last period, clear and watch the next one
+        return;
+    }
+    leave(-1); // No read cycle at all: the MSX is in reset
+}
+
+// swap_tick - Timer callback of swap_timer_start
+static bool swap_tick(struct repeating_timer *t)
+{
+    swap_poll();
+    return true;
+}
+
+// swap_timer_start - Run the reset check every SWAP_IDLE_US from a timer interrupt
+// For the loops that sleep in WFE between bus cycles and so never call swap_poll. The timer gets its own alarm pool,
+// whose interrupt is taken by the core calling this function: the default pool would interrupt core 0, and with it
+// the read loop. The interrupt wakes that core for a few microseconds per period, a reset found there wakes every
+// loop through leave.
+void swap_timer_start()
+{
+    if (timer_pool)
+        return;
+    timer_pool = alarm_pool_create_with_unused_hardware_alarm(1);
+    alarm_pool_add_repeating_timer_us(timer_pool, -SWAP_IDLE_US, swap_tick, NULL, &timer);
+}
+
+// swap_timer_stop - Stop the timer of swap_timer_start, called on the same core when the ROM is left
+// The alarm pool is released too, before a reset of core 1 could leave its hardware alarm claimed.
+void swap_timer_stop()
+{
+    if (!timer_pool)
+        return;
+    cancel_repeating_timer(&timer);
+    alarm_pool_destroy(timer_pool);
+    timer_pool = NULL;
+}
@@ -0,0 +1,50 @@
+// MSX PICOVERSE PROJECT
+// (c) 2025 Cristiano Goncalves
+// The Retro Hacker
+//
+// swap.h - Return to the menu and hot swap for the MSX PICOVERSE multirom firmware
+//
+// Once a ROM is started the firmware used to serve it until power off. Two events now break out of the ROM loop:
+//
+// - A reset of the MSX. The Z80 reads memory all the time, a HALT included, so /RD staying high for SWAP_IDLE_US
+//   means the MSX is held in reset. The menu is served again and is ready before the BIOS scans the slots. The
+//   check is run by swap_poll from a loop that polls the bus, or every SWAP_IDLE_US by the timer of
+//   swap_timer_start when the loops sleep in WFE between cycles.
+// - A magic write: the bytes of SWAP_MAGIC followed by a command byte, written in a row to SWAP_ADDR of the cartridge
+//   slot. SWAP_MENU goes back to the menu, any other value starts that entry of the catalog kept in records[] (the
+//   MSX side is expected to reset or jump to the new ROM right after). SWAP_ADDR is in a range that none of the
+//   supported mappers decodes: bank registers start at 5000h (Konami SCC, NEO8, NEO16) or 6000h (Konami, ASCII8,
+//   ASCII16), save RAM is written at 8000h-BFFFh, the disk controller sits at 7FF8h-7FFFh, so a game can not switch
+//   a bank or write its save RAM with the magic sequence, nor leave its ROM by writing to one of its registers.
+//
+// This work is licensed  under a "Creative Commons Attribution-NonCommercial-ShareAlike 4.0 International
+// License". https://creativecommons.org/licenses/by-nc-sa/4.0/
+
+#ifndef SWAP_H
+#define SWAP_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#define SWAP_ADDR       0x4FFF      // Magic write address, below every bank register of the supported mappers
+#define SWAP_MAGIC      "PVSW"      // Bytes written to SWAP_ADDR before the command byte
+#define SWAP_MENU       0xFF        // Command byte: back to the menu
+#define SWAP_IDLE_US    1000        // /RD idle this long means the MSX is held in reset
+
+extern volatile bool swap_pending;  // Set when the running ROM has to be left
+extern volatile int swap_target;    // Catalog entry to start next, -1 for the menu
+
+void swap_arm();
+void swap_feed(uint8_t data);
+void swap_poll();
+void swap_timer_start();
+void swap_timer_stop();
+
+// swap_write - Look for the magic sequence in a write cycle of the cartridge slot
+static inline void swap_write(uint16_t addr, uint8_t data)
+{
+    if (addr == SWAP_ADDR)
+        swap_feed(data);
+}
+
+#endif